@@ -1,20 +1,26 @@
 #pragma once
 
+#include "executor.h"
 #include "types.h"
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 /**
- * Note that none of the code in this module is thread-safe yet. There is a
- * global transposition table being accessed. The plan is that this will be
- * changed, and not only will the code be thread-safe (able to run multiple
- * analyses simultaneously), but the GameAnalyzer will support being controlled
- * from a separate thread.
+ * The analysis functions may be called from several threads at once. Each
+ * thread keeps its own transposition table (allocated on the thread's first
+ * analysis) and random number generator, so concurrent analyses share no
+ * mutable state and give the same results as running them one at a time.
  *
- * Ideally, there will also be support for configuring the execution policy of
- * the analysis to be multi-threaded itself.
+ * The exception is the functions that replace the evaluation
+ * (`load_evaluation_weights` in particular), which are meant to be called at
+ * startup. A GameAnalyzer runs its analyses on a worker thread of its own,
+ * and can be monitored and stopped from the thread that controls it while
+ * they run. An AnalysisService shares one transposition table between all
+ * its analyses instead.
  */
 
 namespace rock
@@ -25,24 +31,237 @@ auto apply_move(Move, Position) -> Position;
 
 auto list_moves(Position const&) -> std::vector<Move>;
 auto count_moves(Position const&, int level = 1) -> std::size_t;
+auto count_moves(Position const&, int level, Executor&) -> std::size_t;
 auto is_move_legal(Move, Position const&) -> bool;
 auto list_legal_destinations(BoardCoordinates from, Position const&)
     -> std::vector<BoardCoordinates>;
 
+/**
+ * Allocation-free versions of the above, which overwrite the contents of the supplied list
+ */
+auto list_moves(Position const&, MoveList* out) -> void;
+auto list_legal_destinations(BoardCoordinates from, Position const&, DestinationList* out) -> void;
+
 auto get_game_outcome(Position const&) -> GameOutcome;
 
+/**
+ * Load evaluation weights from a file (as written by `rock_tune --weights-output`) for use by
+ * subsequent analyses. This is intended for experiments: the loaded weights are only used when
+ * the library is built with ROCK_RUNTIME_EVALUATION_WEIGHTS, and otherwise false is returned.
+ * Must not be called while an analysis is running.
+ */
+auto load_evaluation_weights(std::string const& path) -> bool;
+
+/**
+ * Load a neural evaluation network from a file, which subsequent analyses will use instead of the
+ * heuristic evaluation until `clear_evaluation_network` is called. Returns false if the file
+ * could not be read or does not match the network layout of this build. Analyses that are
+ * already running keep the network they started with.
+ */
+auto load_evaluation_network(std::string const& path) -> bool;
+auto clear_evaluation_network() -> void;
+
+/**
+ * Load endgame tablebases generated by rock_tablebase, which subsequent
+ * analyses will use for exact scores of the positions in them until
+ * `clear_tablebase` is called. The file is memory-mapped rather than read in.
+ * Returns false if the file could not be opened or is not a tablebase file.
+ */
+auto load_tablebase(std::string const& path) -> bool;
+auto clear_tablebase() -> void;
+
+/**
+ * The result of a position with best play
+ */
+struct TablebaseResult
+{
+    GameOutcome outcome;
+
+    // The number of moves, of either player, until the game is over
+    int distance;
+};
+
+/**
+ * Look the position up in the loaded tablebase
+ */
+auto probe_tablebase(Position const&) -> std::optional<TablebaseResult>;
+
+/**
+ * Load an opening book built by rock_book. Until `clear_opening_book` is
+ * called, `analyze_position_with_ai_difficulty_level` answers from the book
+ * without searching, for the positions in it. The file is memory-mapped rather
+ * than read in. Returns false if the file could not be opened or is not a book
+ * file.
+ */
+auto load_opening_book(std::string const& path) -> bool;
+auto clear_opening_book() -> void;
+
+struct BookMove
+{
+    Move move;
+
+    // Relative to the weights of the other moves of the same position
+    u32 weight;
+};
+
+/**
+ * The moves of the loaded opening book for the position, with the highest
+ * weight first, or none if the position is not in the book
+ */
+auto probe_opening_book(Position const&) -> std::vector<BookMove>;
+
+/**
+ * The time left on the clock of the player to move
+ */
+struct ClockState
+{
+    std::chrono::milliseconds remaining;
+    std::chrono::milliseconds increment{};
+
+    // If not set, the remaining time is spread over a typical number of moves
+    std::optional<int> moves_to_go{};
+};
+
+/**
+ * The search algorithm of an analysis
+ */
+enum struct SearchEngine
+{
+    // Iterative deepening alpha-beta search
+    AlphaBeta,
+
+    // Monte-Carlo tree search, which grows a tree of the most promising moves
+    // one position at a time and picks the move it explored the most
+    MonteCarlo,
+};
+
+/**
+ * Limits on how long an analysis runs. Any combination may be set, and the
+ * analysis stops at whichever is reached first. With no limits set, an
+ * analysis only stops at the maximum depth, or when asked to.
+ *
+ * With a time limit, the search deepens for as long as it expects the next
+ * depth to finish in time. A depth that is still running at the hard deadline
+ * is abandoned, and the result of the last completed depth is returned. The
+ * first depth always completes, so that a move is returned if there is one.
+ *
+ * A node limit is a hard limit in the same way, counting the nodes of all
+ * depths. Unlike a time limit, it gives the same result on any machine, so
+ * long as no time limit is also set.
+ *
+ * If `solver_nodes` is set, a proof-number search tries to solve the position
+ * outright once the first depth is done, holding at most that many positions
+ * in memory. A solved position gets an exact score of a win, loss or draw, and
+ * is not deepened any further. This finds forced wins near the end of a game
+ * in far fewer nodes than the alpha-beta search.
+ *
+ * If `symmetric_transpositions` is set, positions that are reflections or
+ * rotations of each other share their transposition table entries, so a line
+ * that reaches a mirror image of a position already searched reuses its
+ * result. This helps most in the opening, at the cost of a few bit operations
+ * per table access.
+ *
+ * If `keep_transpositions` is set, the analysis starts from what the thread's
+ * last analysis left in the transposition table, instead of clearing it. This
+ * saves the cost of clearing the table, which dominates shallow searches, and
+ * helps when the position follows on from the last one, as in a game. The
+ * result then depends on the analyses before it.
+ *
+ * With the Monte-Carlo `engine`, a node is one iteration of the search, and
+ * the depth, `solver_nodes` and `symmetric_transpositions` do not apply. As it
+ * can stop at any point, a time limit is used up to the time a depth would be
+ * started by. With no node or time limit, it runs
+ * `default_monte_carlo_iterations` iterations. Each thread keeps its tree, and
+ * if `keep_transpositions` is set, an analysis of a position one or two moves
+ * on from the last one carries on from it, with the same settings. If
+ * `playout_plies` is set, the positions at the leaves of the tree are valued
+ * by playing that many random moves from them, instead of by evaluating them
+ * directly.
+ */
+struct SearchLimits
+{
+    std::optional<int> depth{};
+    std::optional<std::chrono::milliseconds> move_time{};
+    std::optional<ClockState> clock{};
+    std::optional<u64> nodes{};
+    std::optional<std::size_t> solver_nodes{};
+    bool symmetric_transpositions{};
+    bool keep_transpositions{};
+    SearchEngine engine{};
+    int playout_plies{};
+};
+
+inline constexpr auto default_monte_carlo_iterations = u64{100'000};
+
 /**
  * Analyze a position up to a fixed depth
  */
 auto analyze_position(Position const&, int depth) -> PositionAnalysis;
+auto analyze_position(Position const&, SearchLimits const&) -> PositionAnalysis;
 
 /**
- * Separately analyze each available move
+ * Free the transposition tables and Monte-Carlo tree that the analyses on the
+ * calling thread keep between them, which take a few tens of megabytes each
+ * and are only allocated by the analyses that use them. The next such
+ * analysis on the thread allocates them again, and starts afresh. The threads
+ * of an executor free theirs when the executor is destroyed. Must not be
+ * called while an analysis is running on the thread.
+ */
+auto release_analysis_memory() -> void;
+
+/**
+ * How a single analysis is shared between the threads of an executor
+ */
+enum struct ParallelSearch
+{
+    // Every thread searches the whole tree, sharing one transposition table,
+    // with every other helper thread starting a depth further on. The helpers
+    // only pass on what they find through the table.
+    LazySmp,
+
+    // Young Brothers Wait: once the first move of a node has been searched,
+    // its remaining moves are shared out between the threads, and the rest of
+    // them are abandoned as soon as one causes a cutoff
+    SplitPoints,
+};
+
+/**
+ * Analyze a position using the threads of an executor as well as the calling
+ * thread
+ *
+ * Unlike the single-threaded analysis, the result depends on the timing of
+ * the threads. A node limit counts the nodes of all the threads, which check
+ * it as they go, so it is only overshot by the nodes searched between two
+ * checks.
+ *
+ * A Monte-Carlo analysis ignores `ParallelSearch`: the threads all grow the
+ * same tree.
+ */
+auto analyze_position(
+    Position const&,
+    SearchLimits const&,
+    Executor&,
+    ParallelSearch = ParallelSearch::SplitPoints) -> PositionAnalysis;
+
+/**
+ * Separately analyze each available move, giving the analysis of the position
+ * after the move
  *
  * This will probably take considerably longer than only analyzing the root
- * node, as an accurate score will be determined for each move.
+ * node, as an accurate score will be determined for each move. If `num_exact`
+ * is given, only the best `num_exact` moves are scored accurately. Each of the
+ * others is only known to be no better for the player to move than its score,
+ * and has no principal variation.
+ *
+ * The moves can be shared out between the threads of an executor. The result
+ * does not depend on the timing of the threads, but can depend on the number
+ * of them.
  */
-auto analyze_available_moves(Position const&, int depth) -> std::map<Move, PositionAnalysis>;
+auto analyze_available_moves(
+    Position const&,
+    int depth,
+    std::optional<std::size_t> num_exact = std::nullopt,
+    Executor* = nullptr) -> std::map<Move, PositionAnalysis>;
 
 /**
  * Create a position analysis based on the input using a soft max function to
@@ -60,27 +279,133 @@ auto select_analysis_with_softmax(
  *
  * The ai_level input can range from 0 -> 10+, and the quality of the results
  * will increase. Beware that higher difficulty levels (above 10) will begin to
- * take longer to execute.
+ * take longer to execute. The executor, if given, is used for the levels that
+ * analyze every move.
+ *
+ * If an opening book is loaded, the levels from 10 up play its moves wherever
+ * it has any, picking between them at random in proportion to their weights.
+ * The analysis then has the book move alone as its principal variation, a
+ * score of 0 and no nodes. The lower levels, which are meant to make mistakes,
+ * always search.
+ */
+auto analyze_position_with_ai_difficulty_level(
+    Position const&, int ai_level, Executor* = nullptr) -> PositionAnalysis;
+
+/**
+ * As above, with the given search engine. With the Monte-Carlo engine, the
+ * level sets the number of iterations, and the lower levels pick a move at
+ * random, weighted by how much it was explored: the weight of each move is its
+ * number of visits to the power of the softmax parameter of the level, so
+ * level 0 picks any explored move and level 9 nearly always the best. The
+ * search carries on from the thread's last tree, as in a game.
+ */
+auto analyze_position_with_ai_difficulty_level(
+    Position const&, int ai_level, SearchEngine, Executor* = nullptr) -> PositionAnalysis;
+
+/**
+ * Analyze many independent positions, as `analyze_position` would, sharing
+ * them out between the threads of the executor
+ *
+ * The callback is given the index of each position along with its analysis
+ * as soon as it is done, so in no particular order. It is called on one of the
+ * threads, but never from two threads at once. If it throws, no more positions
+ * are started, and the exception is rethrown once the running analyses end.
  */
-auto analyze_position_with_ai_difficulty_level(Position const&, int ai_level) -> PositionAnalysis;
+auto analyze_positions(
+    Position const* positions,
+    std::size_t count,
+    SearchLimits const&,
+    Executor&,
+    std::function<void(std::size_t index, PositionAnalysis const&)> const& callback) -> void;
+auto analyze_positions(std::vector<Position> const&, SearchLimits const&, Executor&)
+    -> std::vector<PositionAnalysis>;
 
 /**
- * Crude initial attempt at an object through which the analysis of a position
- * can be controlled.
+ * A snapshot of the progress of an ongoing analysis
+ */
+struct AnalysisProgress
+{
+    std::optional<Move> best_move;
+    ScoreType score;
+    int depth;
+    u64 nodes;
+};
+
+/**
+ * Object through which the analysis of a position can be controlled. The
+ * analysis runs on a worker thread owned by the analyzer, so that it can be
+ * monitored and stopped from the thread that started it. It reports on each
+ * depth as it completes, so it always uses the alpha-beta engine.
  */
 struct GameAnalyzer
 {
     explicit GameAnalyzer();
 
+    /**
+     * Start analyzing the position in the background, and return immediately.
+     * Any analysis that is already running is stopped first. Without limits,
+     * the analysis runs until the max depth, or until it is stopped.
+     */
     auto analyze_position(Position) -> void;
+    auto analyze_position(Position, SearchLimits const&) -> void;
+
+    /**
+     * Search on the opponent's time. `position` is the position after our
+     * move, which must be the move recommended by the last analysis. The
+     * position after the opponent's expected reply (the next move of the
+     * principal variation) is then analyzed, and the reply is returned. If no
+     * reply is expected, nothing is started and nothing is returned.
+     *
+     * The limits (apart from the depth) only start to apply on `ponder_hit`.
+     * If the opponent makes another move, analyzing the resulting position
+     * stops the pondering, and reuses what it has searched so far.
+     */
+    auto ponder(Position, SearchLimits const&) -> std::optional<Move>;
+
+    /**
+     * The opponent made the expected reply, so the ongoing analysis continues
+     * with its limits applying from now
+     */
+    auto ponder_hit() -> void;
+    auto is_pondering() const -> bool;
+
+    /**
+     * Ask the analysis to stop, without waiting for it to do so
+     */
     auto stop_analysis() -> void;
+    auto wait_for_analysis() -> void;
     auto is_analysis_ongoing() const -> bool;
 
     auto set_max_depth(int) -> void;
+
+    /**
+     * The callback is called from the worker thread each time a depth is
+     * completed. It must be set while no analysis is running.
+     */
     auto set_report_callback(std::function<void(GameAnalyzer&)>) -> void;
+
+    /**
+     * The callback is called from the worker thread once for each analysis,
+     * when it ends, whether it reached its limits or was stopped, with its
+     * final result in `best_analysis_so_far`. The analysis still counts as
+     * ongoing until the callback returns, so it must not wait for it. It must
+     * be set while no analysis is running.
+     */
+    auto set_finished_callback(std::function<void(GameAnalyzer&)>) -> void;
+
+    /**
+     * The analysis (including principal variation) from the last completed
+     * depth. A depth stopped part way is discarded, unless it is the first
+     * with a move, which is only stopped by `stop_analysis`.
+     */
     auto best_analysis_so_far() -> PositionAnalysis;
     auto current_depth() const -> int;
 
+    /**
+     * Never blocks on the search
+     */
+    auto progress() const -> AnalysisProgress;
+
     ~GameAnalyzer();
 
 private:
@@ -88,4 +413,75 @@ private:
     std::unique_ptr<Impl> impl_;
 };
 
+struct AnalysisServiceConfig
+{
+    // The memory of the transposition table shared by the analyses
+    std::size_t table_megabytes{64};
+
+    // Whether the table is shared between symmetric positions (see `SearchLimits`)
+    bool symmetric_transpositions{};
+};
+
+/**
+ * Runs analyses for many clients at once, on the threads of an executor. Each
+ * analysis runs on one thread, and waits for a free one in the executor's
+ * queue. All the analyses use one transposition table, which is kept between
+ * them, so that analyses of related positions, such as those of a game being
+ * followed by several clients, benefit from each other's work. The table is
+ * aged whenever the service goes idle.
+ *
+ * The analyses take all their limits from the request, with the following
+ * exceptions. An alpha-beta analysis always starts from what the shared
+ * table holds, whether or not `keep_transpositions` is set. Its
+ * `symmetric_transpositions` must match the service's configuration, which
+ * sets the keying of the whole table. A Monte-Carlo analysis uses the tree of
+ * the thread that runs it, just as `analyze_position` does without an
+ * executor. The time limits apply from when an analysis starts, not from when
+ * it is submitted.
+ *
+ * The service may be used from several threads at once, and from the
+ * callbacks, other than to wait. It must be destroyed before the executor.
+ */
+struct AnalysisService
+{
+    using RequestId = u64;
+    using Callback = std::function<void(RequestId, PositionAnalysis const&)>;
+
+    explicit AnalysisService(Executor&, AnalysisServiceConfig const& = {});
+
+    /**
+     * Start analyzing the position, and return at once. The callback is
+     * called with the analysis when it is done, on the thread that ran it,
+     * which may be before `submit` returns. It must not throw.
+     *
+     * Throws `std::invalid_argument` if the limits are for an alpha-beta
+     * analysis and their `symmetric_transpositions` differs from the
+     * service's configuration.
+     */
+    auto submit(Position const&, SearchLimits const&, Callback) -> RequestId;
+
+    /**
+     * Ask an analysis to stop. One that is running reports what it has found
+     * so far, as a `GameAnalyzer` does, and one that has not started yet
+     * reports no move. Returns false if the analysis was already done.
+     */
+    auto cancel(RequestId) -> bool;
+
+    /**
+     * Wait for all the analyses submitted so far to be done
+     */
+    auto wait() -> void;
+
+    auto num_pending() const -> std::size_t;
+
+    /**
+     * Cancels the pending analyses, and waits for them
+     */
+    ~AnalysisService();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
 }  // namespace rock
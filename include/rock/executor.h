@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace rock
+{
+
+namespace internal
+{
+    struct ThreadPool;
+}
+
+struct ExecutorConfig
+{
+    // Zero for one thread per hardware thread
+    std::size_t num_threads{};
+
+    // Keep each thread on its own core (only supported on Linux)
+    bool pin_threads{};
+
+    // Work submitted from outside the executor while this many tasks are queued is run on the
+    // submitting thread instead, except for the helpers of a parallel search, which only stop
+    // when the main search does and so are always queued
+    std::size_t queue_capacity{1024};
+};
+
+/**
+ * A pool of threads for the parallel analysis functions to share
+ *
+ * Create one per engine instance and pass it to each call, so that threads are not started for
+ * every call, and each thread's transposition table stays allocated between calls. An executor
+ * may be used by several calls at once.
+ */
+struct Executor
+{
+    explicit Executor(ExecutorConfig const& = {});
+    ~Executor();
+
+    auto num_threads() const -> std::size_t;
+
+    /**
+     * For use by the library
+     */
+    auto thread_pool() -> internal::ThreadPool&;
+
+private:
+    std::unique_ptr<internal::ThreadPool> pool_;
+};
+
+}  // namespace rock
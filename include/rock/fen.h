@@ -11,4 +11,9 @@ namespace rock
 auto format_as_fen(rock::Board const&) -> std::string;
 auto parse_fen_to_board(std::string_view fen_string) -> std::optional<rock::Board>;
 
+/**
+ * Parses a board and the player to move, separated by spaces, such as "<fen> w"
+ */
+auto parse_fen_to_position(std::string_view fen_string) -> std::optional<rock::Position>;
+
 }  // namespace rock
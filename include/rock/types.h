@@ -167,6 +167,45 @@ struct Move
     }
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FixedCapacityList
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Vector-like container with its storage held inline, for returning small lists of moves or
+ * coordinates without touching the heap.
+ */
+template <typename T, std::size_t Capacity>
+struct FixedCapacityList
+{
+    constexpr auto push_back(T const& value) -> void
+    {
+        assert(size_ < Capacity);
+        data_[size_++] = value;
+    }
+    constexpr auto clear() -> void { size_ = 0; }
+
+    constexpr auto begin() const -> T const* { return &data_[0]; }
+    constexpr auto end() const -> T const* { return this->begin() + size_; }
+    constexpr auto begin() -> T* { return &data_[0]; }
+    constexpr auto end() -> T* { return this->begin() + size_; }
+
+    constexpr auto operator[](std::size_t i) const -> T const& { return data_[i]; }
+    constexpr auto operator[](std::size_t i) -> T& { return data_[i]; }
+
+    constexpr auto size() const -> std::size_t { return size_; }
+    constexpr auto empty() const -> bool { return size_ == 0; }
+    static constexpr auto capacity() -> std::size_t { return Capacity; }
+
+private:
+    T data_[Capacity];
+    std::size_t size_{};
+};
+
+// A player has at most 12 pieces, and each piece has at most 8 destinations
+using MoveList = FixedCapacityList<Move, 12 * 8>;
+using DestinationList = FixedCapacityList<BoardCoordinates, 8>;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // GameOutcome
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -186,6 +225,9 @@ struct PositionAnalysis
     std::optional<Move> best_move;
     std::vector<Move> principal_variation;
     ScoreType score;
+
+    // The number of positions searched to produce the analysis
+    u64 nodes;
 };
 
 }  // namespace rock
@@ -2,20 +2,41 @@
 //#define DIAGNOSTICS
 
 #include "rock/algorithms.h"
+#include "internal/atomic_snapshot.h"
 #include "internal/bit_operations.h"
 #include "internal/diagnostics.h"
 #include "internal/evaluate.h"
+#include "internal/evaluation_weights.h"
 #include "internal/internal_types.h"
+#include "internal/monte_carlo.h"
 #include "internal/move_generation.h"
+#include "internal/multi_pv.h"
+#include "internal/nnue.h"
+#include "internal/opening_book.h"
+#include "internal/proof_number_search.h"
 #include "internal/search.h"
+#include "internal/tablebase.h"
 #include "internal/table_generation.h"
+#include "internal/thread_pool.h"
+#include "internal/time_manager.h"
 #include "internal/transposition_table.h"
 #include "rock/format.h"
 #include "rock/parse.h"
 #include <fmt/format.h>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 
 // TODO:
 // - Consider using strong types more, instead of lots of u64s
@@ -42,22 +63,27 @@ auto apply_move(Move const m, Position p) -> Position
     return p;
 }
 
-auto list_moves(Position const& position) -> std::vector<Move>
+auto list_moves(Position const& position, MoveList* out) -> void
 {
-    auto result = std::vector<Move>{};
+    out->clear();
 
     auto const friends = position.board()[position.player_to_move()];
     auto const enemies = position.board()[!position.player_to_move()];
     auto moves = generate_moves(friends, enemies);
 
     for_each_move(moves, [&](u64 from_board, u64 to_board) {
-        result.push_back({
+        out->push_back({
             BoardCoordinates{coordinates_from_bit_board(from_board)},
             BoardCoordinates{coordinates_from_bit_board(to_board)},
         });
     });
+}
 
-    return result;
+auto list_moves(Position const& position) -> std::vector<Move>
+{
+    auto moves = MoveList{};
+    list_moves(position, &moves);
+    return std::vector<Move>(moves.begin(), moves.end());
 }
 
 auto count_moves(Position const& position, int level) -> std::size_t
@@ -68,6 +94,35 @@ auto count_moves(Position const& position, int level) -> std::size_t
         level);
 }
 
+auto count_moves(Position const& position, int level, Executor& executor) -> std::size_t
+{
+    // Below this, a level is not worth sharing out
+    constexpr auto min_parallel_level = 3;
+
+    auto const friends = position.friends();
+    auto const enemies = position.enemies();
+    if (level < min_parallel_level)
+        return count_moves(friends, enemies, level);
+
+    // One task for each move from the root
+    auto moves = generate_moves(friends, enemies);
+    auto counts = std::vector<std::size_t>(MoveList::capacity());
+    auto num_tasks = std::size_t{};
+    auto tasks = TaskGroup{&executor.thread_pool()};
+
+    for_each_move(moves, [&](u64 from_board, u64 to_board) {
+        tasks.run([&, from_board, to_board, count = &counts[num_tasks++]] {
+            auto friends_copy = friends;
+            auto enemies_copy = enemies;
+            apply_move_low_level(from_board, to_board, &friends_copy, &enemies_copy);
+            *count = count_moves(enemies_copy, friends_copy, level - 1);
+        });
+    });
+    tasks.wait();
+
+    return std::accumulate(counts.begin(), counts.end(), std::size_t{});
+}
+
 auto is_move_legal(Move move, Position const& position) -> bool
 {
     return is_move_legal(
@@ -76,14 +131,13 @@ auto is_move_legal(Move move, Position const& position) -> bool
         position.board()[!position.player_to_move()]);
 }
 
-auto list_legal_destinations(BoardCoordinates from, Position const& position)
-    -> std::vector<BoardCoordinates>
+auto list_legal_destinations(BoardCoordinates from, Position const& position, DestinationList* out)
+    -> void
 {
-    auto res = std::vector<BoardCoordinates>{};
-    res.reserve(8);
+    out->clear();
 
     if (!(from.bit_board() & position.board()[position.player_to_move()]))
-        return res;
+        return;
 
     auto destinations = generate_legal_destinations(from, position);
 
@@ -92,10 +146,16 @@ auto list_legal_destinations(BoardCoordinates from, Position const& position)
         auto const pos = coordinates_from_bit_board(destinations);
         destinations ^= bit_board_from_coordinates(pos);
 
-        res.emplace_back(pos);
+        out->push_back(BoardCoordinates{pos});
     }
+}
 
-    return res;
+auto list_legal_destinations(BoardCoordinates from, Position const& position)
+    -> std::vector<BoardCoordinates>
+{
+    auto destinations = DestinationList{};
+    list_legal_destinations(from, position, &destinations);
+    return std::vector<BoardCoordinates>(destinations.begin(), destinations.end());
 }
 
 auto get_game_outcome(Position const& position) -> GameOutcome
@@ -112,39 +172,526 @@ auto get_game_outcome(Position const& position) -> GameOutcome
     return GameOutcome::Ongoing;
 }
 
+auto load_evaluation_weights(std::string const& path) -> bool
+{
+#ifdef ROCK_RUNTIME_EVALUATION_WEIGHTS
+    auto file = std::ifstream(path);
+    if (!file)
+        return false;
+
+    auto contents = std::stringstream{};
+    contents << file.rdbuf();
+
+    auto const weights = parse_evaluation_weights(contents.str(), tuned_evaluation_weights);
+    if (!weights)
+        return false;
+
+    runtime_evaluation_weights = *weights;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+namespace
+{
+    // Only replaced as a whole, so that analyses can hold on to the network they started with
+    std::shared_ptr<EvaluationNetwork const> evaluation_network{};
+
+    auto current_evaluation_network() -> std::shared_ptr<EvaluationNetwork const>
+    {
+        return std::atomic_load(&evaluation_network);
+    }
+
+    std::shared_ptr<Tablebase const> tablebase{};
+
+    auto current_tablebase() -> std::shared_ptr<Tablebase const>
+    {
+        return std::atomic_load(&tablebase);
+    }
+
+    std::shared_ptr<OpeningBook const> opening_book{};
+
+    auto current_opening_book() -> std::shared_ptr<OpeningBook const>
+    {
+        return std::atomic_load(&opening_book);
+    }
+
+    /**
+     * Search state that is reused between analyses. Each thread has its own, so that analyses
+     * on different threads never share mutable state. The tables and tree are only allocated for
+     * the analyses that need them, as threads that only pick moves at random need none of them,
+     * and are freed by `release_analysis_memory`.
+     */
+    struct AnalysisState
+    {
+        std::ranlux24 rng{std::random_device{}()};
+
+        // For the analyses on one thread
+        std::optional<TranspositionTable> table{};
+
+        // For the analyses that share a table between threads
+        std::optional<TranspositionTable> shared_table{};
+
+        // For the Monte-Carlo analyses, allocated on first use, and kept between them so that the
+        // next analysis of the game can carry on from it
+        std::optional<MonteCarloTree> monte_carlo_tree{};
+    };
+
+    auto this_thread_analysis_state() -> AnalysisState&
+    {
+        thread_local auto state = AnalysisState{};
+        return state;
+    }
+
+    auto this_thread_table() -> TranspositionTable&
+    {
+        auto& state = this_thread_analysis_state();
+        if (!state.table)
+            state.table.emplace(18);
+        return *state.table;
+    }
+}  // namespace
+
+auto load_evaluation_network(std::string const& path) -> bool
+{
+    auto network = std::shared_ptr<EvaluationNetwork const>{
+        internal::load_evaluation_network(path),
+    };
+    if (!network)
+        return false;
+
+    std::atomic_store(&evaluation_network, std::move(network));
+    return true;
+}
+
+auto clear_evaluation_network() -> void
+{
+    std::atomic_store(&evaluation_network, std::shared_ptr<EvaluationNetwork const>{});
+}
+
+auto load_tablebase(std::string const& path) -> bool
+{
+    auto loaded = std::shared_ptr<Tablebase const>{Tablebase::open(path)};
+    if (!loaded)
+        return false;
+
+    std::atomic_store(&tablebase, std::move(loaded));
+    return true;
+}
+
+auto clear_tablebase() -> void
+{
+    std::atomic_store(&tablebase, std::shared_ptr<Tablebase const>{});
+}
+
+auto probe_tablebase(Position const& position) -> std::optional<TablebaseResult>
+{
+    auto const loaded = current_tablebase();
+    if (!loaded)
+        return std::nullopt;
+
+    auto const entry = loaded->probe(position.friends(), position.enemies());
+    if (!entry)
+        return std::nullopt;
+
+    auto const winner = entry->result == GameResult::Win ? position.player_to_move()
+                                                         : !position.player_to_move();
+    auto const outcome = entry->result == GameResult::Draw ? GameOutcome::Draw
+        : winner == Player::White                          ? GameOutcome::WhiteWins
+                                                           : GameOutcome::BlackWins;
+    return TablebaseResult{outcome, entry->distance};
+}
+
+auto load_opening_book(std::string const& path) -> bool
+{
+    auto loaded = std::shared_ptr<OpeningBook const>{OpeningBook::open(path)};
+    if (!loaded)
+        return false;
+
+    std::atomic_store(&opening_book, std::move(loaded));
+    return true;
+}
+
+auto clear_opening_book() -> void
+{
+    std::atomic_store(&opening_book, std::shared_ptr<OpeningBook const>{});
+}
+
+auto probe_opening_book(Position const& position) -> std::vector<BookMove>
+{
+    auto const loaded = current_opening_book();
+    if (!loaded)
+        return {};
+
+    auto moves = std::vector<BookMove>{};
+    for (auto const& entry : loaded->lookup(position.friends(), position.enemies()))
+        moves.push_back(BookMove{*entry.move.to_standard_move(), entry.weight});
+    return moves;
+}
+
+namespace
+{
+    // The depth to which searches limited only by time (or not at all) may deepen
+    constexpr auto max_search_depth = 100;
+}  // namespace
+
 auto analyze_position(Position const& position, int max_depth) -> PositionAnalysis
 {
-    static auto table = TranspositionTable(18);
+    auto limits = SearchLimits{};
+    limits.depth = max_depth;
+    return analyze_position(position, limits);
+}
+
+namespace
+{
+    // The depth given to solved positions in the table, so that any search takes their score
+    constexpr auto solved_depth = std::numeric_limits<int>::max();
+
+    /**
+     * Try to solve the position with a proof-number search, storing the result in the table as
+     * an exact score for the next depth to pick up
+     */
+    auto solve_into_table(
+        Position const& position,
+        std::size_t max_nodes,
+        TranspositionTable& table,
+        SearchControl& control) -> bool
+    {
+        auto const solution =
+            solve_with_proof_numbers(position.friends(), position.enemies(), max_nodes, &control);
+        if (solution.result == GameResult::Unknown || control.stopped)
+            return false;
+
+        auto const score = solution.result == GameResult::Win ? big
+            : solution.result == GameResult::Loss             ? -big
+                                                               : ScoreType{};
+        auto const generation = table.generation();
+
+        table.update(
+            position.friends(), position.enemies(), [&](TranspositionTable::Value& entry, bool) {
+                entry.set_key(position.friends(), position.enemies());
+                entry.recommendation = InternalMoveRecommendation{solution.move, score};
+                entry.depth = solved_depth;
+                entry.type = NodeType::Pv;
+                entry.generation = generation;
+            });
+        return true;
+    }
+
+    /**
+     * Iterative deepening, within the limits. Any threads helping with the search must be set up
+     * through the control and table.
+     */
+    auto deepen(
+        Position const& position,
+        SearchLimits const& limits,
+        TranspositionTable& table,
+        SearchControl& control,
+        EvaluationNetwork const* network) -> PositionAnalysis
+    {
+        auto time_manager = TimeManager(limits);
+        auto analysis = make_analysis(position, InternalMoveRecommendation{});
+        auto const max_depth = limits.depth.value_or(max_search_depth);
+        auto is_solved = false;
+
+        for (auto depth = 1; depth <= max_depth; ++depth)
+        {
+            auto searcher = Searcher(depth, &table, &control, network);
+            auto const recommendation =
+                searcher.search_root(position.friends(), position.enemies());
+
+            // Only depth 1 runs without limits, so can only be abandoned through the stop token,
+            // and the move it has found so far is then kept, as by `GameAnalyzer`
+            if (control.stopped)
+            {
+                if (depth == 1 && recommendation.move.to_standard_move())
+                    analysis = make_analysis(position, recommendation, table);
+                break;
+            }
+
+            // Taken now, as the principal variation in the table can change during an abandoned
+            // depth
+            analysis = make_analysis(position, recommendation, table);
+
+            // Deeper searches cannot improve on a solved score
+            if (is_solved || !time_manager.should_start_next_iteration())
+                break;
+
+            // Only set after the first depth, which always completes
+            control.set_limits(time_manager, limits);
+            if (control.stopped)
+                break;
+
+            if (depth == 1 && depth < max_depth && limits.solver_nodes)
+            {
+                is_solved = solve_into_table(position, *limits.solver_nodes, table, control);
+                if (control.stopped)
+                    break;
+            }
+        }
+
+        analysis.nodes = control.nodes;
+        return analysis;
+    }
+
+    auto this_thread_shared_table() -> TranspositionTable&
+    {
+        auto& state = this_thread_analysis_state();
+        if (!state.shared_table)
+            state.shared_table.emplace(18, /*is_shared=*/true);
+        return *state.shared_table;
+    }
 
-    table.reset();
+    // The number of nodes in each thread's Monte-Carlo tree
+    constexpr auto monte_carlo_tree_size = std::size_t{1} << 20;
 
-    auto recommendation = InternalMoveRecommendation{};
-    for (auto depth = 1; depth <= max_depth; ++depth)
+    auto this_thread_monte_carlo_tree() -> MonteCarloTree&
     {
-        auto searcher = Searcher(depth, &table);
-        recommendation = searcher.search(position.friends(), position.enemies());
+        auto& state = this_thread_analysis_state();
+        if (!state.monte_carlo_tree)
+            state.monte_carlo_tree.emplace(monte_carlo_tree_size);
+        return *state.monte_carlo_tree;
     }
-    return make_analysis(position, recommendation, table);
+
+    /**
+     * Grow this thread's Monte-Carlo tree from the position, within the limits, with the threads of
+     * the executor if there is one, or until the stop token is set. Returns the number of
+     * iterations.
+     */
+    auto grow_monte_carlo_tree(
+        Position const& position,
+        SearchLimits const& limits,
+        Executor* executor,
+        std::atomic<bool> const* stop_token = nullptr) -> u64
+    {
+        auto const network = current_evaluation_network();
+        auto settings = MonteCarloSettings{};
+        settings.playout_plies = limits.playout_plies;
+        settings.network = network.get();
+
+        auto& tree = this_thread_monte_carlo_tree();
+        if (!limits.keep_transpositions)
+            tree.clear();
+        tree.set_root(position.friends(), position.enemies(), settings);
+        auto& rng = this_thread_analysis_state().rng;
+
+        auto const time_manager = TimeManager(limits);
+        auto control = SearchControl{};
+        control.stop_token = stop_token;
+        control.deadline = time_manager.soft_deadline();
+        control.node_limit = limits.nodes;
+        if (!control.deadline && !control.node_limit)
+            control.node_limit = default_monte_carlo_iterations;
+        control.poll();
+
+        if (!executor)
+        {
+            tree.search(control, rng());
+            return control.nodes;
+        }
+
+        // The helpers grow the tree until the main search is done, or the iterations of them all
+        // reach the limit, so must not run on this thread, even when the queue is full. They are
+        // given the tree, as the thread that runs each of them has its own.
+        auto stop = std::atomic<bool>{};
+        auto helper_controls =
+            std::vector<SearchControl>(executor->num_threads(), control.make_helper());
+        auto tasks = TaskGroup{&executor->thread_pool()};
+
+        for (auto& helper_control : helper_controls)
+        {
+            helper_control.stop_token = &stop;
+            tasks.run_until_stopped([&tree, &helper_control, seed = u64{rng()}] {
+                tree.search(helper_control, seed);
+            });
+        }
+
+        tree.search(control, rng());
+        stop = true;
+        tasks.wait();
+
+        auto nodes = control.nodes;
+        for (auto const& helper_control : helper_controls)
+            nodes += helper_control.nodes;
+        return nodes;
+    }
+
+    auto make_monte_carlo_analysis(
+        Position const& position, std::optional<MonteCarloMove> const& move, u64 nodes)
+        -> PositionAnalysis
+    {
+        // Without a move, the game is over
+        auto analysis = PositionAnalysis{};
+        if (move)
+            analysis = this_thread_monte_carlo_tree().analysis_for(position, *move);
+        else
+        {
+            auto const score = evaluate_leaf_position(position.friends(), position.enemies());
+            analysis = make_analysis(position, InternalMoveRecommendation{InternalMove{}, score});
+        }
+        analysis.nodes = nodes;
+        return analysis;
+    }
+
+    auto analyze_with_monte_carlo(
+        Position const& position, SearchLimits const& limits, Executor* executor)
+        -> PositionAnalysis
+    {
+        auto const nodes = grow_monte_carlo_tree(position, limits, executor);
+        return make_monte_carlo_analysis(
+            position, this_thread_monte_carlo_tree().best_move(), nodes);
+    }
+}  // namespace
+
+auto analyze_position(Position const& position, SearchLimits const& limits) -> PositionAnalysis
+{
+    if (limits.engine == SearchEngine::MonteCarlo)
+        return analyze_with_monte_carlo(position, limits, nullptr);
+
+    auto& table = this_thread_table();
+    if (limits.keep_transpositions)
+        table.age();
+    else
+        table.reset();
+    table.set_symmetric(limits.symmetric_transpositions);
+
+    auto const network = current_evaluation_network();
+    auto const loaded_tablebase = current_tablebase();
+    auto control = SearchControl{};
+    control.tablebase = loaded_tablebase.get();
+    return deepen(position, limits, table, control, network.get());
 }
 
-auto analyze_available_moves(Position const& position, int max_depth)
-    -> std::map<Move, PositionAnalysis>
+auto release_analysis_memory() -> void
 {
-    auto result = std::map<Move, PositionAnalysis>{};
+    auto& state = this_thread_analysis_state();
+    state.table.reset();
+    state.shared_table.reset();
+    state.monte_carlo_tree.reset();
+}
+
+auto analyze_position(
+    Position const& position,
+    SearchLimits const& limits,
+    Executor& executor,
+    ParallelSearch parallel_search) -> PositionAnalysis
+{
+    if (limits.engine == SearchEngine::MonteCarlo)
+        return analyze_with_monte_carlo(position, limits, &executor);
+
+    auto& table = this_thread_shared_table();
+    if (limits.keep_transpositions)
+        table.age();
+    else
+        table.reset();
+    table.set_symmetric(limits.symmetric_transpositions);
+
+    auto const network = current_evaluation_network();
+    auto const loaded_tablebase = current_tablebase();
+    auto control = SearchControl{};
+    control.tablebase = loaded_tablebase.get();
 
-    for (auto const move : list_moves(position))
+    if (parallel_search == ParallelSearch::SplitPoints)
     {
-        auto const new_position = apply_move(move, position);
-        result[move] = analyze_position(new_position, max_depth - 1);
+        control.pool = &executor.thread_pool();
+        return deepen(position, limits, table, control, network.get());
     }
 
+    // The helpers deepen until the main search is done, or the nodes of them all reach the limit.
+    // Unlike the main search, they apply the limit from the start, as they need not complete a
+    // depth.
+    auto stop = std::atomic<bool>{};
+    auto helper_controls =
+        std::vector<SearchControl>(executor.num_threads(), control.make_helper());
+    for (auto& helper_control : helper_controls)
+    {
+        helper_control.stop_token = &stop;
+        helper_control.node_limit = limits.nodes;
+        helper_control.poll();
+    }
+
+    // They only end when stopped, so must not run on this thread, even when the queue is full
+    auto tasks = TaskGroup{&executor.thread_pool()};
+    for (auto i = std::size_t{}; i < helper_controls.size(); ++i)
+    {
+        tasks.run_until_stopped([&, i] {
+            auto& helper_control = helper_controls[i];
+
+            for (auto depth = 1 + static_cast<int>(i % 2);
+                 depth <= max_search_depth && !helper_control.stopped;
+                 ++depth)
+            {
+                auto searcher = Searcher(depth, &table, &helper_control, network.get());
+                searcher.search_root(position.friends(), position.enemies());
+            }
+        });
+    }
+
+    auto analysis = deepen(position, limits, table, control, network.get());
+
+    stop = true;
+    tasks.wait();
+
+    for (auto const& helper_control : helper_controls)
+        analysis.nodes += helper_control.nodes;
+    return analysis;
+}
+
+auto analyze_available_moves(
+    Position const& position,
+    int max_depth,
+    std::optional<std::size_t> num_exact,
+    Executor* executor) -> std::map<Move, PositionAnalysis>
+{
+    auto const network = current_evaluation_network();
+    auto const loaded_tablebase = current_tablebase();
+    auto const root_moves = list_root_moves(position);
+    auto const num_shares = std::max(
+        std::size_t{1}, std::min(executor ? executor->num_threads() : 1, root_moves.size()));
+
+    // Deal the moves out by index, so that each share (and so the result) does not depend on how
+    // fast the threads run. Each share gets its own MultiPV search and table, so the best
+    // `num_exact` moves of each share are exact, which includes the best `num_exact` overall.
+    auto shares = std::vector<std::vector<RootMove>>(num_shares);
+    for (auto i = std::size_t{}; i < root_moves.size(); ++i)
+        shares[i % num_shares].push_back(root_moves[i]);
+
+    auto const analyze_share = [&](std::vector<RootMove>& share) {
+        auto& table = this_thread_table();
+        table.reset();
+        table.set_symmetric(false);
+
+        auto control = SearchControl{};
+        control.tablebase = loaded_tablebase.get();
+        share = search_root_moves(
+            std::move(share),
+            max_depth,
+            num_exact.value_or(MoveList::capacity()),
+            &table,
+            &control,
+            network.get());
+    };
+
+    auto tasks = TaskGroup{executor ? &executor->thread_pool() : nullptr};
+    for (auto& share : shares)
+        tasks.run([&] { analyze_share(share); });
+    tasks.wait();
+
+    // Note, the nodes of each analysis are only those searched for that move
+    auto result = std::map<Move, PositionAnalysis>{};
+    for (auto const& share : shares)
+        for (auto const& root_move : share)
+            result[*root_move.move.to_standard_move()] = root_move.analysis;
+
     return result;
 }
 
 auto select_analysis_with_softmax(
     std::map<Move, PositionAnalysis> const& moves, double softmax_parameter) -> PositionAnalysis
 {
-    static auto rng = std::ranlux24{std::random_device{}()};
+    auto& rng = this_thread_analysis_state().rng;
 
     // Weight each move according to its score and the softmax function
     auto weights = std::vector<double>(moves.size());
@@ -195,6 +742,56 @@ namespace
         }
     }
 
+    /**
+     * A move of the loaded book, picked at random in proportion to the weights
+     */
+    auto pick_book_move(Position const& position) -> std::optional<Move>
+    {
+        auto const moves = probe_opening_book(position);
+
+        auto total_weight = u64{};
+        for (auto const& book_move : moves)
+            total_weight += book_move.weight;
+        if (total_weight == 0)
+            return std::nullopt;
+
+        auto& rng = this_thread_analysis_state().rng;
+        auto choice = std::uniform_int_distribution<u64>(0, total_weight - 1)(rng);
+        for (auto const& book_move : moves)
+        {
+            if (choice < book_move.weight)
+                return book_move.move;
+            choice -= book_move.weight;
+        }
+        return std::nullopt;
+    }
+
+    auto iterations_from_difficulty(int difficulty) -> u64
+    {
+        assert(difficulty >= 0);
+        return u64{100} << std::min(difficulty, 16);
+    }
+
+    /**
+     * One of the explored moves, picked at random with weights of its number of visits to the
+     * power of the softmax parameter
+     */
+    auto select_monte_carlo_move(std::vector<MonteCarloMove> const& moves, double softmax_parameter)
+        -> std::optional<MonteCarloMove>
+    {
+        if (moves.empty())
+            return std::nullopt;
+
+        auto weights = std::vector<double>(moves.size());
+        std::transform(moves.begin(), moves.end(), weights.begin(), [&](auto const& move) {
+            return std::pow(static_cast<double>(move.visits), softmax_parameter);
+        });
+
+        auto& rng = this_thread_analysis_state().rng;
+        auto dist = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+        return moves[dist(rng)];
+    }
+
     auto softmax_parameter_from_difficulty(int difficulty) -> std::optional<double>
     {
         assert(difficulty >= 0);
@@ -226,75 +823,403 @@ namespace
     }
 }  // namespace
 
-auto analyze_position_with_ai_difficulty_level(Position const& position, int ai_level)
+auto analyze_position_with_ai_difficulty_level(
+    Position const& position, int ai_level, Executor* executor) -> PositionAnalysis
+{
+    return analyze_position_with_ai_difficulty_level(
+        position, ai_level, SearchEngine::AlphaBeta, executor);
+}
+
+auto analyze_position_with_ai_difficulty_level(
+    Position const& position, int ai_level, SearchEngine engine, Executor* executor)
     -> PositionAnalysis
 {
     auto const depth = depth_from_difficulty(ai_level);
     auto const softmax = softmax_parameter_from_difficulty(ai_level);
 
+    if (!softmax.has_value())
+    {
+        if (auto const book_move = pick_book_move(position))
+            return PositionAnalysis{book_move, {*book_move}, 0, 0};
+    }
+
+    if (engine == SearchEngine::MonteCarlo)
+    {
+        auto limits = SearchLimits{};
+        limits.engine = SearchEngine::MonteCarlo;
+        limits.nodes = iterations_from_difficulty(ai_level);
+        limits.keep_transpositions = true;
+        auto const nodes = grow_monte_carlo_tree(position, limits, executor);
+
+        auto const& tree = this_thread_monte_carlo_tree();
+        if (!softmax.has_value())
+            return make_monte_carlo_analysis(position, tree.best_move(), nodes);
+        return make_monte_carlo_analysis(
+            position, select_monte_carlo_move(tree.root_moves(), *softmax), nodes);
+    }
+
     if (softmax.has_value())
     {
-        auto const moves = analyze_available_moves(position, depth);
-        return select_analysis_with_softmax(moves, softmax.value());
+        auto const moves = analyze_available_moves(position, depth, std::nullopt, executor);
+        auto analysis = select_analysis_with_softmax(moves, softmax.value());
+
+        analysis.nodes = 0;
+        for (auto const& [move, move_analysis] : moves)
+            analysis.nodes += move_analysis.nodes;
+
+        return analysis;
     }
-    else
+
+    return analyze_position(position, depth);
+}
+
+auto analyze_positions(
+    Position const* positions,
+    std::size_t count,
+    SearchLimits const& limits,
+    Executor& executor,
+    std::function<void(std::size_t, PositionAnalysis const&)> const& callback) -> void
+{
+    // One task per position, each using the table of whichever thread runs it
+    auto callback_mutex = std::mutex{};
+    auto is_cancelled = std::atomic<bool>{};
+    auto tasks = TaskGroup{&executor.thread_pool()};
+
+    for (auto i = std::size_t{}; i < count && !is_cancelled; ++i)
     {
-        return analyze_position(position, depth);
+        tasks.run([&, i] {
+            if (is_cancelled)
+                return;
+
+            auto const analysis = analyze_position(positions[i], limits);
+
+            auto const lock = std::lock_guard{callback_mutex};
+            if (is_cancelled)
+                return;
+
+            try
+            {
+                callback(i, analysis);
+            }
+            catch (...)
+            {
+                is_cancelled = true;
+                throw;
+            }
+        });
     }
+
+    tasks.wait();
+}
+
+auto analyze_positions(
+    std::vector<Position> const& positions, SearchLimits const& limits, Executor& executor)
+    -> std::vector<PositionAnalysis>
+{
+    auto result = std::vector<PositionAnalysis>(positions.size());
+    analyze_positions(
+        positions.data(),
+        positions.size(),
+        limits,
+        executor,
+        [&](std::size_t index, PositionAnalysis const& analysis) { result[index] = analysis; });
+    return result;
 }
 
 struct GameAnalyzer::Impl
 {
-    Impl() = default;
+    explicit Impl(GameAnalyzer* owner) : owner{owner}, worker{[this] { run(); }} {}
 
-    bool is_analyzing{};
-    TranspositionTable transposition_table{};
-    Position position{};
-    InternalMoveRecommendation best_recommendation_so_far{};
-    int current_depth{};
-    int max_depth{100};
+    ~Impl()
+    {
+        {
+            auto const lock = std::lock_guard{mutex};
+            shutting_down = true;
+            stop_requested = true;
+        }
+        condition.notify_all();
+        worker.join();
+    }
+
+    auto start(std::unique_lock<std::mutex>&, Position, SearchLimits const&, bool ponder) -> void;
+    auto run() -> void;
+    auto search(
+        Position const&,
+        SearchLimits const&,
+        bool keep_table,
+        std::function<void(GameAnalyzer&)> const& report_callback) -> void;
+    auto publish_progress(InternalMoveRecommendation const&, int depth, u64 nodes) -> void;
+    auto publish_analysis(PositionAnalysis) -> void;
+
+    GameAnalyzer* owner;
+
+    // Guarded by the mutex
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    std::optional<Position> pending_position{};
+    SearchLimits pending_limits{};
+    bool pending_keeps_table{};
     std::function<void(GameAnalyzer&)> report_callback{};
-    bool stop_requested{};
+    std::function<void(GameAnalyzer&)> finished_callback{};
+    bool shutting_down{};
+
+    // The position and limits of the latest analysis, also guarded by the mutex
+    std::optional<Position> analyzed_position{};
+    SearchLimits limits{};
+
+    std::atomic<bool> is_analyzing{};
+    std::atomic<bool> is_pondering{};
+    std::atomic<bool> stop_requested{};
+
+    // Set on a ponder hit, in ticks of the search clock
+    std::atomic<SearchClock::rep> ponder_hit_time{};
+    std::atomic<SearchClock::rep> deadline{SearchControl::no_deadline};
+
+    std::atomic<int> current_depth{};
+    std::atomic<int> max_depth{100};
+
+    // Readable from any thread (the analysis through atomic shared_ptr operations)
+    std::shared_ptr<PositionAnalysis const> best_analysis{};
+    AtomicSnapshot<4> progress{};
+
+    // Only used by the worker thread
+    TranspositionTable transposition_table{};
+
+    // Declared last, so that everything it uses is constructed before it starts
+    std::thread worker;
 };
 
-GameAnalyzer::GameAnalyzer() : impl_{std::make_unique<Impl>()}
-{}
+namespace
+{
+    auto encode_move(std::optional<Move> move) -> u64
+    {
+        if (!move)
+            return 0;
+        return u64{1} << 16 | u64{move->from.data()} << 8 | u64{move->to.data()};
+    }
 
-auto GameAnalyzer::analyze_position(Position position) -> void
+    auto decode_move(u64 bits) -> std::optional<Move>
+    {
+        if (!(bits >> 16))
+            return std::nullopt;
+        return Move{BoardCoordinates{(bits >> 8) & 0xff}, BoardCoordinates{bits & 0xff}};
+    }
+}  // namespace
+
+auto GameAnalyzer::Impl::run() -> void
 {
-    if (impl_->is_analyzing)
-        return;
+    auto lock = std::unique_lock{mutex};
+
+    while (true)
+    {
+        condition.wait(lock, [&] { return shutting_down || pending_position.has_value(); });
+        if (shutting_down)
+            return;
+
+        auto const position = *pending_position;
+        auto const search_limits = pending_limits;
+        auto const keep_table = pending_keeps_table;
+        auto const callback = report_callback;
+        auto const finished = finished_callback;
+        pending_position.reset();
+
+        lock.unlock();
+        search(position, search_limits, keep_table, callback);
+        if (finished)
+            finished(*owner);
+        lock.lock();
+
+        is_analyzing = false;
+        is_pondering = false;
+        condition.notify_all();
+    }
+}
 
-    impl_->stop_requested = false;
-    impl_->is_analyzing = true;
-    impl_->transposition_table.reset();
-    impl_->best_recommendation_so_far = InternalMoveRecommendation{};
-    impl_->current_depth = 0;
-    impl_->position = position;
+auto GameAnalyzer::Impl::search(
+    Position const& position,
+    SearchLimits const& search_limits,
+    bool keep_table,
+    std::function<void(GameAnalyzer&)> const& callback) -> void
+{
+    auto time_manager = TimeManager(search_limits);
+    auto was_pondering = is_pondering.load();
+
+    if (keep_table)
+        transposition_table.age();
+    else
+        transposition_table.reset();
+    transposition_table.set_symmetric(search_limits.symmetric_transpositions);
+
+    auto const network = current_evaluation_network();
+    auto const loaded_tablebase = current_tablebase();
+    auto control = SearchControl{};
+    control.stop_token = &stop_requested;
+    control.tablebase = loaded_tablebase.get();
+
+    auto best_recommendation = InternalMoveRecommendation{};
+    auto const publish = [&](int depth) {
+        auto analysis = make_analysis(position, best_recommendation, transposition_table);
+        analysis.nodes = control.nodes;
+        publish_progress(best_recommendation, depth, control.nodes);
+        publish_analysis(std::move(analysis));
+    };
 
-    for (; impl_->current_depth <= impl_->max_depth; ++impl_->current_depth)
+    auto const last_depth = std::min(search_limits.depth.value_or(max_depth), max_depth.load());
+
+    for (auto depth = 0; depth <= last_depth; ++depth)
     {
-        auto searcher =
-            Searcher(impl_->current_depth, &impl_->transposition_table, &impl_->stop_requested);
+        current_depth = depth;
 
-        auto const recommendation =
-            searcher.search(impl_->position.friends(), impl_->position.enemies());
+        auto searcher = Searcher(depth, &transposition_table, &control, network.get());
+        auto const recommendation = searcher.search_root(position.friends(), position.enemies());
 
-        if (impl_->stop_requested)
+        if (control.stopped)
         {
-            // Recommendation is incomplete
-            if (recommendation.score > impl_->best_recommendation_so_far.score)
-                impl_->best_recommendation_so_far = recommendation;
+            // An abandoned depth is discarded, as in `deepen`, as its score and move may rest on
+            // moves it never got to. Only depth 1 runs without limits, so can only be abandoned
+            // through `stop_analysis`, and the move it has found so far is then kept, so that
+            // there is a move to play.
+            if (depth == 1 && recommendation.move.to_standard_move())
+            {
+                best_recommendation = recommendation;
+                publish(depth);
+            }
             break;
         }
 
-        impl_->best_recommendation_so_far = recommendation;
+        best_recommendation = recommendation;
+        publish(depth);
+
+        if (callback)
+            callback(*owner);
+
+        // Depth 0 has no move, and depth 1 always completes
+        if (depth == 0)
+            continue;
 
-        if (impl_->report_callback)
-            impl_->report_callback(*this);
+        // A ponder hit can set the deadline in the middle of a depth, so it is shared with the
+        // thread that reports the hit
+        control.deadline_token = &deadline;
+
+        // No limits apply until the ponder hit, after which they apply as if the search had
+        // only just started
+        if (is_pondering)
+            continue;
+        if (was_pondering)
+        {
+            was_pondering = false;
+            time_manager = TimeManager(
+                search_limits,
+                SearchClock::time_point{SearchClock::duration{ponder_hit_time.load()}});
+        }
+
+        if (!time_manager.should_start_next_iteration())
+            break;
+
+        control.set_limits(time_manager, search_limits);
+        if (control.stopped)
+            break;
     }
+}
+
+auto GameAnalyzer::Impl::publish_progress(
+    InternalMoveRecommendation const& recommendation, int depth, u64 nodes) -> void
+{
+    progress.store({
+        encode_move(recommendation.move.to_standard_move()),
+        static_cast<u64>(recommendation.score),
+        static_cast<u64>(depth),
+        nodes,
+    });
+}
+
+auto GameAnalyzer::Impl::publish_analysis(PositionAnalysis analysis) -> void
+{
+    std::atomic_store(
+        &best_analysis, std::make_shared<PositionAnalysis const>(std::move(analysis)));
+}
+
+GameAnalyzer::GameAnalyzer() : impl_{std::make_unique<Impl>(this)}
+{}
+
+auto GameAnalyzer::analyze_position(Position position) -> void
+{
+    analyze_position(position, SearchLimits{});
+}
+
+auto GameAnalyzer::Impl::start(
+    std::unique_lock<std::mutex>& lock,
+    Position position,
+    SearchLimits const& search_limits,
+    bool ponder) -> void
+{
+    // Whatever was searched while pondering is still likely to be useful, as is what was searched
+    // for the previous move when starting to ponder
+    auto const keep_table = ponder || is_pondering;
+
+    stop_requested = true;
+    condition.wait(lock, [&] { return !is_analyzing; });
+
+    stop_requested = false;
+    current_depth = 0;
+    deadline = SearchControl::no_deadline;
+    publish_progress(InternalMoveRecommendation{}, 0, 0);
+    publish_analysis(make_analysis(position, InternalMoveRecommendation{}));
+
+    analyzed_position = position;
+    limits = search_limits;
+
+    pending_position = position;
+    pending_limits = search_limits;
+    pending_keeps_table = keep_table;
+    is_pondering = ponder;
+    is_analyzing = true;
+    condition.notify_all();
+}
+
+auto GameAnalyzer::analyze_position(Position position, SearchLimits const& limits) -> void
+{
+    auto lock = std::unique_lock{impl_->mutex};
+    impl_->start(lock, position, limits, false);
+}
+
+auto GameAnalyzer::ponder(Position position, SearchLimits const& limits) -> std::optional<Move>
+{
+    auto lock = std::unique_lock{impl_->mutex};
+
+    // The expected reply is only known if our move was the one the last analysis recommended
+    auto const analysis = best_analysis_so_far();
+    auto const& pv = analysis.principal_variation;
+    if (!impl_->analyzed_position || pv.size() < 2)
+        return std::nullopt;
+
+    auto const expected = apply_move(pv[0], *impl_->analyzed_position);
+    if (expected.friends() != position.friends() || expected.enemies() != position.enemies() ||
+        expected.player_to_move() != position.player_to_move())
+        return std::nullopt;
+
+    impl_->start(lock, apply_move(pv[1], position), limits, true);
+    return pv[1];
+}
 
-    impl_->is_analyzing = false;
+auto GameAnalyzer::ponder_hit() -> void
+{
+    auto const lock = std::lock_guard{impl_->mutex};
+    if (!impl_->is_pondering)
+        return;
+
+    auto const now = SearchClock::now();
+    auto const deadline = TimeManager(impl_->limits, now).hard_deadline();
+
+    impl_->ponder_hit_time = now.time_since_epoch().count();
+    impl_->deadline =
+        deadline ? deadline->time_since_epoch().count() : SearchControl::no_deadline;
+    impl_->is_pondering = false;
+}
+
+auto GameAnalyzer::is_pondering() const -> bool
+{
+    return impl_->is_pondering;
 }
 
 auto GameAnalyzer::stop_analysis() -> void
@@ -302,6 +1227,12 @@ auto GameAnalyzer::stop_analysis() -> void
     impl_->stop_requested = true;
 }
 
+auto GameAnalyzer::wait_for_analysis() -> void
+{
+    auto lock = std::unique_lock{impl_->mutex};
+    impl_->condition.wait(lock, [&] { return !impl_->is_analyzing; });
+}
+
 auto GameAnalyzer::is_analysis_ongoing() const -> bool
 {
     return impl_->is_analyzing;
@@ -314,13 +1245,20 @@ auto GameAnalyzer::set_max_depth(int max) -> void
 
 auto GameAnalyzer::set_report_callback(std::function<void(GameAnalyzer&)> f) -> void
 {
+    auto const lock = std::lock_guard{impl_->mutex};
     impl_->report_callback = std::move(f);
 }
 
+auto GameAnalyzer::set_finished_callback(std::function<void(GameAnalyzer&)> f) -> void
+{
+    auto const lock = std::lock_guard{impl_->mutex};
+    impl_->finished_callback = std::move(f);
+}
+
 auto GameAnalyzer::best_analysis_so_far() -> PositionAnalysis
 {
-    return make_analysis(
-        impl_->position, impl_->best_recommendation_so_far, impl_->transposition_table);
+    auto const analysis = std::atomic_load(&impl_->best_analysis);
+    return analysis ? *analysis : PositionAnalysis{};
 }
 
 auto GameAnalyzer::current_depth() const -> int
@@ -328,6 +1266,151 @@ auto GameAnalyzer::current_depth() const -> int
     return impl_->current_depth;
 }
 
+auto GameAnalyzer::progress() const -> AnalysisProgress
+{
+    auto const values = impl_->progress.load();
+    return {
+        decode_move(values[0]),
+        static_cast<ScoreType>(values[1]),
+        static_cast<int>(values[2]),
+        values[3],
+    };
+}
+
 GameAnalyzer::~GameAnalyzer() = default;
 
+namespace
+{
+    /**
+     * The size to give a transposition table to fit it in the memory
+     */
+    auto table_size_for(std::size_t megabytes) -> std::size_t
+    {
+        auto const bytes = std::max(std::size_t{1}, megabytes) << 20;
+        auto size = std::size_t{1};
+        while ((std::size_t{4} << size) * sizeof(TranspositionTable::Value) <= bytes)
+            ++size;
+        return size;
+    }
+}  // namespace
+
+struct AnalysisService::Impl
+{
+    Impl(Executor& executor, AnalysisServiceConfig const& config)
+        : executor{&executor}, table{table_size_for(config.table_megabytes), /*is_shared=*/true}
+    {
+        table.set_symmetric(config.symmetric_transpositions);
+    }
+
+    auto analyze(Position const&, SearchLimits const&, std::atomic<bool> const& stop)
+        -> PositionAnalysis;
+    auto finish(RequestId) -> void;
+
+    Executor* executor;
+
+    // Only aged while no analysis is running
+    TranspositionTable table;
+
+    // The stop flags of the analyses that are not done yet, guarded by the mutex
+    mutable std::mutex mutex{};
+    std::condition_variable idle{};
+    std::unordered_map<RequestId, std::shared_ptr<std::atomic<bool>>> pending{};
+    RequestId next_id{1};
+};
+
+auto AnalysisService::Impl::analyze(
+    Position const& position, SearchLimits const& limits, std::atomic<bool> const& stop)
+    -> PositionAnalysis
+{
+    if (stop)
+        return make_analysis(position, InternalMoveRecommendation{});
+
+    // A Monte-Carlo analysis grows the tree of the thread that runs it, as it would on its own
+    if (limits.engine == SearchEngine::MonteCarlo)
+    {
+        auto const nodes = grow_monte_carlo_tree(position, limits, nullptr, &stop);
+        return make_monte_carlo_analysis(
+            position, this_thread_monte_carlo_tree().best_move(), nodes);
+    }
+
+    auto const network = current_evaluation_network();
+    auto const loaded_tablebase = current_tablebase();
+    auto control = SearchControl{};
+    control.stop_token = &stop;
+    control.tablebase = loaded_tablebase.get();
+    return deepen(position, limits, table, control, network.get());
+}
+
+auto AnalysisService::Impl::finish(RequestId id) -> void
+{
+    auto const lock = std::lock_guard{mutex};
+    pending.erase(id);
+    if (pending.empty())
+    {
+        table.age();
+        idle.notify_all();
+    }
+}
+
+AnalysisService::AnalysisService(Executor& executor, AnalysisServiceConfig const& config)
+    : impl_{std::make_unique<Impl>(executor, config)}
+{}
+
+auto AnalysisService::submit(Position const& position, SearchLimits const& limits, Callback f)
+    -> RequestId
+{
+    if (limits.engine == SearchEngine::AlphaBeta &&
+        limits.symmetric_transpositions != impl_->table.is_symmetric())
+        throw std::invalid_argument{"The symmetry of the transpositions is set by the service"};
+
+    auto const stop = std::make_shared<std::atomic<bool>>();
+    auto id = RequestId{};
+    {
+        auto const lock = std::lock_guard{impl_->mutex};
+        id = impl_->next_id++;
+        impl_->pending.emplace(id, stop);
+    }
+
+    // Always queued, as an analysis without limits only ends when cancelled, which the caller
+    // could not do if it were running the analysis
+    impl_->executor->thread_pool().enqueue(
+        [impl = impl_.get(), id, stop, position, limits, f = std::move(f)] {
+            f(id, impl->analyze(position, limits, *stop));
+            impl->finish(id);
+        });
+    return id;
+}
+
+auto AnalysisService::cancel(RequestId id) -> bool
+{
+    auto const lock = std::lock_guard{impl_->mutex};
+    auto const it = impl_->pending.find(id);
+    if (it == impl_->pending.end())
+        return false;
+    *it->second = true;
+    return true;
+}
+
+auto AnalysisService::wait() -> void
+{
+    auto lock = std::unique_lock{impl_->mutex};
+    impl_->idle.wait(lock, [&] { return impl_->pending.empty(); });
+}
+
+auto AnalysisService::num_pending() const -> std::size_t
+{
+    auto const lock = std::lock_guard{impl_->mutex};
+    return impl_->pending.size();
+}
+
+AnalysisService::~AnalysisService()
+{
+    {
+        auto const lock = std::lock_guard{impl_->mutex};
+        for (auto const& [id, stop] : impl_->pending)
+            *stop = true;
+    }
+    wait();
+}
+
 }  // namespace rock
@@ -0,0 +1,37 @@
+#include "rock/executor.h"
+#include "internal/thread_pool.h"
+#include <algorithm>
+#include <thread>
+
+namespace rock
+{
+
+namespace
+{
+    auto make_thread_pool_config(ExecutorConfig const& config) -> internal::ThreadPoolConfig
+    {
+        auto const num_threads = config.num_threads != 0
+            ? config.num_threads
+            : std::size_t{std::max(1u, std::thread::hardware_concurrency())};
+
+        return {num_threads, config.pin_threads, config.queue_capacity};
+    }
+}  // namespace
+
+Executor::Executor(ExecutorConfig const& config)
+    : pool_{std::make_unique<internal::ThreadPool>(make_thread_pool_config(config))}
+{}
+
+Executor::~Executor() = default;
+
+auto Executor::num_threads() const -> std::size_t
+{
+    return pool_->num_threads();
+}
+
+auto Executor::thread_pool() -> internal::ThreadPool&
+{
+    return *pool_;
+}
+
+}  // namespace rock
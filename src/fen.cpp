@@ -72,4 +72,23 @@ auto parse_fen_to_board(std::string_view fen) -> std::optional<rock::Board>
     return res;
 }
 
+auto parse_fen_to_position(std::string_view fen) -> std::optional<rock::Position>
+{
+    auto const board_end = fen.find(' ');
+    if (board_end == std::string_view::npos)
+        return std::nullopt;
+
+    auto const board = parse_fen_to_board(fen.substr(0, board_end));
+    auto const side_begin = fen.find_first_not_of(' ', board_end);
+    if (!board || side_begin == std::string_view::npos)
+        return std::nullopt;
+
+    auto const side = fen.substr(side_begin, fen.find(' ', side_begin) - side_begin);
+    if (side == "w" || side == "W")
+        return rock::Position{*board, rock::Player::White};
+    if (side == "b" || side == "B")
+        return rock::Position{*board, rock::Player::Black};
+    return std::nullopt;
+}
+
 }  // namespace rock
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "rock/common.h"
+#include <array>
+#include <atomic>
+
+namespace rock::internal
+{
+
+/**
+ * A group of values that one thread writes and any number of threads read, without locking
+ * (a sequence lock). Readers retry if they overlap with a write, so they always see a
+ * consistent set of values, and never block the writer.
+ */
+template <std::size_t N>
+struct AtomicSnapshot
+{
+    using Values = std::array<u64, N>;
+
+    /**
+     * Must only be called from one thread at a time
+     */
+    auto store(Values const& values) -> void
+    {
+        auto const seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (auto i = std::size_t{}; i < N; ++i)
+            values_[i].store(values[i], std::memory_order_relaxed);
+
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    auto load() const -> Values
+    {
+        auto res = Values{};
+
+        while (true)
+        {
+            auto const seq_before = sequence_.load(std::memory_order_acquire);
+
+            for (auto i = std::size_t{}; i < N; ++i)
+                res[i] = values_[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto const seq_after = sequence_.load(std::memory_order_relaxed);
+
+            if (seq_before == seq_after && seq_before % 2 == 0)
+                return res;
+        }
+    }
+
+private:
+    std::atomic<u64> sequence_{};
+    std::array<std::atomic<u64>, N> values_{};
+};
+
+}  // namespace rock::internal
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "evaluation_weights.h"
 #include "internal_types.h"
 #include "move_generation.h"
+#include "tuned_evaluation_weights.h"
 
 namespace rock::internal
 {
@@ -41,37 +43,83 @@ inline auto are_pieces_all_together(BitBoard const board) -> bool
     return (board ^ blob) == 0;
 }
 
-inline constexpr std::pair<BitBoard, ScoreType> important_positions[] = {
-    {all_circles.data[BoardCoordinates{3, 3}.data()][3], 10},
-    {all_circles.data[BoardCoordinates{3, 3}.data()][2], 10},
-    {all_circles.data[BoardCoordinates{3, 3}.data()][1], 10},
+inline constexpr BitBoard centre_circles[] = {
+    all_circles.data[BoardCoordinates{3, 3}.data()][1],
+    all_circles.data[BoardCoordinates{3, 3}.data()][2],
+    all_circles.data[BoardCoordinates{3, 3}.data()][3],
 };
 
+/**
+ * The terms that the evaluation weights multiply, used when tuning the weights
+ */
+inline auto evaluation_features(BitBoard friends, BitBoard enemies) -> EvaluationVector
+{
+    auto res = EvaluationVector{};
+
+    for (auto i = std::size_t{}; i < std::size(centre_circles); ++i)
+    {
+        res[i] += static_cast<ScoreType>(pop_count(centre_circles[i] & friends));
+        res[i] -= static_cast<ScoreType>(pop_count(centre_circles[i] & enemies));
+    }
+
+    res[3] = 1;
+
+    return res;
+}
+
 inline auto evaluate_leaf_position(
-    BitBoard friends, BitBoard enemies, bool has_player_won, bool has_player_lost) -> ScoreType
+    BitBoard friends,
+    BitBoard enemies,
+    bool has_player_won,
+    bool has_player_lost,
+    EvaluationWeights const& weights = tuned_evaluation_weights) -> ScoreType
 {
     auto res = ScoreType{};
 
     if (has_player_lost || has_player_won)
         res += big * static_cast<ScoreType>(has_player_won - has_player_lost);
 
-    for (auto const& [positions, value] : important_positions)
+    for (auto i = std::size_t{}; i < std::size(centre_circles); ++i)
     {
-        res += value * static_cast<ScoreType>(pop_count(positions & friends));
-        res -= value * static_cast<ScoreType>(pop_count(positions & enemies));
+        auto const friend_count = static_cast<ScoreType>(pop_count(centre_circles[i] & friends));
+        auto const enemy_count = static_cast<ScoreType>(pop_count(centre_circles[i] & enemies));
+        res += weights.centre_circles[i] * (friend_count - enemy_count);
     }
 
-    res += 20;
+    res += weights.tempo;
 
     return res;
 }
 
+/**
+ * Sources of evaluation weights for the search. The compiled weights are constexpr, so the
+ * evaluation is fully constant folded; the runtime weights can be loaded from a file (see
+ * `load_evaluation_weights`) at the cost of reading them from memory.
+ */
+struct CompiledEvaluationWeights
+{
+    static constexpr auto get() -> EvaluationWeights const& { return tuned_evaluation_weights; }
+};
+
+struct RuntimeEvaluationWeights
+{
+    static auto get() -> EvaluationWeights const& { return runtime_evaluation_weights; }
+};
+
+#ifdef ROCK_RUNTIME_EVALUATION_WEIGHTS
+using ActiveEvaluationWeights = RuntimeEvaluationWeights;
+#else
+using ActiveEvaluationWeights = CompiledEvaluationWeights;
+#endif
+
+template <typename Weights = ActiveEvaluationWeights>
 inline auto evaluate_leaf_position(BitBoard friends, BitBoard enemies) -> ScoreType
 {
     bool const has_player_won = are_pieces_all_together(friends);
     bool const has_player_lost = are_pieces_all_together(enemies);
 
-    return evaluate_leaf_position(friends, enemies, has_player_won, has_player_lost);
+    return evaluate_leaf_position(
+        friends, enemies, has_player_won, has_player_lost, Weights::get());
 }
 
 }  // namespace rock::internal
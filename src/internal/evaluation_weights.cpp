@@ -0,0 +1,57 @@
+#include "evaluation_weights.h"
+#include "tuned_evaluation_weights.h"
+#include <fmt/format.h>
+#include <sstream>
+
+namespace rock::internal
+{
+
+EvaluationWeights runtime_evaluation_weights = tuned_evaluation_weights;
+
+auto format_evaluation_weights(EvaluationWeights const& w) -> std::string
+{
+    return fmt::format(
+        "centre_circles {} {} {}\ntempo {}\n",
+        w.centre_circles[0],
+        w.centre_circles[1],
+        w.centre_circles[2],
+        w.tempo);
+}
+
+auto parse_evaluation_weights(std::string_view str, EvaluationWeights const& defaults)
+    -> std::optional<EvaluationWeights>
+{
+    auto res = defaults;
+    auto stream = std::istringstream(std::string{str});
+    auto line = std::string{};
+
+    while (std::getline(stream, line))
+    {
+        auto line_stream = std::istringstream(line);
+        auto name = std::string{};
+
+        if (!(line_stream >> name) || name.front() == '#')
+            continue;
+
+        if (name == "centre_circles")
+        {
+            for (auto& w : res.centre_circles)
+                line_stream >> w;
+        }
+        else if (name == "tempo")
+        {
+            line_stream >> res.tempo;
+        }
+        else
+        {
+            return std::nullopt;
+        }
+
+        if (line_stream.fail())
+            return std::nullopt;
+    }
+
+    return res;
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "rock/types.h"
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace rock::internal
+{
+
+/**
+ * The tunable weights of the heuristic evaluation. For a position that is not over, the
+ * evaluation is the dot product of these weights with `evaluation_features`.
+ */
+struct EvaluationWeights
+{
+    // Value of a piece within radius 1, 2 and 3 of the centre (the circles are nested, so a piece
+    // close to the centre scores for every circle it is in)
+    ScoreType centre_circles[3];
+
+    // Bonus for being the player to move
+    ScoreType tempo;
+};
+
+inline constexpr auto num_evaluation_weights = std::size_t{4};
+
+using EvaluationVector = std::array<ScoreType, num_evaluation_weights>;
+
+constexpr auto to_vector(EvaluationWeights const& w) -> EvaluationVector
+{
+    return {w.centre_circles[0], w.centre_circles[1], w.centre_circles[2], w.tempo};
+}
+
+constexpr auto from_vector(EvaluationVector const& v) -> EvaluationWeights
+{
+    return {{v[0], v[1], v[2]}, v[3]};
+}
+
+/**
+ * Text format for evaluation weights, one named weight per line:
+ *
+ *     centre_circles 10 10 10
+ *     tempo 20
+ *
+ * Weights missing from the input keep their value from `defaults`.
+ */
+auto format_evaluation_weights(EvaluationWeights const&) -> std::string;
+auto parse_evaluation_weights(std::string_view, EvaluationWeights const& defaults)
+    -> std::optional<EvaluationWeights>;
+
+/**
+ * The weights used by `RuntimeEvaluationWeights`. These are only written by
+ * `load_evaluation_weights`, which must not be called while an analysis is running.
+ */
+extern EvaluationWeights runtime_evaluation_weights;
+
+}  // namespace rock::internal
@@ -0,0 +1,263 @@
+#include "game_record.h"
+#include <fmt/format.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace rock::internal
+{
+
+namespace
+{
+    constexpr char positions_magic[8] = {'R', 'O', 'C', 'K', 'P', 'S', '0', '1'};
+    constexpr char games_magic[8] = {'R', 'O', 'C', 'K', 'G', 'M', '0', '2'};
+
+    constexpr auto square_bits = 6;
+    constexpr auto square_mask = u16{(1 << square_bits) - 1};
+
+    constexpr auto outcome_shift = 1;
+    constexpr auto max_outcome = static_cast<u8>(GameOutcome::Draw);
+
+    auto has_magic(MappedFile const& file, char const (&magic)[8]) -> bool
+    {
+        return file.size() >= sizeof(magic) &&
+            std::memcmp(file.data(), magic, sizeof(magic)) == 0;
+    }
+
+    /**
+     * The game at the start of the bytes, and the end of its record, without checking it
+     */
+    auto read_game(u8 const* bytes, u8 const* end, u8 const** record_end) -> GameRecordView
+    {
+        auto const size = static_cast<std::size_t>(end - bytes);
+        auto offset = std::size_t{};
+        auto const record_size = *read_varint(bytes, size, offset);
+        *record_end = bytes + offset + record_size;
+
+        auto const position = *decode_position_record(bytes + offset);
+        offset += position_record_size;
+        auto const num_moves = *read_varint(bytes, size, offset);
+
+        return GameRecordView{
+            position.position,
+            position.outcome,
+            PackedMoves{bytes + offset, static_cast<std::size_t>(num_moves)},
+        };
+    }
+}  // namespace
+
+auto encode_position_record(PositionRecord const& record, u8* out) -> void
+{
+    auto const white = record.position.board()[Player::White];
+    auto const black = record.position.board()[Player::Black];
+    std::memcpy(out, &white, sizeof(white));
+    std::memcpy(out + 8, &black, sizeof(black));
+    out[16] = static_cast<u8>(
+        (record.position.player_to_move() == Player::Black) |
+        (static_cast<u8>(record.outcome) << outcome_shift));
+}
+
+auto decode_position_record(u8 const* bytes) -> std::optional<PositionRecord>
+{
+    auto white = u64{};
+    auto black = u64{};
+    std::memcpy(&white, bytes, sizeof(white));
+    std::memcpy(&black, bytes + 8, sizeof(black));
+
+    auto const flags = bytes[16];
+    if ((white & black) != 0 || (flags >> outcome_shift) > max_outcome)
+        return std::nullopt;
+
+    return PositionRecord{
+        Position{Board{white, black}, (flags & 1) ? Player::Black : Player::White},
+        static_cast<GameOutcome>(flags >> outcome_shift),
+    };
+}
+
+auto pack_move(Move move) -> u16
+{
+    return static_cast<u16>(move.from.data() | (move.to.data() << square_bits));
+}
+
+auto unpack_move(u16 packed) -> Move
+{
+    return Move{
+        BoardCoordinates{packed & square_mask},
+        BoardCoordinates{(packed >> square_bits) & square_mask},
+    };
+}
+
+auto append_varint(std::vector<u8>& buffer, u64 value) -> void
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<u8>(value));
+}
+
+auto read_varint(u8 const* bytes, std::size_t size, std::size_t& offset) -> std::optional<u64>
+{
+    auto value = u64{};
+    for (auto shift = 0; shift < 64 && offset < size; shift += 7)
+    {
+        auto const byte = bytes[offset++];
+        value |= u64{byte & 0x7Fu} << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    return std::nullopt;
+}
+
+PositionRecordWriter::PositionRecordWriter(std::string const& path)
+    : path_{path}, file_{path, std::ios::binary}
+{
+    if (!file_)
+        throw std::runtime_error(fmt::format("Could not open '{}' for writing", path));
+    file_.write(positions_magic, sizeof(positions_magic));
+}
+
+auto PositionRecordWriter::write(PositionRecord const& record) -> void
+{
+    u8 bytes[position_record_size];
+    encode_position_record(record, bytes);
+    file_.write(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+    if (!file_)
+        throw std::runtime_error(fmt::format("Could not write '{}'", path_));
+    ++num_positions_;
+}
+
+auto PositionRecordFile::open(std::string const& path) -> std::optional<PositionRecordFile>
+{
+    auto file = MappedFile::open(path);
+    if (!file || !has_magic(*file, positions_magic) ||
+        (file->size() - sizeof(positions_magic)) % position_record_size != 0)
+        return std::nullopt;
+
+    auto positions = PositionRecordFile{std::move(*file)};
+    positions.records_ = positions.file_.data() + sizeof(positions_magic);
+    positions.size_ = (positions.file_.size() - sizeof(positions_magic)) / position_record_size;
+
+    for (auto i = std::size_t{}; i < positions.size_; ++i)
+    {
+        if (!decode_position_record(positions.records_ + i * position_record_size))
+            return std::nullopt;
+    }
+    return positions;
+}
+
+GameRecordWriter::GameRecordWriter(std::string const& path)
+    : path_{path}, file_{path, std::ios::binary}
+{
+    if (!file_)
+        throw std::runtime_error(fmt::format("Could not open '{}' for writing", path));
+    file_.write(games_magic, sizeof(games_magic));
+}
+
+auto GameRecordWriter::write(GameRecord const& game) -> void
+{
+    // The record is put together first, as it is preceded by its size
+    record_.assign(position_record_size, 0);
+    encode_position_record(PositionRecord{game.start, game.outcome}, record_.data());
+    append_varint(record_, game.moves.size());
+
+    auto const moves_offset = record_.size();
+    record_.resize(moves_offset + packed_moves_size(game.moves.size()));
+    auto* moves = record_.data() + moves_offset;
+    for (auto i = std::size_t{}; i + 1 < game.moves.size(); i += 2)
+    {
+        // Two moves in three bytes
+        auto const pair = pack_move(game.moves[i]) | (u32{pack_move(game.moves[i + 1])} << 12);
+        moves[i / 2 * 3] = static_cast<u8>(pair);
+        moves[i / 2 * 3 + 1] = static_cast<u8>(pair >> 8);
+        moves[i / 2 * 3 + 2] = static_cast<u8>(pair >> 16);
+    }
+    if (game.moves.size() % 2 != 0)
+    {
+        auto const last = pack_move(game.moves.back());
+        moves[game.moves.size() / 2 * 3] = static_cast<u8>(last);
+        moves[game.moves.size() / 2 * 3 + 1] = static_cast<u8>(last >> 8);
+    }
+
+    buffer_.clear();
+    append_varint(buffer_, record_.size());
+    buffer_.insert(buffer_.end(), record_.begin(), record_.end());
+
+    file_.write(
+        reinterpret_cast<char const*>(buffer_.data()),
+        static_cast<std::streamsize>(buffer_.size()));
+    if (!file_)
+        throw std::runtime_error(fmt::format("Could not write '{}'", path_));
+    ++num_games_;
+}
+
+auto GameRecordView::to_record() const -> GameRecord
+{
+    return GameRecord{start, std::vector<Move>(moves.begin(), moves.end()), outcome};
+}
+
+auto GameRecordFile::iterator::operator*() const -> GameRecordView
+{
+    auto const* record_end = bytes_;
+    return read_game(bytes_, end_, &record_end);
+}
+
+auto GameRecordFile::iterator::operator++() -> iterator&
+{
+    auto const size = static_cast<std::size_t>(end_ - bytes_);
+    auto offset = std::size_t{};
+    auto const record_size = *read_varint(bytes_, size, offset);
+    bytes_ += offset + record_size;
+    return *this;
+}
+
+auto GameRecordFile::open(std::string const& path) -> std::optional<GameRecordFile>
+{
+    auto file = MappedFile::open(path);
+    if (!file || !has_magic(*file, games_magic))
+        return std::nullopt;
+
+    auto games = GameRecordFile{std::move(*file)};
+    auto const* bytes = games.file_.data() + sizeof(games_magic);
+    auto const size = games.file_.size() - sizeof(games_magic);
+
+    // Check the framing of each record, and that its moves fill it exactly
+    auto offset = std::size_t{};
+    while (offset < size)
+    {
+        auto const record_size = read_varint(bytes, size, offset);
+        if (!record_size || *record_size > size - offset ||
+            *record_size < position_record_size + 1 ||
+            !decode_position_record(bytes + offset))
+            return std::nullopt;
+
+        auto const record_end = offset + static_cast<std::size_t>(*record_size);
+        auto moves_offset = offset + position_record_size;
+        auto const num_moves = read_varint(bytes, record_end, moves_offset);
+        if (!num_moves || *num_moves > record_end ||
+            moves_offset + packed_moves_size(static_cast<std::size_t>(*num_moves)) != record_end)
+            return std::nullopt;
+
+        offset = record_end;
+        ++games.num_games_;
+    }
+
+    games.games_ = bytes;
+    games.end_ = bytes + size;
+    return games;
+}
+
+auto read_game_records(std::string const& path) -> std::optional<std::vector<GameRecord>>
+{
+    auto const file = GameRecordFile::open(path);
+    if (!file)
+        return std::nullopt;
+
+    auto games = std::vector<GameRecord>{};
+    games.reserve(file->num_games());
+    for (auto const game : *file)
+        games.push_back(game.to_record());
+    return games;
+}
+
+}  // namespace rock::internal
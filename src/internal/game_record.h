@@ -0,0 +1,348 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "rock/algorithms.h"
+#include "rock/types.h"
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rock::internal
+{
+
+/**
+ * The size of a position record: white's pieces and black's pieces, 8 bytes each in native byte
+ * order like the other files of the library, then a byte with the player to move in bit 0 and a
+ * `GameOutcome` in bits 1 and 2
+ */
+constexpr auto position_record_size = std::size_t{17};
+
+/**
+ * A position, and the outcome of the game it was taken from or `GameOutcome::Ongoing` if it has
+ * none
+ */
+struct PositionRecord
+{
+    Position position;
+    GameOutcome outcome;
+};
+
+auto encode_position_record(PositionRecord const&, u8* out) -> void;
+
+/**
+ * Returns nothing if the bytes are not a valid record
+ */
+auto decode_position_record(u8 const* bytes) -> std::optional<PositionRecord>;
+
+/**
+ * A move in 12 bits: its from square in the low 6 bits and its to square in the next 6
+ */
+auto pack_move(Move) -> u16;
+auto unpack_move(u16 packed) -> Move;
+
+/**
+ * The number of bytes taken by moves packed two to three bytes, as in the game records
+ */
+constexpr auto packed_moves_size(std::size_t num_moves) -> std::size_t
+{
+    return (num_moves * 12 + 7) / 8;
+}
+
+/**
+ * The move at the index, of moves packed two to three bytes
+ */
+inline auto read_packed_move(u8 const* moves, std::size_t index) -> Move
+{
+    auto const* bytes = moves + index * 12 / 8;
+    auto const pair = static_cast<u16>(bytes[0] | (bytes[1] << 8));
+    return unpack_move(index % 2 == 0 ? pair : static_cast<u16>(pair >> 4));
+}
+
+/**
+ * Appends the number as a LEB128 varint: 7 bits per byte, lowest first, with the top bit set on
+ * every byte but the last
+ */
+auto append_varint(std::vector<u8>& buffer, u64 value) -> void;
+
+/**
+ * Reads a varint at the offset and moves the offset past it, or returns nothing if it runs past
+ * the size or does not fit 64 bits
+ */
+auto read_varint(u8 const* bytes, std::size_t size, std::size_t& offset) -> std::optional<u64>;
+
+/**
+ * Writes positions as fixed-width records, so that a file of them can be read in place
+ *
+ * The file holds an 8-byte header followed by one record of `position_record_size` bytes for each
+ * position.
+ */
+struct PositionRecordWriter
+{
+    /**
+     * Throws `std::runtime_error` if the file cannot be opened
+     */
+    explicit PositionRecordWriter(std::string const& path);
+
+    /**
+     * Throws `std::runtime_error` if the record cannot be written
+     */
+    auto write(PositionRecord const&) -> void;
+
+    auto num_positions() const -> std::size_t { return num_positions_; }
+
+private:
+    std::string path_;
+    std::ofstream file_;
+    std::size_t num_positions_{};
+};
+
+/**
+ * A file written by `PositionRecordWriter`, memory-mapped, whose records are decoded as they are
+ * read
+ */
+struct PositionRecordFile
+{
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = PositionRecord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = PositionRecord;
+
+        auto operator*() const -> PositionRecord { return *decode_position_record(bytes_); }
+        auto operator++() -> iterator&
+        {
+            bytes_ += position_record_size;
+            return *this;
+        }
+        auto operator==(iterator other) const -> bool { return bytes_ == other.bytes_; }
+        auto operator!=(iterator other) const -> bool { return bytes_ != other.bytes_; }
+
+    private:
+        friend struct PositionRecordFile;
+        explicit iterator(u8 const* bytes) : bytes_{bytes} {}
+        u8 const* bytes_;
+    };
+
+    /**
+     * Returns nothing if the file cannot be read, is not a file of positions, or holds an invalid
+     * record
+     */
+    static auto open(std::string const& path) -> std::optional<PositionRecordFile>;
+
+    auto size() const -> std::size_t { return size_; }
+    auto operator[](std::size_t index) const -> PositionRecord
+    {
+        return *decode_position_record(records_ + index * position_record_size);
+    }
+
+    auto begin() const -> iterator { return iterator{records_}; }
+    auto end() const -> iterator { return iterator{records_ + size_ * position_record_size}; }
+
+private:
+    explicit PositionRecordFile(MappedFile file) : file_{std::move(file)} {}
+
+    MappedFile file_;
+    u8 const* records_{};
+    std::size_t size_{};
+};
+
+/**
+ * A finished game: where it started, the moves played from there, and how it ended
+ */
+struct GameRecord
+{
+    Position start;
+    std::vector<Move> moves;
+    GameOutcome outcome;
+};
+
+/**
+ * Writes games in a compact binary form, as used for self-play
+ *
+ * The file holds an 8-byte header followed by one record for each game, each of them:
+ *
+ *     varint    the size of the rest of the record
+ *     17 bytes  the starting position, as a position record with the outcome of the game
+ *     varint    the number of moves
+ *     ...       the moves, each in 12 bits (see `pack_move`), two to three bytes
+ *
+ * so that a game of 60 moves takes 109 bytes.
+ */
+struct GameRecordWriter
+{
+    /**
+     * Throws `std::runtime_error` if the file cannot be opened
+     */
+    explicit GameRecordWriter(std::string const& path);
+
+    /**
+     * Throws `std::runtime_error` if the record cannot be written
+     */
+    auto write(GameRecord const&) -> void;
+
+    auto num_games() const -> std::size_t { return num_games_; }
+
+private:
+    std::string path_;
+    std::ofstream file_;
+    std::vector<u8> buffer_{};
+    std::vector<u8> record_{};
+    std::size_t num_games_{};
+};
+
+/**
+ * Moves packed two to three bytes, unpacked as they are read
+ */
+struct PackedMoves
+{
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Move;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Move;
+
+        auto operator*() const -> Move { return read_packed_move(data_, index_); }
+        auto operator++() -> iterator&
+        {
+            ++index_;
+            return *this;
+        }
+        auto operator==(iterator other) const -> bool { return index_ == other.index_; }
+        auto operator!=(iterator other) const -> bool { return index_ != other.index_; }
+
+    private:
+        friend struct PackedMoves;
+        iterator(u8 const* data, std::size_t index) : data_{data}, index_{index} {}
+        u8 const* data_;
+        std::size_t index_;
+    };
+
+    auto size() const -> std::size_t { return num_moves; }
+    auto operator[](std::size_t index) const -> Move { return read_packed_move(data, index); }
+    auto begin() const -> iterator { return iterator{data, 0}; }
+    auto end() const -> iterator { return iterator{data, num_moves}; }
+
+    u8 const* data;
+    std::size_t num_moves;
+};
+
+/**
+ * The positions of a game, from its start up to the one before its last move, each computed from
+ * the one before as they are read
+ */
+struct GamePositions
+{
+    struct iterator
+    {
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Position;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Position const*;
+        using reference = Position const&;
+
+        auto operator*() const -> Position const& { return position_; }
+        auto operator->() const -> Position const* { return &position_; }
+        auto operator++() -> iterator&
+        {
+            position_ = apply_move(read_packed_move(moves_, index_), position_);
+            ++index_;
+            return *this;
+        }
+        auto operator==(iterator const& other) const -> bool { return index_ == other.index_; }
+        auto operator!=(iterator const& other) const -> bool { return index_ != other.index_; }
+
+    private:
+        friend struct GamePositions;
+        iterator(Position position, u8 const* moves, std::size_t index)
+            : position_{position}, moves_{moves}, index_{index}
+        {}
+        Position position_;
+        u8 const* moves_;
+        std::size_t index_;
+    };
+
+    auto begin() const -> iterator { return iterator{start, moves.data, 0}; }
+    auto end() const -> iterator { return iterator{start, moves.data, moves.num_moves}; }
+
+    Position start;
+    PackedMoves moves;
+};
+
+/**
+ * A game in a `GameRecordFile`, read in place
+ */
+struct GameRecordView
+{
+    auto positions() const -> GamePositions { return GamePositions{start, moves}; }
+    auto to_record() const -> GameRecord;
+
+    Position start;
+    GameOutcome outcome;
+    PackedMoves moves;
+};
+
+/**
+ * A file written by `GameRecordWriter`, memory-mapped, whose games are read in place
+ *
+ * The framing of the records is checked when the file is opened, so that reading them needs no
+ * checks. Their moves are trusted to be legal, as checking them would mean replaying every game:
+ * any 12 bits unpack to a move between two squares of the board, so an illegal one is still read
+ * and applied safely, but gives positions that could not arise in the game.
+ */
+struct GameRecordFile
+{
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = GameRecordView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = GameRecordView;
+
+        auto operator*() const -> GameRecordView;
+        auto operator++() -> iterator&;
+        auto operator==(iterator other) const -> bool { return bytes_ == other.bytes_; }
+        auto operator!=(iterator other) const -> bool { return bytes_ != other.bytes_; }
+
+    private:
+        friend struct GameRecordFile;
+        iterator(u8 const* bytes, u8 const* end) : bytes_{bytes}, end_{end} {}
+        u8 const* bytes_;
+        u8 const* end_;
+    };
+
+    /**
+     * Returns nothing if the file cannot be read, is not a file of games, or is truncated or
+     * otherwise invalid
+     */
+    static auto open(std::string const& path) -> std::optional<GameRecordFile>;
+
+    auto num_games() const -> std::size_t { return num_games_; }
+
+    auto begin() const -> iterator { return iterator{games_, end_}; }
+    auto end() const -> iterator { return iterator{end_, end_}; }
+
+private:
+    explicit GameRecordFile(MappedFile file) : file_{std::move(file)} {}
+
+    MappedFile file_;
+    u8 const* games_{};
+    u8 const* end_{};
+    std::size_t num_games_{};
+};
+
+/**
+ * All the games of a file written by `GameRecordWriter`, or nothing if the file cannot be read or
+ * is not a file of games
+ */
+auto read_game_records(std::string const& path) -> std::optional<std::vector<GameRecord>>;
+
+}  // namespace rock::internal
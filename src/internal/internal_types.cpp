@@ -8,12 +8,17 @@ namespace
 {
     auto extract_pv_line(Position p, TranspositionTable const& table) -> std::vector<Move>
     {
+        // The entries can lead back to an earlier position of the line, so stop at a length that
+        // no search reaches
+        constexpr auto max_length = std::size_t{128};
+
         auto moves = std::vector<Move>{};
 
-        while (true)
+        while (moves.size() < max_length)
         {
-            auto const [value, was_found] = table.lookup(p.friends(), p.enemies());
-            if (!was_found || value->type != NodeType::Pv)
+            // Helper threads may still be writing to a shared table
+            auto const value = table.load(p.friends(), p.enemies());
+            if (!value || value->type != NodeType::Pv)
                 break;
 
             auto const move = value->recommendation.move.to_standard_move();
@@ -54,6 +54,17 @@ struct InternalMove
     }
 };
 
+/**
+ * The result of a game with best play, for the player to move
+ */
+enum struct GameResult
+{
+    Unknown,
+    Win,
+    Loss,
+    Draw,
+};
+
 struct InternalMoveRecommendation
 {
     InternalMove move;
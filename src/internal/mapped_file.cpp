@@ -0,0 +1,84 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROCK_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rock::internal
+{
+
+auto MappedFile::open(std::string const& path) -> std::optional<MappedFile>
+{
+    auto file = MappedFile{};
+
+#ifdef ROCK_MMAP
+    auto const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::nullopt;
+
+    struct stat file_stat = {};
+    if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    auto const size = static_cast<std::size_t>(file_stat.st_size);
+    auto* const mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return std::nullopt;
+
+    file.mapping_ = mapping;
+    file.data_ = static_cast<u8 const*>(mapping);
+    file.size_ = size;
+#else
+    auto stream = std::ifstream(path, std::ios::binary);
+    if (!stream)
+        return std::nullopt;
+
+    file.contents_.assign(
+        std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{});
+    if (file.contents_.empty())
+        return std::nullopt;
+
+    file.data_ = file.contents_.data();
+    file.size_ = file.contents_.size();
+#endif
+
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)},
+      mapping_{std::exchange(other.mapping_, nullptr)},
+      contents_{std::move(other.contents_)}
+{}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile&
+{
+    auto moved = std::move(other);
+    std::swap(data_, moved.data_);
+    std::swap(size_, moved.size_);
+    std::swap(mapping_, moved.mapping_);
+    std::swap(contents_, moved.contents_);
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef ROCK_MMAP
+    if (mapping_)
+        ::munmap(mapping_, size_);
+#endif
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "rock/types.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace rock::internal
+{
+
+/**
+ * The contents of a file, memory-mapped read-only where the platform allows it, and read into
+ * memory otherwise
+ */
+struct MappedFile
+{
+    /**
+     * Returns nothing if the file cannot be read or is empty
+     */
+    static auto open(std::string const& path) -> std::optional<MappedFile>;
+
+    MappedFile(MappedFile&&) noexcept;
+    auto operator=(MappedFile&&) noexcept -> MappedFile&;
+    ~MappedFile();
+
+    auto data() const -> u8 const* { return data_; }
+    auto size() const -> std::size_t { return size_; }
+
+private:
+    MappedFile() = default;
+
+    u8 const* data_{};
+    std::size_t size_{};
+
+    void* mapping_{};
+    std::vector<u8> contents_{};  // Used instead of a mapping where there is no mmap
+};
+
+}  // namespace rock::internal
@@ -0,0 +1,103 @@
+#include "match_statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rock::internal
+{
+
+namespace
+{
+    // Of a normal distribution, the number of standard deviations either side of the mean that
+    // hold 95% of it
+    constexpr auto z_95 = 1.959964;
+
+    auto score_from_elo(double elo) -> double
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    auto elo_from_score(double score) -> double
+    {
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    /**
+     * The variance of the score of a single game
+     */
+    auto score_variance(double wins, double draws, double losses) -> double
+    {
+        auto const num_games = wins + draws + losses;
+        auto const score = (wins + 0.5 * draws) / num_games;
+        return (wins * (1.0 - score) * (1.0 - score) + draws * (0.5 - score) * (0.5 - score) +
+                losses * score * score) /
+            num_games;
+    }
+}  // namespace
+
+auto MatchResults::score() const -> double
+{
+    if (num_games() == 0)
+        return 0.5;
+    return (static_cast<double>(wins) + 0.5 * static_cast<double>(draws)) /
+        static_cast<double>(num_games());
+}
+
+auto estimate_elo(MatchResults const& results) -> std::optional<EloEstimate>
+{
+    if (results.num_games() == 0)
+        return std::nullopt;
+
+    auto const score = results.score();
+    if (score == 0.0 || score == 1.0)
+        return EloEstimate{elo_from_score(score), std::numeric_limits<double>::infinity()};
+
+    auto const variance = score_variance(
+        static_cast<double>(results.wins),
+        static_cast<double>(results.draws),
+        static_cast<double>(results.losses));
+    auto const margin = z_95 * std::sqrt(variance / static_cast<double>(results.num_games()));
+
+    auto const low = elo_from_score(std::max(0.0, score - margin));
+    auto const high = elo_from_score(std::min(1.0, score + margin));
+    return EloEstimate{elo_from_score(score), (high - low) / 2.0};
+}
+
+auto SprtSettings::lower_bound() const -> double
+{
+    return std::log(beta / (1.0 - alpha));
+}
+
+auto SprtSettings::upper_bound() const -> double
+{
+    return std::log((1.0 - beta) / alpha);
+}
+
+auto sprt_log_likelihood_ratio(MatchResults const& results, SprtSettings const& settings)
+    -> double
+{
+    if (results.num_games() == 0)
+        return 0.0;
+
+    auto const score0 = score_from_elo(settings.elo0);
+    auto const score1 = score_from_elo(settings.elo1);
+    auto const variance = score_variance(
+        static_cast<double>(results.wins) + 0.5,
+        static_cast<double>(results.draws) + 0.5,
+        static_cast<double>(results.losses) + 0.5);
+
+    return static_cast<double>(results.num_games()) * (score1 - score0) *
+        (2.0 * results.score() - score0 - score1) / (2.0 * variance);
+}
+
+auto sprt_decision(MatchResults const& results, SprtSettings const& settings) -> SprtDecision
+{
+    auto const llr = sprt_log_likelihood_ratio(results, settings);
+    if (llr >= settings.upper_bound())
+        return SprtDecision::AcceptElo1;
+    if (llr <= settings.lower_bound())
+        return SprtDecision::AcceptElo0;
+    return SprtDecision::Continue;
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "rock/types.h"
+#include <optional>
+
+namespace rock::internal
+{
+
+/**
+ * The games of a match between two engines, counted from the point of view of the first
+ */
+struct MatchResults
+{
+    u64 wins{};
+    u64 draws{};
+    u64 losses{};
+
+    auto num_games() const -> u64 { return wins + draws + losses; }
+
+    /**
+     * The mean score per game, counting a draw as half a win, or 0.5 before any games
+     */
+    auto score() const -> double;
+};
+
+/**
+ * The difference in Elo rating of two engines, and the half-width of its 95% confidence interval
+ */
+struct EloEstimate
+{
+    double elo;
+    double error;
+};
+
+/**
+ * The Elo difference the results of a match point to, or nothing before any games. If one side
+ * won every game, the difference and its error are infinite.
+ */
+auto estimate_elo(MatchResults const&) -> std::optional<EloEstimate>;
+
+/**
+ * A sequential probability ratio test of whether the first engine is `elo0` or `elo1` stronger
+ * than the second, stopping with at most a probability of `alpha` of wrongly accepting `elo1`,
+ * and of `beta` of wrongly accepting `elo0`.
+ */
+struct SprtSettings
+{
+    double elo0{0.0};
+    double elo1{10.0};
+    double alpha{0.05};
+    double beta{0.05};
+
+    auto lower_bound() const -> double;
+    auto upper_bound() const -> double;
+};
+
+enum struct SprtDecision
+{
+    Continue,
+    AcceptElo0,
+    AcceptElo1,
+};
+
+/**
+ * The log-likelihood ratio of `elo1` against `elo0`, with the normal approximation of the
+ * generalized SPRT. The variance of the score of a game is estimated as if the results had half a
+ * game more of each outcome, so that a match that one side wins every game of still ends.
+ */
+auto sprt_log_likelihood_ratio(MatchResults const&, SprtSettings const&) -> double;
+auto sprt_decision(MatchResults const&, SprtSettings const&) -> SprtDecision;
+
+}  // namespace rock::internal
@@ -0,0 +1,483 @@
+#include "monte_carlo.h"
+#include "evaluate.h"
+#include "move_generation.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace rock::internal
+{
+
+namespace
+{
+    // How steeply the value of a position rises with its score: a score of 50, a few pieces more
+    // in the centre, is worth a value of about 0.73
+    constexpr auto score_scale = 0.02;
+
+    // The most moves a position can have, each piece having at most eight directions
+    constexpr auto max_moves = u32{12 * 8};
+
+    auto next_random(u64& state) -> u64
+    {
+        // splitmix64
+        auto x = (state += u64{0x9E3779B97F4A7C15});
+        x = (x ^ (x >> 30)) * u64{0xBF58476D1CE4E5B9};
+        x = (x ^ (x >> 27)) * u64{0x94D049BB133111EB};
+        return x ^ (x >> 31);
+    }
+
+    auto square_of(u64 board) -> u8
+    {
+        return static_cast<u8>(coordinates_from_bit_board(board));
+    }
+
+    auto count_move_list(InternalMoveList const& moves) -> u32
+    {
+        auto num_moves = u32{};
+        for (auto const& move_set : moves)
+            num_moves += static_cast<u32>(pop_count(move_set.to_board));
+        return num_moves;
+    }
+
+    /**
+     * The move at the given index, counting the destinations of each move set in turn
+     */
+    auto nth_move(InternalMoveList const& moves, u64 index) -> InternalMove
+    {
+        for (auto move_set : moves)
+        {
+            auto const count = pop_count(move_set.to_board);
+            if (index < count)
+            {
+                while (index-- > 0)
+                    extract_one_bit(move_set.to_board);
+                return InternalMove{move_set.from_board, extract_one_bit(move_set.to_board)};
+            }
+            index -= count;
+        }
+        return InternalMove{};
+    }
+}  // namespace
+
+MonteCarloTree::MonteCarloTree(std::size_t max_nodes)
+    : nodes_{new Node[std::max<std::size_t>(max_nodes, 1)]},
+      max_nodes_{std::min<std::size_t>(
+          std::max<std::size_t>(max_nodes, 1), std::numeric_limits<u32>::max())}
+{
+    clear();
+}
+
+auto MonteCarloTree::clear() -> void
+{
+    auto& root = nodes_[0];
+    root.value.store(0, std::memory_order_relaxed);
+    root.visits.store(0, std::memory_order_relaxed);
+    root.first_child = 0;
+    root.num_children = 0;
+    root.state.store(Unexpanded, std::memory_order_relaxed);
+    num_nodes_.store(1, std::memory_order_relaxed);
+}
+
+auto MonteCarloTree::set_root(
+    BitBoard friends, BitBoard enemies, MonteCarloSettings const& settings) -> bool
+{
+    auto const old_friends = root_friends_;
+    auto const old_enemies = root_enemies_;
+    root_friends_ = friends;
+    root_enemies_ = enemies;
+
+    if (settings != settings_)
+    {
+        settings_ = settings;
+        clear();
+        return false;
+    }
+
+    if (friends == old_friends && enemies == old_enemies)
+        return true;
+
+    // Look for the position among the children and grandchildren of the old root, where it is
+    // the turn of the opponent and then of the same player again
+    auto const& root = nodes_[0];
+    if (root.state.load(std::memory_order_relaxed) == Expanded)
+    {
+        for (auto i = root.first_child; i < root.first_child + root.num_children; ++i)
+        {
+            auto const& child = nodes_[i];
+            auto child_friends = old_friends;
+            auto child_enemies = old_enemies;
+            auto const move = child.move();
+            apply_move_low_level(move.from_board, move.to_board, &child_friends, &child_enemies);
+            if (child_enemies == friends && child_friends == enemies)
+            {
+                keep_subtree(i);
+                return true;
+            }
+
+            if (child.state.load(std::memory_order_relaxed) != Expanded)
+                continue;
+
+            for (auto j = child.first_child; j < child.first_child + child.num_children; ++j)
+            {
+                auto grandchild_friends = child_enemies;
+                auto grandchild_enemies = child_friends;
+                auto const reply = nodes_[j].move();
+                apply_move_low_level(
+                    reply.from_board, reply.to_board, &grandchild_friends, &grandchild_enemies);
+                if (grandchild_enemies == friends && grandchild_friends == enemies)
+                {
+                    keep_subtree(j);
+                    return true;
+                }
+            }
+        }
+    }
+
+    clear();
+    return false;
+}
+
+/**
+ * Move the subtree to the start of the arena, in breadth-first order so that the children of each
+ * node stay together. The copy goes through a separate list, as a node can be moved to where a
+ * node of the subtree has yet to be read from.
+ */
+auto MonteCarloTree::keep_subtree(u32 new_root) -> void
+{
+    struct Copy
+    {
+        u64 value;
+        u32 visits;
+        u32 first_child;
+        u8 num_children;
+        u8 state;
+        u8 from_square;
+        u8 to_square;
+    };
+
+    auto copies = std::vector<Copy>{};
+    auto old_indices = std::vector<u32>{new_root};
+    for (auto i = std::size_t{}; i < old_indices.size(); ++i)
+    {
+        auto const& node = nodes_[old_indices[i]];
+        auto const state = node.state.load(std::memory_order_relaxed);
+        auto copy = Copy{
+            node.value.load(std::memory_order_relaxed),
+            node.visits.load(std::memory_order_relaxed),
+            0,
+            0,
+            state,
+            node.from_square,
+            node.to_square,
+        };
+
+        if (state == Expanded)
+        {
+            copy.first_child = static_cast<u32>(old_indices.size());
+            copy.num_children = node.num_children;
+            for (auto j = node.first_child; j < node.first_child + node.num_children; ++j)
+                old_indices.push_back(j);
+        }
+        copies.push_back(copy);
+    }
+
+    for (auto i = std::size_t{}; i < copies.size(); ++i)
+    {
+        auto const& copy = copies[i];
+        auto& node = nodes_[i];
+        node.value.store(copy.value, std::memory_order_relaxed);
+        node.visits.store(copy.visits, std::memory_order_relaxed);
+        node.first_child = copy.first_child;
+        node.num_children = copy.num_children;
+        node.state.store(copy.state, std::memory_order_relaxed);
+        node.from_square = copy.from_square;
+        node.to_square = copy.to_square;
+    }
+    num_nodes_.store(static_cast<u32>(copies.size()), std::memory_order_relaxed);
+}
+
+auto MonteCarloTree::search(SearchControl& control, u64 seed) -> void
+{
+    auto path = std::vector<u32>{};
+    auto rng_state = seed;
+
+    while (!control.is_stopped())
+    {
+        iterate(path, rng_state);
+        control.count_node();
+
+        // A finished game has nothing to search
+        if (is_finished(nodes_[0].state.load(std::memory_order_relaxed)))
+            break;
+    }
+}
+
+auto MonteCarloTree::iterate(std::vector<u32>& path, u64& rng_state) -> void
+{
+    path.clear();
+    auto friends = root_friends_;
+    auto enemies = root_enemies_;
+    auto index = u32{};
+
+    // For the player to move at the last node of the path
+    auto result = u64{};
+
+    while (true)
+    {
+        auto& node = nodes_[index];
+        path.push_back(index);
+        auto const visits = node.visits.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto const state = node.state.load(std::memory_order_acquire);
+
+        if (is_finished(state))
+        {
+            result = finished_value(state);
+            break;
+        }
+
+        if (state != Expanded)
+        {
+            bool const has_won = are_pieces_all_together(friends);
+            bool const has_lost = are_pieces_all_together(enemies);
+            if (has_won || has_lost)
+            {
+                auto const final_state = has_won && has_lost ? Drawn : has_won ? Won : Lost;
+                node.state.store(final_state, std::memory_order_relaxed);
+                result = finished_value(final_state);
+                break;
+            }
+
+            // If another thread is expanding the node, this visit only values it
+            if (state == Unexpanded && (index == 0 || visits >= expansion_visits) &&
+                expand(index, friends, enemies) &&
+                node.state.load(std::memory_order_relaxed) == Drawn)
+            {
+                result = value_scale / 2;
+                break;
+            }
+
+            result = evaluate(friends, enemies, rng_state);
+            break;
+        }
+
+        // The child with the highest upper confidence bound, trying each child once first
+        auto const log_visits = std::log(static_cast<double>(visits));
+        auto best = node.first_child;
+        auto best_bound = -std::numeric_limits<double>::infinity();
+        for (auto i = node.first_child; i < node.first_child + node.num_children; ++i)
+        {
+            auto const child_visits = nodes_[i].visits.load(std::memory_order_relaxed);
+            if (child_visits == 0)
+            {
+                best = i;
+                break;
+            }
+
+            auto const value_sum = nodes_[i].value.load(std::memory_order_relaxed);
+            auto const value =
+                static_cast<double>(value_sum) / static_cast<double>(value_scale * child_visits);
+            auto const bound = value + settings_.exploration * std::sqrt(log_visits / child_visits);
+            if (bound > best_bound)
+            {
+                best = i;
+                best_bound = bound;
+            }
+        }
+
+        auto const move = nodes_[best].move();
+        apply_move_low_level(move.from_board, move.to_board, &friends, &enemies);
+        std::swap(friends, enemies);
+        index = best;
+    }
+
+    // The value of each node is for the player who moved to it
+    for (auto i = path.size(); i-- > 0;)
+    {
+        result = value_scale - result;
+        nodes_[path[i]].value.fetch_add(result, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Add the children of the node, unless another thread got to it first or there is no room for
+ * them. A position without moves is a draw, which is only found here.
+ */
+auto MonteCarloTree::expand(u32 index, BitBoard friends, BitBoard enemies) -> bool
+{
+    auto& node = nodes_[index];
+
+    // Checked first, so that a full arena costs no move generation
+    if (num_nodes_.load(std::memory_order_relaxed) + max_moves > max_nodes_)
+        return false;
+
+    auto expected = u8{Unexpanded};
+    if (!node.state.compare_exchange_strong(expected, Expanding, std::memory_order_acquire))
+        return false;
+
+    auto moves = generate_moves(friends, enemies);
+    auto const num_moves = count_move_list(moves);
+    if (num_moves == 0)
+    {
+        node.state.store(Drawn, std::memory_order_release);
+        return true;
+    }
+
+    auto first = num_nodes_.load(std::memory_order_relaxed);
+    do
+    {
+        if (first + num_moves > max_nodes_)
+        {
+            node.state.store(Unexpanded, std::memory_order_release);
+            return false;
+        }
+    } while (!num_nodes_.compare_exchange_weak(
+        first, first + num_moves, std::memory_order_relaxed));
+
+    auto child = first;
+    for_each_move(moves, [&](u64 from_board, u64 to_board) {
+        auto& child_node = nodes_[child++];
+        child_node.value.store(0, std::memory_order_relaxed);
+        child_node.visits.store(0, std::memory_order_relaxed);
+        child_node.first_child = 0;
+        child_node.num_children = 0;
+        child_node.state.store(Unexpanded, std::memory_order_relaxed);
+        child_node.from_square = square_of(from_board);
+        child_node.to_square = square_of(to_board);
+    });
+
+    node.first_child = first;
+    node.num_children = static_cast<u8>(num_moves);
+    node.state.store(Expanded, std::memory_order_release);
+    return true;
+}
+
+/**
+ * The value of a position that is not a finished game, for the player to move
+ */
+auto MonteCarloTree::evaluate(BitBoard friends, BitBoard enemies, u64& rng_state) const -> u64
+{
+    // Whether the player to move at the end of the playout is the other player
+    auto is_other_player = false;
+
+    for (auto ply = 0; ply < settings_.playout_plies; ++ply)
+    {
+        auto const moves = generate_moves(friends, enemies);
+        auto const num_moves = count_move_list(moves);
+        if (num_moves == 0)
+            return value_scale / 2;
+
+        auto const move = nth_move(moves, next_random(rng_state) % num_moves);
+        apply_move_low_level(move.from_board, move.to_board, &friends, &enemies);
+        std::swap(friends, enemies);
+        is_other_player = !is_other_player;
+
+        bool const has_won = are_pieces_all_together(friends);
+        bool const has_lost = are_pieces_all_together(enemies);
+        if (has_won || has_lost)
+        {
+            auto const value = has_won && has_lost ? value_scale / 2 : has_won ? value_scale : 0;
+            return is_other_player ? value_scale - value : value;
+        }
+    }
+
+    auto const* network = settings_.network;
+    auto const score = network
+        ? evaluate_leaf_position(
+              false, false, *network, refresh_accumulator(*network, friends, enemies))
+        : evaluate_leaf_position(friends, enemies, false, false, ActiveEvaluationWeights::get());
+
+    auto const probability = 1.0 / (1.0 + std::exp(-score_scale * static_cast<double>(score)));
+    auto const value = static_cast<u64>(std::lround(probability * value_scale));
+    return is_other_player ? value_scale - value : value;
+}
+
+auto MonteCarloTree::to_move(Node const& node) const -> MonteCarloMove
+{
+    auto const visits = node.visits.load(std::memory_order_relaxed);
+    auto const state = node.state.load(std::memory_order_relaxed);
+    auto const value_sum = node.value.load(std::memory_order_relaxed);
+    auto const value = visits == 0
+        ? 0.5
+        : static_cast<double>(value_sum) / static_cast<double>(value_scale * visits);
+    return MonteCarloMove{node.move(), visits, value, is_finished(state)};
+}
+
+auto MonteCarloTree::find_root_child(InternalMove move) const -> Node const*
+{
+    auto const& root = nodes_[0];
+    if (root.state.load(std::memory_order_acquire) != Expanded)
+        return nullptr;
+
+    for (auto i = root.first_child; i < root.first_child + root.num_children; ++i)
+    {
+        if (nodes_[i].move() == move)
+            return &nodes_[i];
+    }
+    return nullptr;
+}
+
+auto MonteCarloTree::root_moves() const -> std::vector<MonteCarloMove>
+{
+    auto moves = std::vector<MonteCarloMove>{};
+    auto const& root = nodes_[0];
+    if (root.state.load(std::memory_order_acquire) != Expanded)
+        return moves;
+
+    for (auto i = root.first_child; i < root.first_child + root.num_children; ++i)
+    {
+        if (nodes_[i].visits.load(std::memory_order_relaxed) > 0)
+            moves.push_back(to_move(nodes_[i]));
+    }
+    return moves;
+}
+
+auto MonteCarloTree::best_move() const -> std::optional<MonteCarloMove>
+{
+    auto const moves = root_moves();
+    auto const best = std::max_element(
+        moves.begin(), moves.end(), [](auto const& a, auto const& b) {
+            return std::pair{a.visits, a.value} < std::pair{b.visits, b.value};
+        });
+    if (best == moves.end())
+        return std::nullopt;
+    return *best;
+}
+
+auto MonteCarloTree::analysis_for(Position const& position, MonteCarloMove const& move) const
+    -> PositionAnalysis
+{
+    auto score = ScoreType{};
+    if (move.is_terminal)
+        score = move.value > 0.75 ? big : move.value < 0.25 ? -big : ScoreType{};
+    else
+    {
+        // The inverse of the mapping of scores to values
+        auto const value = std::clamp(move.value, 1e-6, 1.0 - 1e-6);
+        score = static_cast<ScoreType>(std::lround(std::log(value / (1.0 - value)) / score_scale));
+    }
+
+    auto analysis = internal::make_analysis(position, InternalMoveRecommendation{move.move, score});
+    analysis.principal_variation.push_back(*move.move.to_standard_move());
+
+    // The most visited moves after it, as far as the tree goes
+    auto const* node = find_root_child(move.move);
+    while (node && node->state.load(std::memory_order_acquire) == Expanded)
+    {
+        Node const* next = nullptr;
+        for (auto i = node->first_child; i < node->first_child + node->num_children; ++i)
+        {
+            auto const visits = nodes_[i].visits.load(std::memory_order_relaxed);
+            if (visits > 0 && (!next || visits > next->visits.load(std::memory_order_relaxed)))
+                next = &nodes_[i];
+        }
+        if (!next)
+            break;
+
+        analysis.principal_variation.push_back(*next->move().to_standard_move());
+        node = next;
+    }
+    return analysis;
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "internal_types.h"
+#include "nnue.h"
+#include "search.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace rock::internal
+{
+
+/**
+ * How a Monte-Carlo search values and explores its tree
+ */
+struct MonteCarloSettings
+{
+    // The weight of exploration against the value of a move in the UCT formula
+    double exploration{0.7};
+
+    // The number of random moves played from a leaf before evaluating the position reached, or 0
+    // to evaluate the leaf itself
+    int playout_plies{};
+
+    // If set, used for the evaluation instead of the heuristic one
+    EvaluationNetwork const* network{};
+
+    friend auto operator==(MonteCarloSettings const& a, MonteCarloSettings const& b) -> bool
+    {
+        return a.exploration == b.exploration && a.playout_plies == b.playout_plies &&
+            a.network == b.network;
+    }
+    friend auto operator!=(MonteCarloSettings const& a, MonteCarloSettings const& b) -> bool
+    {
+        return !(a == b);
+    }
+};
+
+/**
+ * The statistics of a move from the root of a Monte-Carlo tree
+ */
+struct MonteCarloMove
+{
+    InternalMove move;
+    u32 visits;
+
+    // The average result for the player to move, from 0 for a loss to 1 for a win
+    double value;
+
+    // Whether the move ends the game, and so its value is exact
+    bool is_terminal;
+};
+
+/**
+ * Monte-Carlo tree search with UCT, in an arena of nodes allocated up front
+ *
+ * Each iteration follows the child with the best upper confidence bound from the root down to a
+ * leaf, values the leaf with the evaluation function (or with a short random playout), and adds
+ * the result to the nodes on the way. A leaf is expanded once it has been visited
+ * `expansion_visits` times, so that nodes are not spent on positions that are only visited once.
+ * Finished games are recognised on their first visit and always give their exact result.
+ *
+ * Several threads can search the same tree at once. Each visit is counted on the way down, before
+ * its result is known, which counts as a loss until the result is added: this "virtual loss"
+ * steers the other threads away from the paths already being explored. Once the arena is full,
+ * the leaves are still valued but no longer expanded.
+ *
+ * The tree is kept between searches, so that a search of a position reached from the previous
+ * root carries on from the part of the tree below it.
+ */
+struct MonteCarloTree
+{
+    static constexpr u32 expansion_visits = 2;
+
+    explicit MonteCarloTree(std::size_t max_nodes);
+
+    /**
+     * Make the position the root of the tree. If it is the current root, or was reached from it
+     * in one or two moves, with the same settings, the part of the tree below it is kept and moved
+     * to the start of the arena, and true is returned. Otherwise the tree starts again.
+     */
+    auto set_root(BitBoard friends, BitBoard enemies, MonteCarloSettings const&) -> bool;
+
+    /**
+     * Start the tree again, so that the next search keeps nothing of the ones before it
+     */
+    auto clear() -> void;
+
+    /**
+     * Run iterations until the control is stopped, counting one node per iteration. May be called
+     * from several threads at once, but not at the same time as any other member function.
+     */
+    auto search(SearchControl& control, u64 seed) -> void;
+
+    /**
+     * The moves from the root that have been visited, or none if the root is a finished game
+     */
+    auto root_moves() const -> std::vector<MonteCarloMove>;
+
+    /**
+     * The most visited of the root moves
+     */
+    auto best_move() const -> std::optional<MonteCarloMove>;
+
+    /**
+     * The analysis of the root position, for one of its moves: the principal variation follows
+     * the most visited moves after it. The score is an exact win, loss or draw for a move that
+     * ends the game, and otherwise is scaled from the value of the move to the size of the scores
+     * of the evaluation.
+     */
+    auto analysis_for(Position const&, MonteCarloMove const&) const -> PositionAnalysis;
+
+    auto num_nodes() const -> std::size_t { return num_nodes_.load(std::memory_order_relaxed); }
+    auto root_visits() const -> u32 { return nodes_[0].visits.load(std::memory_order_relaxed); }
+
+private:
+    enum NodeState : u8
+    {
+        Unexpanded,
+        Expanding,
+        Expanded,
+
+        // Finished games, for the player to move at the node
+        Won,
+        Lost,
+        Drawn,
+    };
+
+    struct Node
+    {
+        // The sum of the results, for the player who made the move to the node, in units of
+        // `1 / value_scale`
+        std::atomic<u64> value{};
+
+        // Including the visits whose results are still to be added
+        std::atomic<u32> visits{};
+
+        // The children are stored together, and there are none until the node is expanded. They
+        // are written before the state is set to expanded, and not changed afterwards.
+        u32 first_child{};
+        u8 num_children{};
+
+        std::atomic<u8> state{};
+
+        // The squares of the move to the node from its parent, to keep the node small
+        u8 from_square{};
+        u8 to_square{};
+
+        auto move() const -> InternalMove
+        {
+            return InternalMove{u64{1} << from_square, u64{1} << to_square};
+        }
+    };
+
+    static constexpr u64 value_scale = u64{1} << 16;
+
+    static auto is_finished(u8 state) -> bool
+    {
+        return state == Won || state == Lost || state == Drawn;
+    }
+
+    static auto finished_value(u8 state) -> u64
+    {
+        return state == Won ? value_scale : state == Lost ? 0 : value_scale / 2;
+    }
+
+    auto keep_subtree(u32 new_root) -> void;
+    auto iterate(std::vector<u32>& path, u64& rng_state) -> void;
+    auto expand(u32 index, BitBoard friends, BitBoard enemies) -> bool;
+    auto evaluate(BitBoard friends, BitBoard enemies, u64& rng_state) const -> u64;
+    auto to_move(Node const&) const -> MonteCarloMove;
+    auto find_root_child(InternalMove) const -> Node const*;
+
+    std::unique_ptr<Node[]> nodes_;
+    std::size_t max_nodes_;
+    std::atomic<u32> num_nodes_{};
+
+    BitBoard root_friends_{};
+    BitBoard root_enemies_{};
+    MonteCarloSettings settings_{};
+};
+
+}  // namespace rock::internal
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "internal_types.h"
+#include "move_generation.h"
+#include "search.h"
+#include "transposition_table.h"
+#include <algorithm>
+#include <vector>
+
+namespace rock::internal
+{
+
+/**
+ * The result of searching one of the moves from the root
+ */
+struct RootMove
+{
+    InternalMove move;
+    Position position;
+
+    // The result of the search of `position`, so from the point of view of the opponent
+    InternalMoveRecommendation reply{};
+
+    // Otherwise, the move is known not to be among the best, and its score is only a bound
+    bool is_exact{};
+
+    // Includes the principal variation from `position` if the score is exact
+    PositionAnalysis analysis{};
+
+    // The nodes searched for this move, over all depths
+    u64 nodes{};
+};
+
+inline auto list_root_moves(Position const& position) -> std::vector<RootMove>
+{
+    auto root_moves = std::vector<RootMove>{};
+    auto moves = generate_moves(position.friends(), position.enemies());
+    for_each_move(moves, [&](u64 from, u64 to) {
+        auto const move = InternalMove{from, to};
+        auto const new_position = apply_move(*move.to_standard_move(), position);
+        root_moves.push_back(RootMove{move, new_position});
+        root_moves.back().analysis = make_analysis(new_position, InternalMoveRecommendation{});
+    });
+    return root_moves;
+}
+
+/**
+ * Search the given moves from the root (see `list_root_moves`), giving exact scores to the best
+ * `num_exact` of them (MultiPV)
+ *
+ * All the moves are searched by one iterative deepening search, sharing the transposition table,
+ * and in each depth the moves are ordered by their scores from the previous one. Once there are
+ * `num_exact` exact scores in a depth, the remaining moves are searched with a window that only
+ * finds out whether they are better than the worst of those, which is all that is needed to know
+ * that they are not among the best.
+ *
+ * The principal variation of each move is taken straight after it is searched, as searching the
+ * other moves overwrites parts of it in the table.
+ */
+template <typename Weights = ActiveEvaluationWeights>
+auto search_root_moves(
+    std::vector<RootMove> root_moves,
+    int depth,
+    std::size_t num_exact,
+    TranspositionTable* table,
+    SearchControl* control,
+    EvaluationNetwork const* network = nullptr) -> std::vector<RootMove>
+{
+    assert(control);
+
+    for (auto d = 1; d <= depth; ++d)
+    {
+        // The best exact scores of this depth, from the point of view of the player at the root
+        auto best_scores = std::vector<ScoreType>{};
+
+        for (auto& root_move : root_moves)
+        {
+            auto const alpha = best_scores.size() < num_exact ? -big : best_scores.back();
+            auto const nodes_before = control->nodes;
+
+            auto searcher = BasicSearcher<Weights>(d - 1, table, control, network);
+            root_move.reply = searcher.search_root(
+                root_move.position.friends(), root_move.position.enemies(), -big, -alpha);
+            root_move.nodes += control->nodes - nodes_before;
+
+            auto const score = -root_move.reply.score;
+            root_move.is_exact = alpha == -big || score > alpha;
+
+            if (root_move.is_exact)
+            {
+                best_scores.insert(
+                    std::upper_bound(
+                        best_scores.begin(), best_scores.end(), score, std::greater<>{}),
+                    score);
+                if (best_scores.size() > num_exact)
+                    best_scores.pop_back();
+            }
+
+            if (d == depth)
+            {
+                root_move.analysis = root_move.is_exact
+                    ? make_analysis(root_move.position, root_move.reply, *table)
+                    : make_analysis(root_move.position, root_move.reply);
+            }
+        }
+
+        // Search the best moves first in the next depth
+        std::stable_sort(root_moves.begin(), root_moves.end(), [](auto const& a, auto const& b) {
+            return a.reply.score < b.reply.score;
+        });
+    }
+
+    for (auto& root_move : root_moves)
+        root_move.analysis.nodes = root_move.nodes;
+
+    return root_moves;
+}
+
+}  // namespace rock::internal
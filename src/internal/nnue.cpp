@@ -0,0 +1,146 @@
+#include "nnue.h"
+#include <fstream>
+#include <limits>
+
+namespace rock::internal
+{
+
+namespace
+{
+    constexpr char network_magic[4] = {'R', 'K', 'N', 'N'};
+    constexpr auto network_version = u32{1};
+
+    struct Reader
+    {
+        std::ifstream& in;
+
+        template <typename T>
+        auto read(T* out) -> bool
+        {
+            unsigned char bytes[sizeof(T)];
+            if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+                return false;
+
+            auto value = std::uint64_t{};
+            for (auto i = sizeof(T); i-- > 0;)
+                value = (value << 8) | bytes[i];
+            *out = static_cast<T>(value);
+            return true;
+        }
+
+        /**
+         * Read a value of type `OnDisk` into a (possibly wider) `T`
+         */
+        template <typename OnDisk, typename T>
+        auto read_as(T* out) -> bool
+        {
+            auto value = OnDisk{};
+            if (!read(&value))
+                return false;
+            *out = static_cast<T>(value);
+            return true;
+        }
+    };
+
+    struct Writer
+    {
+        std::ofstream& out;
+
+        template <typename T>
+        auto write(T value) -> void
+        {
+            auto bits = static_cast<std::uint64_t>(value);
+            for (auto i = std::size_t{}; i < sizeof(T); ++i, bits >>= 8)
+                out.put(static_cast<char>(bits & 0xff));
+        }
+
+        template <typename OnDisk, typename T>
+        auto write_as(T value) -> bool
+        {
+            if (value < std::numeric_limits<OnDisk>::min() ||
+                value > std::numeric_limits<OnDisk>::max())
+                return false;
+            write(static_cast<OnDisk>(value));
+            return true;
+        }
+    };
+}  // namespace
+
+auto load_evaluation_network(std::string const& path) -> std::unique_ptr<EvaluationNetwork>
+{
+    auto file = std::ifstream(path, std::ios::binary);
+    if (!file)
+        return nullptr;
+
+    char magic[4];
+    if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, network_magic))
+        return nullptr;
+
+    auto reader = Reader{file};
+    auto version = u32{};
+    auto accumulator_size = u32{};
+    auto hidden_size = u32{};
+
+    if (!reader.read(&version) || !reader.read(&accumulator_size) || !reader.read(&hidden_size))
+        return nullptr;
+
+    if (version != network_version || accumulator_size != EvaluationNetwork::accumulator_size ||
+        hidden_size != EvaluationNetwork::hidden_size)
+        return nullptr;
+
+    auto network = std::make_unique<EvaluationNetwork>();
+    auto ok = true;
+
+    for (auto& row : network->input_weights)
+        for (auto& w : row)
+            ok = ok && reader.read(&w);
+    for (auto& b : network->input_biases)
+        ok = ok && reader.read(&b);
+    for (auto& row : network->hidden_weights)
+        for (auto& w : row)
+            ok = ok && reader.read_as<std::int8_t>(&w);
+    for (auto& b : network->hidden_biases)
+        ok = ok && reader.read(&b);
+    for (auto& w : network->output_weights)
+        ok = ok && reader.read_as<std::int8_t>(&w);
+    ok = ok && reader.read(&network->output_bias);
+
+    if (!ok)
+        return nullptr;
+
+    return network;
+}
+
+auto save_evaluation_network(EvaluationNetwork const& network, std::string const& path) -> bool
+{
+    auto file = std::ofstream(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    file.write(network_magic, sizeof(network_magic));
+
+    auto writer = Writer{file};
+    writer.write(network_version);
+    writer.write(static_cast<u32>(EvaluationNetwork::accumulator_size));
+    writer.write(static_cast<u32>(EvaluationNetwork::hidden_size));
+
+    auto ok = true;
+
+    for (auto const& row : network.input_weights)
+        for (auto const w : row)
+            writer.write(w);
+    for (auto const b : network.input_biases)
+        writer.write(b);
+    for (auto const& row : network.hidden_weights)
+        for (auto const w : row)
+            ok = ok && writer.write_as<std::int8_t>(w);
+    for (auto const b : network.hidden_biases)
+        writer.write(b);
+    for (auto const w : network.output_weights)
+        ok = ok && writer.write_as<std::int8_t>(w);
+    writer.write(network.output_bias);
+
+    return ok && file.good();
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "evaluate.h"
+#include "move_generation.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ROCK_NNUE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROCK_NNUE_SSE2
+#endif
+
+namespace rock::internal
+{
+
+/**
+ * A small efficiently updatable neural network (NNUE) that can replace the heuristic evaluation.
+ *
+ * The 128 inputs are the squares occupied by the player to move (0-63) followed by the squares
+ * occupied by the opponent (64-127). The first layer is not evaluated directly, but kept in an
+ * accumulator that is updated incrementally as moves are made. Its clipped outputs, from the
+ * point of view of both players, feed a small hidden layer and then a single output.
+ *
+ * The hidden and output weights are int8 in the network file, but are held widened to int16 so
+ * that the hidden layer maps onto 16-bit multiply-add instructions.
+ */
+struct EvaluationNetwork
+{
+    static constexpr auto num_inputs = std::size_t{128};
+    static constexpr auto accumulator_size = std::size_t{32};
+    static constexpr auto hidden_size = std::size_t{32};
+
+    static constexpr auto activation_max = std::int16_t{127};
+    static constexpr auto hidden_shift = 6;
+    static constexpr auto output_scale = 16;
+
+    alignas(32) std::int16_t input_weights[num_inputs][accumulator_size];
+    alignas(32) std::int16_t input_biases[accumulator_size];
+    alignas(32) std::int16_t hidden_weights[hidden_size][2 * accumulator_size];
+    std::int32_t hidden_biases[hidden_size];
+    std::int16_t output_weights[hidden_size];
+    std::int32_t output_bias;
+};
+
+/**
+ * The first layer outputs for a position, from the point of view of the player to move and of
+ * their opponent. Making a move swaps the two.
+ */
+struct NetworkAccumulator
+{
+    alignas(32) std::int16_t friends_view[EvaluationNetwork::accumulator_size];
+    alignas(32) std::int16_t enemies_view[EvaluationNetwork::accumulator_size];
+};
+
+/**
+ * Network file format (all values little-endian):
+ *
+ *     "RKNN", u32 version, u32 accumulator_size, u32 hidden_size
+ *     i16 input_weights[128][accumulator_size], i16 input_biases[accumulator_size]
+ *     i8 hidden_weights[hidden_size][2 * accumulator_size], i32 hidden_biases[hidden_size]
+ *     i8 output_weights[hidden_size], i32 output_bias
+ *
+ * Loading returns nullptr if the file cannot be read or does not match this build's layer sizes.
+ * Saving returns false if a weight does not fit in its on-disk type.
+ */
+auto load_evaluation_network(std::string const& path) -> std::unique_ptr<EvaluationNetwork>;
+auto save_evaluation_network(EvaluationNetwork const&, std::string const& path) -> bool;
+
+namespace detail
+{
+    inline constexpr auto enemy_feature_offset = std::size_t{64};
+
+    template <typename F>
+    auto for_each_square(u64 board, F&& f) -> void
+    {
+        while (board)
+        {
+            auto const square = coordinates_from_bit_board(board);
+            board ^= bit_board_from_coordinates(square);
+            f(static_cast<std::size_t>(square));
+        }
+    }
+
+    inline auto refresh_view(
+        EvaluationNetwork const& network, u64 own, u64 other, std::int16_t* view) -> void
+    {
+        std::copy_n(network.input_biases, EvaluationNetwork::accumulator_size, view);
+
+        auto const add = [&](std::size_t feature) {
+            for (auto i = std::size_t{}; i < EvaluationNetwork::accumulator_size; ++i)
+                view[i] += network.input_weights[feature][i];
+        };
+
+        for_each_square(own, add);
+        for_each_square(other, [&](std::size_t sq) { add(enemy_feature_offset + sq); });
+    }
+
+    /**
+     * out = in + input_weights[added] - input_weights[removed] - input_weights[captured], where
+     * the captured feature is optional
+     */
+    inline auto update_view(
+        EvaluationNetwork const& network,
+        std::int16_t const* in,
+        std::int16_t* out,
+        std::size_t added,
+        std::size_t removed,
+        std::size_t const* captured) -> void
+    {
+        constexpr auto n = EvaluationNetwork::accumulator_size;
+
+        auto const* add = network.input_weights[added];
+        auto const* sub = network.input_weights[removed];
+        auto const* cap = captured ? network.input_weights[*captured] : nullptr;
+
+#if defined(ROCK_NNUE_AVX2)
+        for (auto i = std::size_t{}; i < n; i += 16)
+        {
+            auto const load = [](std::int16_t const* p) {
+                return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+            };
+            auto v = _mm256_add_epi16(load(in + i), load(add + i));
+            v = _mm256_sub_epi16(v, load(sub + i));
+            if (cap)
+                v = _mm256_sub_epi16(v, load(cap + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+#elif defined(ROCK_NNUE_SSE2)
+        for (auto i = std::size_t{}; i < n; i += 8)
+        {
+            auto const load = [](std::int16_t const* p) {
+                return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+            };
+            auto v = _mm_add_epi16(load(in + i), load(add + i));
+            v = _mm_sub_epi16(v, load(sub + i));
+            if (cap)
+                v = _mm_sub_epi16(v, load(cap + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+#else
+        for (auto i = std::size_t{}; i < n; ++i)
+            out[i] = static_cast<std::int16_t>(in[i] + add[i] - sub[i] - (cap ? cap[i] : 0));
+#endif
+    }
+
+    inline auto clipped(std::int32_t x, std::int32_t max) -> std::int32_t
+    {
+        return std::clamp(x, std::int32_t{0}, max);
+    }
+
+    inline auto output_layer(EvaluationNetwork const& network, std::int32_t const* hidden)
+        -> ScoreType
+    {
+        auto sum = network.output_bias;
+        for (auto j = std::size_t{}; j < EvaluationNetwork::hidden_size; ++j)
+            sum += network.output_weights[j] * hidden[j];
+        return static_cast<ScoreType>(sum / EvaluationNetwork::output_scale);
+    }
+}  // namespace detail
+
+inline auto refresh_accumulator(EvaluationNetwork const& network, u64 friends, u64 enemies)
+    -> NetworkAccumulator
+{
+    auto res = NetworkAccumulator{};
+    detail::refresh_view(network, friends, enemies, res.friends_view);
+    detail::refresh_view(network, enemies, friends, res.enemies_view);
+    return res;
+}
+
+/**
+ * Apply a move, and compute the accumulator for the resulting position (from the point of view
+ * of the opponent, who is then to move) from the three squares the move touches
+ */
+inline auto apply_move_low_level(
+    u64 const from,
+    u64 const to,
+    BitBoard* mine,
+    BitBoard* theirs,
+    EvaluationNetwork const& network,
+    NetworkAccumulator const& before,
+    NetworkAccumulator* after) -> void
+{
+    auto const offset = detail::enemy_feature_offset;
+    auto const from_square = static_cast<std::size_t>(coordinates_from_bit_board(from));
+    auto const to_square = static_cast<std::size_t>(coordinates_from_bit_board(to));
+    bool const is_capture = (*theirs & to) != u64{};
+
+    // For the opponent, the mover's pieces are the 'enemy' features
+    auto const captured_for_them = to_square;
+    detail::update_view(
+        network,
+        before.enemies_view,
+        after->friends_view,
+        offset + to_square,
+        offset + from_square,
+        is_capture ? &captured_for_them : nullptr);
+
+    auto const captured_for_us = offset + to_square;
+    detail::update_view(
+        network,
+        before.friends_view,
+        after->enemies_view,
+        to_square,
+        from_square,
+        is_capture ? &captured_for_us : nullptr);
+
+    apply_move_low_level(from, to, mine, theirs);
+}
+
+/**
+ * Evaluate the network from the accumulator, using SIMD where available
+ */
+inline auto evaluate_network(EvaluationNetwork const& network, NetworkAccumulator const& acc)
+    -> ScoreType
+{
+    constexpr auto n = EvaluationNetwork::accumulator_size;
+    constexpr auto max = EvaluationNetwork::activation_max;
+
+    std::int32_t hidden[EvaluationNetwork::hidden_size];
+
+#if defined(ROCK_NNUE_AVX2)
+    constexpr auto num_chunks = 2 * n / 16;
+    __m256i activations[num_chunks];
+    {
+        auto const zero = _mm256_setzero_si256();
+        auto const top = _mm256_set1_epi16(max);
+        for (auto k = std::size_t{}; k < num_chunks; ++k)
+        {
+            auto const* src = k < num_chunks / 2 ? acc.friends_view + 16 * k
+                                                 : acc.enemies_view + 16 * (k - num_chunks / 2);
+            auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src));
+            activations[k] = _mm256_min_epi16(_mm256_max_epi16(v, zero), top);
+        }
+    }
+
+    for (auto j = std::size_t{}; j < EvaluationNetwork::hidden_size; ++j)
+    {
+        auto sum = _mm256_setzero_si256();
+        for (auto k = std::size_t{}; k < num_chunks; ++k)
+        {
+            auto const w = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(network.hidden_weights[j] + 16 * k));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(w, activations[k]));
+        }
+        auto sum128 =
+            _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4e));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xb1));
+        auto const total = network.hidden_biases[j] + _mm_cvtsi128_si32(sum128);
+        hidden[j] = detail::clipped(total >> EvaluationNetwork::hidden_shift, max);
+    }
+#elif defined(ROCK_NNUE_SSE2)
+    constexpr auto num_chunks = 2 * n / 8;
+    __m128i activations[num_chunks];
+    {
+        auto const zero = _mm_setzero_si128();
+        auto const top = _mm_set1_epi16(max);
+        for (auto k = std::size_t{}; k < num_chunks; ++k)
+        {
+            auto const* src = k < num_chunks / 2 ? acc.friends_view + 8 * k
+                                                 : acc.enemies_view + 8 * (k - num_chunks / 2);
+            auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+            activations[k] = _mm_min_epi16(_mm_max_epi16(v, zero), top);
+        }
+    }
+
+    for (auto j = std::size_t{}; j < EvaluationNetwork::hidden_size; ++j)
+    {
+        auto sum = _mm_setzero_si128();
+        for (auto k = std::size_t{}; k < num_chunks; ++k)
+        {
+            auto const w = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(network.hidden_weights[j] + 8 * k));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(w, activations[k]));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+        auto const total = network.hidden_biases[j] + _mm_cvtsi128_si32(sum);
+        hidden[j] = detail::clipped(total >> EvaluationNetwork::hidden_shift, max);
+    }
+#else
+    for (auto j = std::size_t{}; j < EvaluationNetwork::hidden_size; ++j)
+    {
+        auto total = network.hidden_biases[j];
+        for (auto i = std::size_t{}; i < n; ++i)
+        {
+            total += network.hidden_weights[j][i] * detail::clipped(acc.friends_view[i], max);
+            total += network.hidden_weights[j][n + i] * detail::clipped(acc.enemies_view[i], max);
+        }
+        hidden[j] = detail::clipped(total >> EvaluationNetwork::hidden_shift, max);
+    }
+#endif
+
+    return detail::output_layer(network, hidden);
+}
+
+/**
+ * Straightforward scalar evaluation from scratch, as a reference for the optimized version
+ */
+inline auto evaluate_network_reference(EvaluationNetwork const& network, u64 friends, u64 enemies)
+    -> ScoreType
+{
+    constexpr auto n = EvaluationNetwork::accumulator_size;
+    constexpr auto max = EvaluationNetwork::activation_max;
+
+    std::int32_t activations[2 * n];
+    for (auto i = std::size_t{}; i < n; ++i)
+    {
+        std::int32_t own = network.input_biases[i];
+        std::int32_t other = network.input_biases[i];
+
+        for (auto sq = std::size_t{}; sq < 64; ++sq)
+        {
+            auto const f = (friends >> sq) & u64{1};
+            auto const e = (enemies >> sq) & u64{1};
+            auto const offset = detail::enemy_feature_offset;
+
+            own += f ? network.input_weights[sq][i] : 0;
+            own += e ? network.input_weights[offset + sq][i] : 0;
+            other += e ? network.input_weights[sq][i] : 0;
+            other += f ? network.input_weights[offset + sq][i] : 0;
+        }
+
+        // The accumulator is int16, so wrap in the same way
+        activations[i] = detail::clipped(static_cast<std::int16_t>(own), max);
+        activations[n + i] = detail::clipped(static_cast<std::int16_t>(other), max);
+    }
+
+    std::int32_t hidden[EvaluationNetwork::hidden_size];
+    for (auto j = std::size_t{}; j < EvaluationNetwork::hidden_size; ++j)
+    {
+        auto total = network.hidden_biases[j];
+        for (auto i = std::size_t{}; i < 2 * n; ++i)
+            total += network.hidden_weights[j][i] * activations[i];
+        hidden[j] = detail::clipped(total >> EvaluationNetwork::hidden_shift, max);
+    }
+
+    return detail::output_layer(network, hidden);
+}
+
+inline auto evaluate_leaf_position(
+    bool has_player_won,
+    bool has_player_lost,
+    EvaluationNetwork const& network,
+    NetworkAccumulator const& acc) -> ScoreType
+{
+    auto res = evaluate_network(network, acc);
+
+    if (has_player_lost || has_player_won)
+        res += big * static_cast<ScoreType>(has_player_won - has_player_lost);
+
+    return res;
+}
+
+}  // namespace rock::internal
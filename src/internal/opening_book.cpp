@@ -0,0 +1,203 @@
+#include "opening_book.h"
+#include "move_generation.h"
+#include "symmetry.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace rock::internal
+{
+
+namespace
+{
+    constexpr char file_magic[8] = {'R', 'O', 'C', 'K', 'B', 'K', '0', '1'};
+
+    // All in native byte order
+    struct FileHeader
+    {
+        char magic[8];
+        u64 num_records;
+    };
+
+    struct Record
+    {
+        u64 key;
+        u32 weight;
+
+        // The squares of the move, in the canonical orientation of the position
+        u8 from;
+        u8 to;
+
+        u16 unused;
+    };
+
+    static_assert(sizeof(Record) == 16);
+
+    auto mix(u64 x) -> u64
+    {
+        // The finalizer of splitmix64
+        x = (x ^ (x >> 30)) * u64{0xBF58476D1CE4E5B9};
+        x = (x ^ (x >> 27)) * u64{0x94D049BB133111EB};
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * The key of the position, which is already in its canonical orientation (see `book_key`)
+     */
+    auto key_of(CanonicalPosition const& canonical) -> u64
+    {
+        return mix(mix(canonical.friends) ^ canonical.enemies);
+    }
+
+    auto square_of(u64 board) -> u8
+    {
+        return static_cast<u8>(coordinates_from_bit_board(board));
+    }
+
+    auto read_record(u8 const* records, std::size_t index) -> Record
+    {
+        auto record = Record{};
+        std::memcpy(&record, records + index * sizeof(Record), sizeof(Record));
+        return record;
+    }
+}  // namespace
+
+auto book_key(u64 friends, u64 enemies) -> u64
+{
+    return key_of(canonicalize(friends, enemies));
+}
+
+auto OpeningBook::open(std::string const& path) -> std::unique_ptr<OpeningBook>
+{
+    auto file = MappedFile::open(path);
+    if (!file)
+        return nullptr;
+
+    auto book = std::unique_ptr<OpeningBook>{new OpeningBook{std::move(*file)}};
+    auto const* bytes = book->file_.data();
+    auto const size = book->file_.size();
+
+    auto header = FileHeader{};
+    if (size < sizeof(header))
+        return nullptr;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+        header.num_records != (size - sizeof(header)) / sizeof(Record))
+        return nullptr;
+
+    book->records_ = bytes + sizeof(header);
+    book->num_records_ = static_cast<std::size_t>(header.num_records);
+    return book;
+}
+
+auto OpeningBook::lookup(u64 friends, u64 enemies) const -> std::vector<BookEntry>
+{
+    auto const canonical = canonicalize(friends, enemies);
+    auto const key = key_of(canonical);
+
+    // The first record with the key
+    auto first = std::size_t{};
+    auto count = num_records_;
+    while (count > 0)
+    {
+        auto const step = count / 2;
+        if (read_record(records_, first + step).key < key)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+
+    auto entries = std::vector<BookEntry>{};
+    for (auto i = first; i < num_records_; ++i)
+    {
+        auto const record = read_record(records_, i);
+        if (record.key != key)
+            break;
+
+        auto const move = undo_symmetry(
+            InternalMove{u64{1} << record.from, u64{1} << record.to}, canonical.symmetry);
+
+        // Keys may collide, so only keep moves that make sense in this position
+        if (is_move_legal(move, friends, enemies))
+            entries.push_back(BookEntry{move, record.weight});
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) {
+        return a.weight > b.weight;
+    });
+    return entries;
+}
+
+auto OpeningBookBuilder::add_move(u64 friends, u64 enemies, InternalMove move, u32 weight) -> void
+{
+    auto const canonical = canonicalize(friends, enemies);
+    auto const canonical_move = apply_symmetry(move, canonical.symmetry);
+    auto const key = key_of(canonical);
+
+    moves_[{key, square_of(canonical_move.from_board), square_of(canonical_move.to_board)}] +=
+        weight;
+}
+
+auto OpeningBookBuilder::add_game(
+    Position const& start, std::vector<Move> const& moves, GameOutcome outcome, int max_plies)
+    -> void
+{
+    auto position = start;
+    for (auto i = std::size_t{}; i < moves.size() && static_cast<int>(i) < max_plies; ++i)
+    {
+        auto const player = position.player_to_move();
+        auto const has_won = (outcome == GameOutcome::WhiteWins && player == Player::White) ||
+            (outcome == GameOutcome::BlackWins && player == Player::Black);
+        auto const weight = has_won ? 2u : outcome == GameOutcome::Draw ? 1u : 0u;
+
+        // A move that only ever lost is still recorded, so that it is known to the book
+        add_move(position.friends(), position.enemies(), InternalMove::from(moves[i]), weight);
+        position = apply_move(moves[i], position);
+    }
+}
+
+auto OpeningBookBuilder::add_book(OpeningBook const& book) -> void
+{
+    for (auto i = std::size_t{}; i < book.num_records_; ++i)
+    {
+        auto const record = read_record(book.records_, i);
+        moves_[{record.key, record.from, record.to}] += record.weight;
+    }
+}
+
+auto OpeningBookBuilder::write(std::string const& path) const -> void
+{
+    auto file = std::ofstream(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("Could not open '{}' for writing", path));
+
+    auto header = FileHeader{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.num_records = moves_.size();
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+    // The map is already in the order of the file
+    for (auto const& [move, weight] : moves_)
+    {
+        auto const [key, from, to] = move;
+        auto const record = Record{
+            key,
+            static_cast<u32>(std::min<u64>(weight, std::numeric_limits<u32>::max())),
+            from,
+            to,
+            0,
+        };
+        file.write(reinterpret_cast<char const*>(&record), sizeof(record));
+    }
+
+    if (!file)
+        throw std::runtime_error(fmt::format("Could not write '{}'", path));
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "internal_types.h"
+#include "mapped_file.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace rock::internal
+{
+
+/**
+ * A key for a position that is the same for all of its symmetric versions, and the same from one
+ * run (or build) to the next, unlike `compute_hash`
+ */
+auto book_key(u64 friends, u64 enemies) -> u64;
+
+struct BookEntry
+{
+    InternalMove move;
+
+    // How strongly the move is recommended, relative to the other moves of the position
+    u32 weight;
+};
+
+/**
+ * An opening book, as written by `OpeningBookBuilder`, memory-mapped from a file
+ *
+ * The file holds a header followed by one record for each move, sorted by the key of the
+ * position, so the moves of a position are found by binary search. The positions are stored in
+ * their canonical orientation (see `canonicalize`), so each entry covers every symmetric version
+ * of its position.
+ */
+struct OpeningBook
+{
+    /**
+     * Returns null if the file cannot be read or is not a book file
+     */
+    static auto open(std::string const& path) -> std::unique_ptr<OpeningBook>;
+
+    /**
+     * The moves for the position, with the highest weight first, or none if it is not in the book
+     */
+    auto lookup(u64 friends, u64 enemies) const -> std::vector<BookEntry>;
+
+    auto num_moves() const -> std::size_t { return num_records_; }
+
+private:
+    friend struct OpeningBookBuilder;
+
+    explicit OpeningBook(MappedFile file) : file_{std::move(file)} {}
+
+    MappedFile file_;
+    u8 const* records_{};
+    std::size_t num_records_{};
+};
+
+/**
+ * Collects the moves of a book, adding up the weights given to the same move of the same position
+ * (or of a symmetric version of it)
+ */
+struct OpeningBookBuilder
+{
+    auto add_move(u64 friends, u64 enemies, InternalMove, u32 weight) -> void;
+
+    /**
+     * Count a finished game towards the book, for its first `max_plies` moves: each move gets a
+     * weight of 2 if its player went on to win, 1 for a draw, and none for a loss
+     */
+    auto add_game(Position const& start, std::vector<Move> const& moves, GameOutcome, int max_plies)
+        -> void;
+
+    /**
+     * Add every move of an existing book
+     */
+    auto add_book(OpeningBook const&) -> void;
+
+    auto num_moves() const -> std::size_t { return moves_.size(); }
+
+    /**
+     * Throws `std::runtime_error` if the file cannot be written
+     */
+    auto write(std::string const& path) const -> void;
+
+private:
+    // By key, then by the squares of the move in the canonical orientation
+    std::map<std::tuple<u64, u8, u8>, u64> moves_{};
+};
+
+}  // namespace rock::internal
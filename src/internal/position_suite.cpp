@@ -0,0 +1,242 @@
+#include "position_suite.h"
+#include "rock/fen.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+namespace rock::internal
+{
+
+namespace
+{
+    auto is_space(char ch) -> bool
+    {
+        return ch == ' ' || ch == '\t';
+    }
+
+    auto trim(std::string_view str) -> std::string_view
+    {
+        while (!str.empty() && is_space(str.front()))
+            str.remove_prefix(1);
+        while (!str.empty() && is_space(str.back()))
+            str.remove_suffix(1);
+        return str;
+    }
+
+    /**
+     * Removes the first word of the string, up to a space, and returns it without any quotes
+     */
+    auto take_word(std::string_view& str) -> std::string_view
+    {
+        str = trim(str);
+        auto word = std::string_view{};
+        if (!str.empty() && str.front() == '"')
+        {
+            auto const end = std::min(str.find('"', 1), str.size());
+            word = str.substr(1, end - 1);
+            str.remove_prefix(std::min(end + 1, str.size()));
+        }
+        else
+        {
+            auto end = std::size_t{};
+            while (end < str.size() && !is_space(str[end]))
+                ++end;
+            word = str.substr(0, end);
+            str.remove_prefix(end);
+        }
+        return word;
+    }
+
+    template <typename T>
+    auto parse_integer(std::string_view str) -> std::optional<T>
+    {
+        auto value = T{};
+        auto const* end = str.data() + str.size();
+        auto const [ptr, error] = std::from_chars(str.data(), end, value);
+        if (error != std::errc{} || ptr != end)
+            return std::nullopt;
+        return value;
+    }
+
+    auto parse_result(std::string_view str) -> std::optional<double>
+    {
+        if (str == "1-0")
+            return 1.0;
+        if (str == "0-1")
+            return 0.0;
+        if (str == "1/2-1/2")
+            return 0.5;
+
+        // strtod needs the number to be null-terminated
+        char buffer[32] = {};
+        if (str.empty() || str.size() >= sizeof(buffer))
+            return std::nullopt;
+        std::memcpy(buffer, str.data(), str.size());
+
+        char* end = nullptr;
+        auto const value = std::strtod(buffer, &end);
+        if (end != buffer + str.size() || !(value >= 0.0 && value <= 1.0))
+            return std::nullopt;
+        return value;
+    }
+
+    auto parse_square(std::string_view str) -> std::optional<BoardCoordinates>
+    {
+        auto const file = static_cast<char>(str[0] | 0x20);
+        if (file < 'a' || file > 'h' || str[1] < '1' || str[1] > '8')
+            return std::nullopt;
+        return BoardCoordinates{file - 'a', str[1] - '1'};
+    }
+
+    /**
+     * A move such as "b1-h1", or "b1h1"
+     */
+    auto parse_suite_move(std::string_view str) -> std::optional<Move>
+    {
+        if (str.size() != 4 && !(str.size() == 5 && str[2] == '-'))
+            return std::nullopt;
+
+        auto const from = parse_square(str.substr(0, 2));
+        auto const to = parse_square(str.substr(str.size() - 2));
+        if (!from || !to)
+            return std::nullopt;
+        return Move{*from, *to};
+    }
+
+    /**
+     * Adds the annotation to the position, returning false if it cannot be parsed
+     */
+    auto parse_operation(std::string_view operation, SuitePosition& position) -> bool
+    {
+        auto const opcode = take_word(operation);
+        auto const operand = take_word(operation);
+
+        if (opcode == "bm")
+        {
+            position.best_move = parse_suite_move(operand);
+            return position.best_move.has_value();
+        }
+        if (opcode == "ce")
+        {
+            position.score = parse_integer<ScoreType>(operand);
+            return position.score.has_value();
+        }
+        if (opcode == "c9")
+        {
+            position.result = parse_result(operand);
+            return position.result.has_value();
+        }
+
+        auto const depth = opcode.size() >= 2 && opcode[0] == 'D'
+            ? parse_integer<int>(opcode.substr(1))
+            : std::nullopt;
+        if (!depth)
+            return true;  // Other opcodes are ignored
+
+        auto const num_positions = parse_integer<u64>(operand);
+        if (!num_positions || *depth < 1 ||
+            position.perft_counts.size() == position.perft_counts.capacity())
+            return false;
+        position.perft_counts.push_back(PerftCount{*depth, *num_positions});
+        return true;
+    }
+}  // namespace
+
+auto parse_suite_line(std::string_view line) -> std::optional<SuitePosition>
+{
+    // The board and the player to move
+    auto rest = line;
+    take_word(rest);
+    take_word(rest);
+    auto const position = parse_fen_to_position(line.substr(0, line.size() - rest.size()));
+    if (!position)
+        return std::nullopt;
+
+    auto suite_position = SuitePosition{*position};
+
+    rest = trim(rest);
+    if (!rest.empty() && rest.front() >= '0' && rest.front() <= '9')
+    {
+        suite_position.result = parse_result(take_word(rest));
+        if (!suite_position.result)
+            return std::nullopt;
+    }
+
+    // Operations end with a semicolon, except maybe the last, and may have quoted operands that
+    // hold semicolons
+    while (!(rest = trim(rest)).empty())
+    {
+        auto end = std::size_t{};
+        auto is_quoted = false;
+        while (end < rest.size() && (is_quoted || rest[end] != ';'))
+            is_quoted ^= rest[end++] == '"';
+
+        if (!parse_operation(rest.substr(0, end), suite_position))
+            return std::nullopt;
+        rest.remove_prefix(std::min(end + 1, rest.size()));
+    }
+
+    return suite_position;
+}
+
+auto PositionSuiteReader::open(std::string const& path) -> std::optional<PositionSuiteReader>
+{
+    auto file = MappedFile::open(path);
+    if (!file)
+        return std::nullopt;
+
+    auto reader = PositionSuiteReader{std::string_view{}};
+    reader.file_ = std::move(*file);
+    reader.text_ = std::string_view{
+        reinterpret_cast<char const*>(reader.file_->data()), reader.file_->size()};
+    return reader;
+}
+
+auto PositionSuiteReader::next() -> std::optional<SuitePosition>
+{
+    while (offset_ < text_.size())
+    {
+        auto const* begin = text_.data() + offset_;
+        auto const* newline =
+            static_cast<char const*>(std::memchr(begin, '\n', text_.size() - offset_));
+        auto const size = newline ? static_cast<std::size_t>(newline - begin)
+                                  : text_.size() - offset_;
+        offset_ += size + 1;
+        ++line_number_;
+
+        auto line = std::string_view{begin, size};
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        line = trim(line);
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        if (auto position = parse_suite_line(line))
+            return position;
+        invalid_lines_.push_back(line_number_);
+    }
+    return std::nullopt;
+}
+
+auto read_position_suite(std::string const& path) -> std::optional<PositionSuite>
+{
+    auto const file = MappedFile::open(path);
+    if (!file)
+        return std::nullopt;
+    auto const text =
+        std::string_view{reinterpret_cast<char const*>(file->data()), file->size()};
+
+    // Most lines are positions, and counting them first saves growing the list
+    auto suite = PositionSuite{};
+    auto const num_lines = std::count(text.begin(), text.end(), '\n') + 1;
+    suite.positions.reserve(static_cast<std::size_t>(num_lines));
+
+    auto reader = PositionSuiteReader{text};
+    while (auto position = reader.next())
+        suite.positions.push_back(*position);
+    suite.invalid_lines = reader.invalid_lines();
+    return suite;
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "rock/types.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rock::internal
+{
+
+struct PerftCount
+{
+    int depth;
+    u64 num_positions;
+};
+
+/**
+ * A position of a suite, with the annotations that came with it
+ */
+struct SuitePosition
+{
+    Position position;
+
+    // "bm", the first if there are several
+    std::optional<Move> best_move{};
+
+    // "ce", from the point of view of the player to move
+    std::optional<ScoreType> score{};
+
+    // "c9", or a result right after the player to move, from white's point of view: 1 for a win,
+    // 0 for a loss
+    std::optional<double> result{};
+
+    // "D<depth>", the number of positions at the depth, as counted by `count_moves`
+    FixedCapacityList<PerftCount, 8> perft_counts{};
+};
+
+/**
+ * Parses a line of a suite, in a form modeled on EPD:
+ *
+ *     <fen> <w|b> [<result>] [<opcode> [<operand>...]; ...]
+ *
+ * where the result is one of "1-0", "0-1", "1/2-1/2", or a number between 0 and 1, as in the
+ * corpora of rock_tune, and the opcodes are those of `SuitePosition`. Other opcodes, such as
+ * "id", are ignored, and operands may be quoted. Moves are written as by `to_string(Move)`.
+ *
+ * Returns nothing if the line is not a position or an annotation cannot be parsed.
+ */
+auto parse_suite_line(std::string_view line) -> std::optional<SuitePosition>;
+
+/**
+ * Reads the positions of a suite one line at a time, from a memory-mapped file or from text
+ *
+ * Empty lines and lines starting with '#' are skipped, and so are lines that cannot be parsed,
+ * whose numbers are kept.
+ */
+struct PositionSuiteReader
+{
+    /**
+     * Returns nothing if the file cannot be read or is empty
+     */
+    static auto open(std::string const& path) -> std::optional<PositionSuiteReader>;
+
+    /**
+     * The text must outlive the reader
+     */
+    explicit PositionSuiteReader(std::string_view text) : text_{text} {}
+
+    /**
+     * The next position, or nothing once there are no more
+     */
+    auto next() -> std::optional<SuitePosition>;
+
+    /**
+     * The number, from 1, of the line of the last position read
+     */
+    auto line_number() const -> std::size_t { return line_number_; }
+
+    /**
+     * The numbers of the lines read so far that could not be parsed
+     */
+    auto invalid_lines() const -> std::vector<std::size_t> const& { return invalid_lines_; }
+
+private:
+    std::optional<MappedFile> file_{};
+    std::string_view text_;
+    std::size_t offset_{};
+    std::size_t line_number_{};
+    std::vector<std::size_t> invalid_lines_{};
+};
+
+struct PositionSuite
+{
+    std::vector<SuitePosition> positions;
+    std::vector<std::size_t> invalid_lines;
+};
+
+/**
+ * All the positions of a suite file, or nothing if the file cannot be read or is empty
+ */
+auto read_position_suite(std::string const& path) -> std::optional<PositionSuite>;
+
+}  // namespace rock::internal
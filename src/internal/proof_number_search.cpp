@@ -0,0 +1,292 @@
+#include "proof_number_search.h"
+#include "evaluate.h"
+#include "move_generation.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace rock::internal
+{
+
+namespace
+{
+    using ProofNumber = u32;
+    constexpr auto infinity = std::numeric_limits<ProofNumber>::max();
+
+    auto add_saturated(ProofNumber a, ProofNumber b) -> ProofNumber
+    {
+        return b >= infinity - a ? infinity : a + b;
+    }
+
+    /**
+     * A proof tree for the goal of the attacker winning, where the attacker is either the player
+     * to move at the root or their opponent. The attacker chooses the move at OR nodes, and the
+     * defender at AND nodes, so a draw counts as a loss for the attacker.
+     *
+     * Each iteration expands the most-proving node, found by following the child with the smallest
+     * proof number from OR nodes and the smallest disproof number from AND nodes. The numbers are
+     * then updated on the way back up, only as far as they change, and the next most-proving node
+     * is looked for from there.
+     */
+    struct ProofTree
+    {
+        struct Node
+        {
+            // The move to the node from its parent
+            InternalMove move;
+
+            ProofNumber proof;
+            ProofNumber disproof;
+
+            // The children are stored together, and there are none until the node is expanded
+            u32 first_child;
+            u32 num_children;
+        };
+
+        ProofTree(
+            BitBoard friends,
+            BitBoard enemies,
+            bool is_attacker_to_move,
+            std::size_t max_nodes,
+            SearchControl* control)
+            : max_nodes_{std::min<std::size_t>(max_nodes, std::numeric_limits<u32>::max())},
+              control_{control}
+        {
+            nodes_.push_back(Node{InternalMove{}, 1, 1, 0, 0});
+            path_.push_back(PathEntry{0, friends, enemies, is_attacker_to_move});
+        }
+
+        /**
+         * Whether the goal is proven or disproven, or nothing if the tree ran out of room or the
+         * search was stopped first. The root must not be a finished game.
+         */
+        auto solve() -> std::optional<bool>
+        {
+            while (true)
+            {
+                if (nodes_[0].proof == 0)
+                    return true;
+                if (nodes_[0].disproof == 0)
+                    return false;
+                if (control_ && control_->is_stopped())
+                    return std::nullopt;
+
+                select_most_proving_node();
+                if (!expand())
+                    return std::nullopt;
+                update_numbers();
+            }
+        }
+
+        /**
+         * The first move from the root whose node satisfies `f`
+         */
+        template <typename F>
+        auto find_root_move(F&& f) const -> InternalMove
+        {
+            auto const& root = nodes_[0];
+            for (auto i = root.first_child; i < root.first_child + root.num_children; ++i)
+            {
+                if (f(nodes_[i]))
+                    return nodes_[i].move;
+            }
+            return InternalMove{};
+        }
+
+        auto num_nodes() const -> u64 { return nodes_.size(); }
+
+    private:
+        struct PathEntry
+        {
+            u32 index;
+            BitBoard friends;
+            BitBoard enemies;
+            bool is_or;
+        };
+
+        auto select_most_proving_node() -> void
+        {
+            while (nodes_[path_.back().index].num_children != 0)
+            {
+                auto const entry = path_.back();
+                auto const& node = nodes_[entry.index];
+
+                auto best = node.first_child;
+                for (auto i = best + 1; i < node.first_child + node.num_children; ++i)
+                {
+                    if (entry.is_or ? nodes_[i].proof < nodes_[best].proof
+                                    : nodes_[i].disproof < nodes_[best].disproof)
+                        best = i;
+                }
+
+                auto friends = entry.friends;
+                auto enemies = entry.enemies;
+                auto const move = nodes_[best].move;
+                apply_move_low_level(move.from_board, move.to_board, &friends, &enemies);
+                path_.push_back(PathEntry{best, enemies, friends, !entry.is_or});
+            }
+        }
+
+        /**
+         * Add the children of the most-proving node, unless there is no room for them
+         */
+        auto expand() -> bool
+        {
+            auto const entry = path_.back();
+            auto moves = generate_moves(entry.friends, entry.enemies);
+
+            auto num_moves = std::size_t{};
+            for (auto const& move_set : moves)
+                num_moves += pop_count(move_set.to_board);
+            if (nodes_.size() + num_moves > max_nodes_)
+                return false;
+
+            auto const first_child = static_cast<u32>(nodes_.size());
+            for_each_move(moves, [&](u64 from_board, u64 to_board) {
+                auto friends = entry.friends;
+                auto enemies = entry.enemies;
+                apply_move_low_level(from_board, to_board, &friends, &enemies);
+                nodes_.push_back(
+                    make_leaf(InternalMove{from_board, to_board}, enemies, friends, !entry.is_or));
+
+                if (control_)
+                    control_->count_node();
+            });
+
+            auto& node = nodes_[entry.index];
+            node.first_child = first_child;
+            node.num_children = static_cast<u32>(num_moves);
+            return true;
+        }
+
+        /**
+         * A new node, which is already proven or disproven if the game is over. Otherwise, its
+         * numbers start out as its number of moves for the player who has to find all of them
+         * good, which leads the search towards positions where the defender has few moves.
+         */
+        static auto make_leaf(InternalMove move, BitBoard friends, BitBoard enemies, bool is_or)
+            -> Node
+        {
+            auto const proven = Node{move, 0, infinity, 0, 0};
+            auto const disproven = Node{move, infinity, 0, 0, 0};
+
+            bool const has_player_won = are_pieces_all_together(friends);
+            bool const has_player_lost = are_pieces_all_together(enemies);
+            if (has_player_won && has_player_lost)
+                return disproven;
+            if (has_player_won)
+                return is_or ? proven : disproven;
+            if (has_player_lost)
+                return is_or ? disproven : proven;
+
+            auto const num_moves = static_cast<ProofNumber>(count_moves(friends, enemies, 1));
+            if (num_moves == 0)
+                return disproven;
+
+            return is_or ? Node{move, 1, num_moves, 0, 0} : Node{move, num_moves, 1, 0, 0};
+        }
+
+        auto update_numbers() -> void
+        {
+            while (true)
+            {
+                auto const entry = path_.back();
+                auto& node = nodes_[entry.index];
+
+                auto min_proof = infinity;
+                auto min_disproof = infinity;
+                auto sum_proof = ProofNumber{};
+                auto sum_disproof = ProofNumber{};
+                for (auto i = node.first_child; i < node.first_child + node.num_children; ++i)
+                {
+                    min_proof = std::min(min_proof, nodes_[i].proof);
+                    min_disproof = std::min(min_disproof, nodes_[i].disproof);
+                    sum_proof = add_saturated(sum_proof, nodes_[i].proof);
+                    sum_disproof = add_saturated(sum_disproof, nodes_[i].disproof);
+                }
+
+                auto const proof = entry.is_or ? min_proof : sum_proof;
+                auto const disproof = entry.is_or ? sum_disproof : min_disproof;
+
+                // The ancestors only change if this node does
+                if ((proof == node.proof && disproof == node.disproof) || path_.size() == 1)
+                {
+                    node.proof = proof;
+                    node.disproof = disproof;
+                    return;
+                }
+
+                node.proof = proof;
+                node.disproof = disproof;
+                path_.pop_back();
+            }
+        }
+
+        std::size_t max_nodes_;
+        SearchControl* control_;
+
+        std::vector<Node> nodes_{};
+
+        // From the root to the node being worked on
+        std::vector<PathEntry> path_{};
+    };
+}  // namespace
+
+auto solve_with_proof_numbers(
+    BitBoard friends, BitBoard enemies, std::size_t max_nodes, SearchControl* control)
+    -> ProofNumberSolution
+{
+    auto solution = ProofNumberSolution{};
+
+    bool const has_player_won = are_pieces_all_together(friends);
+    bool const has_player_lost = are_pieces_all_together(enemies);
+    if (has_player_won || has_player_lost)
+    {
+        solution.result = has_player_won && has_player_lost ? GameResult::Draw
+            : has_player_won                                ? GameResult::Win
+                                                            : GameResult::Loss;
+        return solution;
+    }
+    if (count_moves(friends, enemies, 1) == 0)
+    {
+        solution.result = GameResult::Draw;
+        return solution;
+    }
+
+    {
+        auto win_tree = ProofTree(friends, enemies, true, max_nodes, control);
+        auto const is_win = win_tree.solve();
+        solution.nodes += win_tree.num_nodes();
+
+        if (!is_win)
+            return solution;
+        if (*is_win)
+        {
+            solution.result = GameResult::Win;
+            solution.move = win_tree.find_root_move([](auto const& n) { return n.proof == 0; });
+            return solution;
+        }
+    }
+
+    auto loss_tree = ProofTree(friends, enemies, false, max_nodes, control);
+    auto const is_loss = loss_tree.solve();
+    solution.nodes += loss_tree.num_nodes();
+
+    if (!is_loss)
+        return solution;
+    if (*is_loss)
+    {
+        // Every move loses
+        solution.result = GameResult::Loss;
+        solution.move = loss_tree.find_root_move([](auto const&) { return true; });
+    }
+    else
+    {
+        solution.result = GameResult::Draw;
+        solution.move = loss_tree.find_root_move([](auto const& n) { return n.disproof == 0; });
+    }
+    return solution;
+}
+
+}  // namespace rock::internal
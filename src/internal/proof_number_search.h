@@ -0,0 +1,35 @@
+#pragma once
+
+#include "internal_types.h"
+#include "search.h"
+#include <cstddef>
+
+namespace rock::internal
+{
+
+struct ProofNumberSolution
+{
+    GameResult result{};
+
+    // A move that achieves the result, if the position is solved and is not already over
+    InternalMove move{};
+
+    // The number of positions added to the proof trees
+    u64 nodes{};
+};
+
+/**
+ * Solve a position with proof-number search, under the same rules as the alpha-beta search: a
+ * player wins by connecting their pieces, and it is a draw if both players are connected at once
+ * or the player to move has no moves.
+ *
+ * Proof-number search only proves or disproves one goal at a time, so it first tries to prove a
+ * win for the player to move, and failing that, a win for the opponent. If neither wins, the
+ * position is a draw. Each proof tree may hold at most `max_nodes` positions; if that is not
+ * enough, or the control stops the search, the result is `Unknown`.
+ */
+auto solve_with_proof_numbers(
+    BitBoard friends, BitBoard enemies, std::size_t max_nodes, SearchControl* = nullptr)
+    -> ProofNumberSolution;
+
+}  // namespace rock::internal
@@ -2,36 +2,244 @@
 
 #include "evaluate.h"
 #include "internal_types.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "thread_pool.h"
+#include "time_manager.h"
 #include "transposition_table.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace rock::internal
 {
 
-struct Searcher
+/**
+ * A node whose remaining moves are being searched by several threads at once. A cutoff at the
+ * node cancels the searches of its other moves, and so of any split points below them.
+ */
+struct SplitPoint
 {
-    explicit Searcher(int depth, TranspositionTable* table, bool const* stop_token = nullptr)
-        : depth_{depth}, table_{table}, stop_token_{stop_token}
+    SplitPoint const* parent{};
+    std::atomic<bool> is_cut{};
+
+    auto is_cancelled() const -> bool
+    {
+        for (auto const* split_point = this; split_point; split_point = split_point->parent)
+        {
+            if (split_point->is_cut.load(std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * State shared by all the nodes of a search: how many nodes it has searched, and whether it has
+ * been stopped, either through the stop token or by reaching the deadline or node limit
+ *
+ * The stop conditions are only polled every `poll_interval` nodes, so that checking them costs
+ * next to nothing per node. A poll is always made on reaching the node limit, so that the limit
+ * is exact. Once stopped, the results of the search are incomplete.
+ *
+ * The threads helping with a search count their nodes separately, and share the node limit
+ * through a count of all the nodes of the search that each adds to as it polls. The limit is then
+ * only overshot by the nodes the threads search between polls.
+ */
+struct SearchControl
+{
+    static constexpr u64 poll_interval = 1024;
+    static constexpr auto no_deadline = std::numeric_limits<SearchClock::rep>::max();
+
+    std::atomic<bool> const* stop_token{};
+    std::optional<SearchClock::time_point> deadline{};
+    std::optional<u64> node_limit{};
+
+    // A deadline that can be set from another thread while the search runs, as a number of ticks
+    // of the search clock (or `no_deadline`)
+    std::atomic<SearchClock::rep> const* deadline_token{};
+
+    // If set, the moves of deep enough nodes are shared out between the threads of the pool
+    // (see `BasicSearcher::search_moves_in_parallel`), and the table must be a shared one
+    ThreadPool* pool{};
+
+    // Set for the searches of the moves of a split point
+    SplitPoint const* split_point{};
+
+    // If set, positions in the tablebase are given their exact scores instead of being searched
+    Tablebase const* tablebase{};
+
+    u64 nodes{};
+    u64 next_poll{poll_interval};
+    bool stopped{};
+
+    // Once the search has split, the nodes of all its threads, and how many of this thread's
+    // nodes have been added to them
+    std::shared_ptr<std::atomic<u64>> shared_nodes{};
+    u64 shared_nodes_added{};
+
+    /**
+     * Whether the results of the search are incomplete, either because it was stopped or because
+     * the split point it is helping with has been cut off
+     */
+    auto is_stopped() const -> bool
+    {
+        return stopped || (split_point && split_point->is_cancelled());
+    }
+
+    auto count_node() -> void
+    {
+        if (++nodes >= next_poll)
+            poll();
+    }
+
+    auto poll() -> void
+    {
+        // The nodes counted against the limit
+        auto total_nodes = nodes;
+        if (shared_nodes)
+        {
+            auto const added = nodes - shared_nodes_added;
+            total_nodes = shared_nodes->fetch_add(added, std::memory_order_relaxed) + added;
+            shared_nodes_added = nodes;
+        }
+
+        next_poll = nodes + poll_interval;
+        if (node_limit)
+        {
+            auto const remaining = *node_limit - std::min(total_nodes, *node_limit);
+            next_poll = std::min(next_poll, nodes + std::max(u64{1}, remaining));
+        }
+
+        if (stop_token && stop_token->load(std::memory_order_relaxed))
+            stopped = true;
+        if (deadline && SearchClock::now() >= *deadline)
+            stopped = true;
+        if (deadline_token &&
+            SearchClock::now().time_since_epoch().count() >=
+                deadline_token->load(std::memory_order_relaxed))
+            stopped = true;
+        if (node_limit && total_nodes >= *node_limit)
+            stopped = true;
+    }
+
+    /**
+     * Apply the limits to the rest of the search
+     */
+    auto set_limits(TimeManager const& time_manager, SearchLimits const& limits) -> void
+    {
+        deadline = time_manager.hard_deadline();
+        node_limit = limits.nodes;
+        poll();
+    }
+
+    /**
+     * The control for a thread helping with the search, or with its share of the moves of a split
+     * point, with the same limits, which it shares with this one and the other helpers. The nodes
+     * of a split point's helpers are added to this one's by `join_helper` when it is done.
+     */
+    auto make_helper(SplitPoint const* split = nullptr) -> SearchControl
+    {
+        if (!shared_nodes)
+        {
+            shared_nodes = std::make_shared<std::atomic<u64>>(nodes);
+            shared_nodes_added = nodes;
+        }
+
+        auto helper = *this;
+        helper.split_point = split;
+        helper.nodes = 0;
+        helper.shared_nodes_added = 0;
+        helper.poll();
+        return helper;
+    }
+
+    auto join_helper(SearchControl const& helper) -> void
+    {
+        // The helper's nodes since its last poll are added to the shared count on this one's next
+        nodes += helper.nodes;
+        shared_nodes_added += helper.shared_nodes_added;
+        if (helper.stopped)
+            stopped = true;
+    }
+};
+
+/**
+ * The score of a tablebase entry, preferring faster wins and slower losses
+ */
+inline auto tablebase_score(TablebaseEntry const& entry) -> ScoreType
+{
+    switch (entry.result)
+    {
+    case GameResult::Win:
+        return big - entry.distance;
+    case GameResult::Loss:
+        return -big + entry.distance;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Alpha-beta (negascout) searcher. The `Weights` parameter selects where the evaluation weights
+ * come from (see `CompiledEvaluationWeights` and `RuntimeEvaluationWeights`). If a network is
+ * supplied, it replaces the heuristic evaluation.
+ */
+template <typename Weights>
+struct BasicSearcher
+{
+    explicit BasicSearcher(
+        int depth,
+        TranspositionTable* table,
+        SearchControl* control = nullptr,
+        EvaluationNetwork const* network = nullptr)
+        : depth_{depth}, table_{table}, control_{control}, network_{network}
     {}
 
+    /**
+     * Search from the root of the tree, setting up the network accumulator if needed
+     */
+    auto search_root(
+        BitBoard friends, BitBoard enemies, ScoreType alpha = -big, ScoreType beta = big)
+        -> InternalMoveRecommendation;
+
+    /**
+     * The accumulator must be supplied if the searcher has a network
+     */
     auto search(
         BitBoard friends,
         BitBoard enemies,
         ScoreType alpha = -big,
         ScoreType beta = big,
-        InternalMove killer_move = {}) -> InternalMoveRecommendation;
+        InternalMove killer_move = {},
+        NetworkAccumulator const* accumulator = nullptr) -> InternalMoveRecommendation;
 
 private:
+    // Nodes with less depth than this left are not worth splitting
+    static constexpr auto min_split_depth = 3;
+
     // Internal functions
-    auto search_next(BitBoard friends, BitBoard enemies, ScoreType alpha, ScoreType beta)
-        -> InternalMoveRecommendation;
+    auto search_next(
+        BitBoard friends,
+        BitBoard enemies,
+        ScoreType alpha,
+        ScoreType beta,
+        NetworkAccumulator const* accumulator) -> InternalMoveRecommendation;
     auto main_search() -> void;
+    auto search_moves_in_parallel(InternalMoveList&, InternalMove tt_move) -> void;
     auto process_move(InternalMove) -> void;
     auto add_to_transposition_table() -> void;
+    auto evaluate(bool has_player_won, bool has_player_lost) const -> ScoreType;
 
     // Input arguments
     int depth_;
     TranspositionTable* table_;
-    bool const* stop_token_;
+    SearchControl* control_;
+    EvaluationNetwork const* network_;
 
     // Search arguments
     BitBoard friends_;
@@ -39,6 +247,7 @@ private:
     ScoreType alpha_;
     ScoreType beta_;
     InternalMove killer_move_;
+    NetworkAccumulator const* accumulator_;
 
     // Internal data
     InternalMove next_killer_move_{};
@@ -51,44 +260,108 @@ private:
 #endif
 };
 
-inline auto
-Searcher::search_next(BitBoard friends, BitBoard enemies, ScoreType alpha, ScoreType beta)
-    -> InternalMoveRecommendation
+using Searcher = BasicSearcher<ActiveEvaluationWeights>;
+
+template <typename Weights>
+inline auto BasicSearcher<Weights>::search_next(
+    BitBoard friends,
+    BitBoard enemies,
+    ScoreType alpha,
+    ScoreType beta,
+    NetworkAccumulator const* accumulator) -> InternalMoveRecommendation
 {
-    // Don't incur the cost of checking the token on small depths
-    auto const stop_token = depth_ < 5 ? nullptr : stop_token_;
+    // Only below the root, which must return a move
+    if (control_ && control_->tablebase)
+    {
+        if (auto const entry = control_->tablebase->probe(friends, enemies))
+        {
+            control_->count_node();
+            return {InternalMove{}, tablebase_score(*entry)};
+        }
+    }
 
-    auto searcher = Searcher(depth_ - 1, table_, stop_token);
-    return searcher.search(friends, enemies, alpha, beta, next_killer_move_);
+    auto searcher = BasicSearcher(depth_ - 1, table_, control_, network_);
+    return searcher.search(friends, enemies, alpha, beta, next_killer_move_, accumulator);
 }
 
-inline auto Searcher::search(
-    BitBoard friends, BitBoard enemies, ScoreType alpha, ScoreType beta, InternalMove killer_move)
+template <typename Weights>
+inline auto BasicSearcher<Weights>::search_root(
+    BitBoard friends, BitBoard enemies, ScoreType alpha, ScoreType beta)
     -> InternalMoveRecommendation
 {
+    if (!network_)
+        return search(friends, enemies, alpha, beta);
+
+    auto const accumulator = refresh_accumulator(*network_, friends, enemies);
+    return search(friends, enemies, alpha, beta, {}, &accumulator);
+}
+
+template <typename Weights>
+inline auto BasicSearcher<Weights>::search(
+    BitBoard friends,
+    BitBoard enemies,
+    ScoreType alpha,
+    ScoreType beta,
+    InternalMove killer_move,
+    NetworkAccumulator const* accumulator) -> InternalMoveRecommendation
+{
+    assert(!network_ || accumulator);
+
     friends_ = friends;
     enemies_ = enemies;
     alpha_ = alpha;
     beta_ = beta;
     killer_move_ = killer_move;
+    accumulator_ = accumulator;
+
+    if (control_)
+        control_->count_node();
 
     if (depth_ == 0)
-        return {InternalMove{}, evaluate_leaf_position(friends_, enemies_)};
+    {
+        bool const has_player_won = are_pieces_all_together(friends_);
+        bool const has_player_lost = are_pieces_all_together(enemies_);
+        return {InternalMove{}, evaluate(has_player_won, has_player_lost)};
+    }
 
     main_search();
     DIAGNOSTICS_UPDATE_AFTER_SEARCH(best_result_, move_count_);
-    add_to_transposition_table();
+
+    // An incomplete result must not be mistaken for a complete one by later searches
+    if (!control_ || !control_->is_stopped())
+        add_to_transposition_table();
+
     return best_result_;
 }
 
-inline auto Searcher::process_move(InternalMove move) -> void
+template <typename Weights>
+inline auto BasicSearcher<Weights>::process_move(InternalMove move) -> void
 {
-    if (stop_token_ && move_count_ > 0 && *stop_token_)
+    // The first move is always searched, so that there is a move to return
+    if (move_count_ > 0 && control_ && control_->is_stopped())
         return;
 
     auto friends_copy = friends_;
     auto enemies_copy = enemies_;
-    apply_move_low_level(move.from_board, move.to_board, &friends_copy, &enemies_copy);
+    NetworkAccumulator accumulator_storage;
+    NetworkAccumulator const* accumulator = nullptr;
+
+    if (network_)
+    {
+        apply_move_low_level(
+            move.from_board,
+            move.to_board,
+            &friends_copy,
+            &enemies_copy,
+            *network_,
+            *accumulator_,
+            &accumulator_storage);
+        accumulator = &accumulator_storage;
+    }
+    else
+    {
+        apply_move_low_level(move.from_board, move.to_board, &friends_copy, &enemies_copy);
+    }
 
     InternalMoveRecommendation recommendation;
     ScoreType score;
@@ -96,14 +369,16 @@ inline auto Searcher::process_move(InternalMove move) -> void
 #ifndef NO_USE_NEGASCOUT
     if (move_count_ > 0)
     {
-        recommendation = search_next(enemies_copy, friends_copy, -alpha_ - 1, -alpha_);
+        recommendation =
+            search_next(enemies_copy, friends_copy, -alpha_ - 1, -alpha_, accumulator);
         score = -recommendation.score;
 
         bool const must_re_search = score > alpha_ && score < beta_;
 
         if (must_re_search)
         {
-            recommendation = search_next(enemies_copy, friends_copy, -beta_, -alpha_);
+            recommendation =
+                search_next(enemies_copy, friends_copy, -beta_, -alpha_, accumulator);
             score = -recommendation.score;
         }
 
@@ -112,7 +387,7 @@ inline auto Searcher::process_move(InternalMove move) -> void
     else
 #endif
     {
-        recommendation = search_next(enemies_copy, friends_copy, -beta_, -alpha_);
+        recommendation = search_next(enemies_copy, friends_copy, -beta_, -alpha_, accumulator);
         score = -recommendation.score;
     }
 
@@ -142,29 +417,31 @@ inline auto Searcher::process_move(InternalMove move) -> void
     ++move_count_;
 }
 
-inline auto Searcher::main_search() -> void
+template <typename Weights>
+inline auto BasicSearcher<Weights>::main_search() -> void
 {
     DIAGNOSTICS_UPDATE_BEFORE_SEARCH();
 
-    best_result_ = InternalMoveRecommendation{InternalMove{}, -big};
+    // Below the score of any loss, which can be less than -big, so that there is always a best move
+    best_result_ = InternalMoveRecommendation{InternalMove{}, -2 * big};
     node_type_ = NodeType::All;
 
     // Check the transposition table before checking if the game is over
     // (this works out faster)
-    auto const [tt_ptr, was_found] = table_->lookup(friends_, enemies_);
+    auto const tt_entry = table_->load(friends_, enemies_);
     auto tt_move = InternalMove{};
-    DIAGNOSTICS_UPDATE(tt_had_move_cached, was_found);
-    if (was_found)
+    DIAGNOSTICS_UPDATE(tt_had_move_cached, tt_entry.has_value());
+    if (tt_entry)
     {
-        tt_move = tt_ptr->recommendation.move;
+        tt_move = tt_entry->recommendation.move;
 
         bool const tt_is_exact_match = tt_move.empty() ||
-            (tt_ptr->type == NodeType::Pv && tt_ptr->depth >= depth_);
+            (tt_entry->type == NodeType::Pv && tt_entry->depth >= depth_);
 
         DIAGNOSTICS_UPDATE(tt_move_is_exact_match, tt_is_exact_match);
         if (tt_is_exact_match)
         {
-            best_result_ = tt_ptr->recommendation;
+            best_result_ = tt_entry->recommendation;
             return;
         }
 
@@ -191,12 +468,17 @@ inline auto Searcher::main_search() -> void
         if (moves.size() == 0 || has_player_won || has_player_lost)
         {
             best_result_.move = InternalMove{};
-            best_result_.score =
-                evaluate_leaf_position(friends_, enemies_, has_player_won, has_player_lost);
+            best_result_.score = evaluate(has_player_won, has_player_lost);
             return;
         }
     }
 
+    if (control_ && control_->pool && depth_ >= min_split_depth)
+    {
+        this->search_moves_in_parallel(moves, tt_move);
+        return;
+    }
+
     for (auto move_set : moves)
     {
         while (move_set.to_board)
@@ -221,21 +503,139 @@ inline auto Searcher::main_search() -> void
     // version of alpha-beta pruning.
 }
 
-inline auto Searcher::add_to_transposition_table() -> void
+/**
+ * Young Brothers Wait: search the first move on this thread, and only if it does not cause a
+ * cutoff, share the remaining moves out between the threads of the pool, this one included
+ *
+ * Each thread takes the next move in turn and searches it with the best bound found so far, as
+ * a copy of this searcher with a control of its own. The first cutoff cancels the searches of the
+ * other moves. A search that was stopped or cancelled leaves its result out.
+ */
+template <typename Weights>
+inline auto BasicSearcher<Weights>::search_moves_in_parallel(
+    InternalMoveList& moves, InternalMove tt_move) -> void
 {
-    auto const [tt_ptr, was_found] = table_->lookup(friends_, enemies_);
-
-    bool const are_we_pv = node_type_ == NodeType::Pv;
-    bool const are_tt_pv = tt_ptr->type == NodeType::Pv;
+    auto remaining_moves = FixedCapacityList<InternalMove, MoveList::capacity()>{};
+    for_each_move(moves, [&](u64 from_board, u64 to_board) {
+        auto const move = InternalMove{from_board, to_board};
+        if (move != killer_move_ && move != tt_move)
+            remaining_moves.push_back(move);
+    });
+
+    auto next_move = std::size_t{};
+    if (move_count_ == 0 && !remaining_moves.empty())
+    {
+        this->process_move(remaining_moves[next_move++]);
+        if (node_type_ == NodeType::Cut)
+            return;
+    }
 
-    if ((!are_we_pv && !are_tt_pv && depth_ > tt_ptr->depth) ||
-        (are_we_pv && (!are_tt_pv || depth_ > tt_ptr->depth)))
+    auto const num_workers =
+        std::min(control_->pool->num_threads(), remaining_moves.size() - next_move);
+    if (num_workers < 2 || control_->is_stopped())
     {
-        tt_ptr->set_key(friends_, enemies_);
-        tt_ptr->recommendation = best_result_;
-        tt_ptr->depth = depth_;
-        tt_ptr->type = node_type_;
+        for (; next_move < remaining_moves.size(); ++next_move)
+        {
+            this->process_move(remaining_moves[next_move]);
+            if (node_type_ == NodeType::Cut)
+                return;
+        }
+        return;
     }
+
+    auto split_point = SplitPoint{control_->split_point};
+    auto mutex = std::mutex{};
+    auto controls = std::vector<SearchControl>(num_workers, control_->make_helper(&split_point));
+
+    auto const work = [&](SearchControl* control) {
+        auto helper = BasicSearcher(depth_, table_, control, network_);
+        helper.friends_ = friends_;
+        helper.enemies_ = enemies_;
+        helper.beta_ = beta_;
+        helper.killer_move_ = killer_move_;
+        helper.accumulator_ = accumulator_;
+
+        while (true)
+        {
+            auto move = InternalMove{};
+            {
+                auto const lock = std::lock_guard{mutex};
+                if (next_move == remaining_moves.size() || node_type_ == NodeType::Cut)
+                    return;
+
+                move = remaining_moves[next_move++];
+                helper.alpha_ = alpha_;
+                helper.best_result_ = best_result_;
+                helper.next_killer_move_ = next_killer_move_;
+                helper.node_type_ = node_type_;
+                helper.move_count_ = move_count_;
+            }
+
+            helper.process_move(move);
+            if (control->is_stopped())
+                return;
+
+            auto const lock = std::lock_guard{mutex};
+            if (helper.best_result_.score > best_result_.score)
+            {
+                best_result_ = helper.best_result_;
+                next_killer_move_ = helper.next_killer_move_;
+            }
+            if (best_result_.score > alpha_)
+            {
+                alpha_ = best_result_.score;
+                node_type_ = NodeType::Pv;
+            }
+            if (alpha_ >= beta_)
+            {
+                node_type_ = NodeType::Cut;
+                split_point.is_cut.store(true, std::memory_order_relaxed);
+            }
+            ++move_count_;
+        }
+    };
+
+    auto tasks = TaskGroup{control_->pool};
+    for (auto i = std::size_t{1}; i < num_workers; ++i)
+        tasks.run([&, control = &controls[i]] { work(control); });
+    work(&controls[0]);
+    tasks.wait();
+
+    for (auto const& control : controls)
+        control_->join_helper(control);
+}
+
+template <typename Weights>
+inline auto BasicSearcher<Weights>::evaluate(bool has_player_won, bool has_player_lost) const
+    -> ScoreType
+{
+    if (network_)
+        return evaluate_leaf_position(has_player_won, has_player_lost, *network_, *accumulator_);
+
+    return evaluate_leaf_position(
+        friends_, enemies_, has_player_won, has_player_lost, Weights::get());
+}
+
+template <typename Weights>
+inline auto BasicSearcher<Weights>::add_to_transposition_table() -> void
+{
+    auto const generation = table_->generation();
+
+    table_->update(friends_, enemies_, [&](TranspositionTable::Value& entry, bool) {
+        bool const are_we_pv = node_type_ == NodeType::Pv;
+        bool const are_tt_pv = entry.type == NodeType::Pv;
+
+        if (entry.generation != generation ||
+            (!are_we_pv && !are_tt_pv && depth_ > entry.depth) ||
+            (are_we_pv && (!are_tt_pv || depth_ > entry.depth)))
+        {
+            entry.set_key(friends_, enemies_);
+            entry.recommendation = best_result_;
+            entry.depth = depth_;
+            entry.type = node_type_;
+            entry.generation = generation;
+        }
+    });
 }
 
 }  // namespace rock::internal
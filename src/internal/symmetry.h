@@ -0,0 +1,165 @@
+#pragma once
+
+#include "internal_types.h"
+#include "rock/types.h"
+#include <limits>
+
+namespace rock::internal
+{
+
+/**
+ * One of the eight symmetries of the board, made of up to three flips, which are applied in the
+ * order of their flags
+ */
+struct Symmetry
+{
+    // Swapping the rows and columns
+    static constexpr auto flip_diagonal = u8{1};
+
+    // Reversing the order of the rows
+    static constexpr auto flip_vertical = u8{2};
+
+    // Reversing the order of the columns
+    static constexpr auto flip_horizontal = u8{4};
+
+    u8 flips{};
+
+    friend constexpr auto operator==(Symmetry a, Symmetry b) -> bool { return a.flips == b.flips; }
+    friend constexpr auto operator!=(Symmetry a, Symmetry b) -> bool { return a.flips != b.flips; }
+};
+
+[[maybe_unused]] constexpr auto flip_vertical_manual(u64 x) -> u64
+{
+    constexpr auto k1 = u64{0x00FF00FF00FF00FF};
+    constexpr auto k2 = u64{0x0000FFFF0000FFFF};
+    x = ((x >> 8) & k1) | ((x & k1) << 8);
+    x = ((x >> 16) & k2) | ((x & k2) << 16);
+    x = (x >> 32) | (x << 32);
+    return x;
+}
+
+inline auto flip_vertical(u64 x) -> u64
+{
+#if defined(__GNUC__)
+    if constexpr (std::numeric_limits<unsigned long>::digits == 64)
+        return static_cast<u64>(__builtin_bswap64(x));
+    else
+#endif
+        return flip_vertical_manual(x);
+}
+
+constexpr auto flip_horizontal(u64 x) -> u64
+{
+    constexpr auto k1 = u64{0x5555555555555555};
+    constexpr auto k2 = u64{0x3333333333333333};
+    constexpr auto k4 = u64{0x0F0F0F0F0F0F0F0F};
+    x = ((x >> 1) & k1) | ((x & k1) << 1);
+    x = ((x >> 2) & k2) | ((x & k2) << 2);
+    x = ((x >> 4) & k4) | ((x & k4) << 4);
+    return x;
+}
+
+/**
+ * Swap the squares (x, y) and (y, x), by swapping blocks of bits across the diagonal: 4x4, then
+ * 2x2, then single squares
+ */
+constexpr auto flip_diagonal(u64 x) -> u64
+{
+    constexpr auto k1 = u64{0x5500550055005500};
+    constexpr auto k2 = u64{0x3333000033330000};
+    constexpr auto k4 = u64{0x0F0F0F0F00000000};
+    auto t = k4 & (x ^ (x << 28));
+    x ^= t ^ (t >> 28);
+    t = k2 & (x ^ (x << 14));
+    x ^= t ^ (t >> 14);
+    t = k1 & (x ^ (x << 7));
+    x ^= t ^ (t >> 7);
+    return x;
+}
+
+inline auto apply_symmetry(u64 board, Symmetry symmetry) -> u64
+{
+    if (symmetry.flips & Symmetry::flip_diagonal)
+        board = flip_diagonal(board);
+    if (symmetry.flips & Symmetry::flip_vertical)
+        board = flip_vertical(board);
+    if (symmetry.flips & Symmetry::flip_horizontal)
+        board = flip_horizontal(board);
+    return board;
+}
+
+/**
+ * The inverse of `apply_symmetry`: each flip is its own inverse, so they are undone in reverse
+ */
+inline auto undo_symmetry(u64 board, Symmetry symmetry) -> u64
+{
+    if (symmetry.flips & Symmetry::flip_horizontal)
+        board = flip_horizontal(board);
+    if (symmetry.flips & Symmetry::flip_vertical)
+        board = flip_vertical(board);
+    if (symmetry.flips & Symmetry::flip_diagonal)
+        board = flip_diagonal(board);
+    return board;
+}
+
+inline auto apply_symmetry(InternalMove move, Symmetry symmetry) -> InternalMove
+{
+    return {apply_symmetry(move.from_board, symmetry), apply_symmetry(move.to_board, symmetry)};
+}
+
+inline auto undo_symmetry(InternalMove move, Symmetry symmetry) -> InternalMove
+{
+    return {undo_symmetry(move.from_board, symmetry), undo_symmetry(move.to_board, symmetry)};
+}
+
+/**
+ * The representative of a position's class of symmetric positions, and the symmetry that takes
+ * the position to it
+ */
+struct CanonicalPosition
+{
+    u64 friends;
+    u64 enemies;
+    Symmetry symmetry;
+};
+
+/**
+ * Of the eight symmetric versions of a position, the one with the lowest `(friends, enemies)`
+ */
+inline auto canonicalize(u64 friends, u64 enemies) -> CanonicalPosition
+{
+    auto best = CanonicalPosition{friends, enemies, Symmetry{}};
+    auto const consider = [&best](u64 f, u64 e, int flips) {
+        if (f < best.friends || (f == best.friends && e < best.enemies))
+            best = CanonicalPosition{f, e, Symmetry{static_cast<u8>(flips)}};
+    };
+
+    // The other flips commute with each other but not with the diagonal one, which comes first.
+    // After it, one flip per step visits every combination of the other two.
+    for (auto const flip_diagonal_first : {false, true})
+    {
+        auto f = flip_diagonal_first ? flip_diagonal(friends) : friends;
+        auto e = flip_diagonal_first ? flip_diagonal(enemies) : enemies;
+        auto flips = flip_diagonal_first ? int{Symmetry::flip_diagonal} : 0;
+        if (flip_diagonal_first)
+            consider(f, e, flips);
+
+        f = flip_horizontal(f);
+        e = flip_horizontal(e);
+        flips ^= Symmetry::flip_horizontal;
+        consider(f, e, flips);
+
+        f = flip_vertical(f);
+        e = flip_vertical(e);
+        flips ^= Symmetry::flip_vertical;
+        consider(f, e, flips);
+
+        f = flip_horizontal(f);
+        e = flip_horizontal(e);
+        flips ^= Symmetry::flip_horizontal;
+        consider(f, e, flips);
+    }
+    return best;
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,440 @@
+#include "tablebase.h"
+#include "evaluate.h"
+#include "move_generation.h"
+#include "thread_pool.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace rock::internal
+{
+
+namespace
+{
+    constexpr char file_magic[8] = {'R', 'O', 'C', 'K', 'T', 'B', '0', '1'};
+
+    // All in native byte order
+    struct FileHeader
+    {
+        char magic[8];
+        u32 max_pieces;
+        u32 num_tables;
+    };
+
+    struct DirectoryEntry
+    {
+        u32 num_friends;
+        u32 num_enemies;
+        u64 offset;
+        u64 size;
+    };
+
+    constexpr auto make_binomials()
+    {
+        auto binomials = std::array<std::array<u64, 65>, 65>{};
+        for (auto n = std::size_t{}; n <= 64; ++n)
+        {
+            binomials[n][0] = 1;
+            for (auto k = std::size_t{1}; k <= n; ++k)
+                binomials[n][k] = binomials[n - 1][k - 1] + binomials[n - 1][k];
+        }
+        return binomials;
+    }
+
+    // Zero where k > n
+    inline constexpr auto binomials = make_binomials();
+
+    /**
+     * Remove the lowest square from `squares`, and return its number
+     */
+    auto extract_one_square(u64& squares) -> u64
+    {
+        return coordinates_from_bit_board(extract_one_bit(squares));
+    }
+
+    /**
+     * The rank of a combination of squares among all the combinations of as many squares, in
+     * colexicographic order
+     */
+    auto rank_combination(u64 squares) -> u64
+    {
+        auto rank = u64{};
+        for (auto k = std::size_t{1}; squares; ++k)
+            rank += binomials[extract_one_square(squares)][k];
+        return rank;
+    }
+
+    auto unrank_combination(u64 rank, int num_squares, int k) -> u64
+    {
+        auto squares = u64{};
+        auto n = num_squares;
+        for (; k > 0; --k)
+        {
+            do
+                --n;
+            while (binomials[n][k] > rank);
+
+            rank -= binomials[n][k];
+            squares |= u64{1} << n;
+        }
+        return squares;
+    }
+
+    /**
+     * Number the squares that are not `taken` from zero, and give `squares` in those numbers
+     */
+    auto compress_squares(u64 squares, u64 taken) -> u64
+    {
+        auto compressed = u64{};
+        while (squares)
+        {
+            auto const square = extract_one_square(squares);
+            auto const below = (u64{1} << square) - 1;
+            compressed |= u64{1} << (square - pop_count(taken & below));
+        }
+        return compressed;
+    }
+
+    auto expand_squares(u64 compressed, u64 taken) -> u64
+    {
+        auto squares = u64{};
+        auto free_squares = ~taken;
+        for (auto i = 0; free_squares; ++i)
+        {
+            auto const square = extract_one_square(free_squares);
+            if (compressed & (u64{1} << i))
+                squares |= u64{1} << square;
+        }
+        return squares;
+    }
+
+    // An entry is stored as 0 for a draw, 1 + 2 * distance for a win, and 2 + 2 * distance for a
+    // loss. Positions not solved yet are `unknown` while the tables are generated.
+    constexpr auto draw_value = u8{0};
+    constexpr auto unknown_value = u8{255};
+    constexpr auto max_distance = 126;
+
+    constexpr auto encode(GameResult result, int distance) -> u8
+    {
+        if (result == GameResult::Draw)
+            return draw_value;
+        return static_cast<u8>((result == GameResult::Win ? 1 : 2) + 2 * distance);
+    }
+
+    constexpr auto decode(u8 value) -> TablebaseEntry
+    {
+        if (value == draw_value)
+            return {GameResult::Draw, 0};
+        return {value % 2 == 1 ? GameResult::Win : GameResult::Loss, (value - 1) / 2};
+    }
+
+    auto material_of(BitBoard friends, BitBoard enemies) -> Material
+    {
+        return {static_cast<int>(pop_count(friends)), static_cast<int>(pop_count(enemies))};
+    }
+
+    /**
+     * The tables while they are being solved, which the threads of a round read and write at once
+     */
+    struct TableGenerator
+    {
+        using Values = std::vector<std::atomic<u8>>;
+
+        explicit TableGenerator(ThreadPool* pool) : pool_{pool} {}
+
+        auto solve(Material material, Material mirror) -> void
+        {
+            auto const materials = material == mirror ? std::vector{material}
+                                                      : std::vector{material, mirror};
+            for (auto const m : materials)
+            {
+                auto& values = tables_[m.num_friends][m.num_enemies];
+                values = std::make_unique<Values>(tablebase_size(m));
+                for (auto& value : *values)
+                    value.store(unknown_value, std::memory_order_relaxed);
+            }
+
+            for (auto distance = 0; distance <= max_distance + 1; ++distance)
+            {
+                auto num_solved = u64{};
+                for (auto const m : materials)
+                    num_solved += run_round(m, distance);
+
+                if (num_solved == 0 && distance > 0)
+                    return;
+            }
+
+            throw std::runtime_error("Tablebase distances are too long to be stored");
+        }
+
+        auto values(Material material) const -> Values const&
+        {
+            return *tables_[material.num_friends][material.num_enemies];
+        }
+
+    private:
+        static constexpr auto chunk_size = u64{1} << 16;
+
+        /**
+         * Solve the positions of a material that are won or lost in `distance` moves, returning
+         * how many there were
+         */
+        auto run_round(Material material, int distance) -> u64
+        {
+            auto& values = *tables_[material.num_friends][material.num_enemies];
+            auto const num_chunks = (values.size() + chunk_size - 1) / chunk_size;
+            auto num_solved = std::atomic<u64>{};
+
+            auto tasks = TaskGroup{pool_};
+            for (auto chunk = u64{}; chunk < num_chunks; ++chunk)
+            {
+                tasks.run([&, chunk] {
+                    auto const end = std::min<u64>(values.size(), (chunk + 1) * chunk_size);
+                    auto solved = u64{};
+                    for (auto index = chunk * chunk_size; index < end; ++index)
+                    {
+                        if (values[index].load(std::memory_order_relaxed) != unknown_value)
+                            continue;
+
+                        auto const [friends, enemies] = tablebase_position(material, index);
+                        auto const value = distance == 0 ? solve_finished(friends, enemies)
+                                                         : solve_in(friends, enemies, distance);
+                        if (value != unknown_value)
+                        {
+                            values[index].store(value, std::memory_order_relaxed);
+                            ++solved;
+                        }
+                    }
+                    num_solved += solved;
+                });
+            }
+            tasks.wait();
+
+            return num_solved;
+        }
+
+        static auto solve_finished(BitBoard friends, BitBoard enemies) -> u8
+        {
+            bool const has_player_won = are_pieces_all_together(friends);
+            bool const has_player_lost = are_pieces_all_together(enemies);
+            if (has_player_won && has_player_lost)
+                return draw_value;
+            if (has_player_won)
+                return encode(GameResult::Win, 0);
+            if (has_player_lost)
+                return encode(GameResult::Loss, 0);
+            if (count_moves(friends, enemies, 1) == 0)
+                return draw_value;
+            return unknown_value;
+        }
+
+        auto solve_in(BitBoard friends, BitBoard enemies, int distance) const -> u8
+        {
+            // Entries being solved in this round have a distance of `distance`, so are never
+            // taken for the distance before it
+            auto is_won = false;
+            auto are_all_lost = true;
+
+            auto moves = generate_moves(friends, enemies);
+            for_each_move(moves, [&](u64 from_board, u64 to_board) {
+                if (is_won)
+                    return;
+
+                auto friends_copy = friends;
+                auto enemies_copy = enemies;
+                apply_move_low_level(from_board, to_board, &friends_copy, &enemies_copy);
+
+                auto const value = lookup(enemies_copy, friends_copy);
+                if (value == unknown_value || value == draw_value)
+                {
+                    are_all_lost = false;
+                    return;
+                }
+
+                auto const entry = decode(value);
+                if (entry.result == GameResult::Loss && entry.distance == distance - 1)
+                    is_won = true;
+                if (entry.result != GameResult::Win || entry.distance >= distance)
+                    are_all_lost = false;
+            });
+
+            if (is_won)
+                return encode(GameResult::Win, distance);
+            if (are_all_lost)
+                return encode(GameResult::Loss, distance);
+            return unknown_value;
+        }
+
+        auto lookup(BitBoard friends, BitBoard enemies) const -> u8
+        {
+            auto const finished = solve_finished(friends, enemies);
+            if (finished != unknown_value)
+                return finished;
+
+            auto const material = material_of(friends, enemies);
+            auto const& values = *tables_[material.num_friends][material.num_enemies];
+            return values[tablebase_index(friends, enemies)].load(std::memory_order_relaxed);
+        }
+
+        ThreadPool* pool_;
+        std::array<std::array<std::unique_ptr<Values>, 13>, 13> tables_{};
+    };
+
+    auto write_bytes(std::ofstream& file, void const* data, std::size_t size) -> void
+    {
+        file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+    }
+}  // namespace
+
+auto list_tablebase_materials(int max_pieces) -> std::vector<Material>
+{
+    auto materials = std::vector<Material>{};
+    for (auto total = 4; total <= max_pieces; ++total)
+    {
+        for (auto num_friends = 2; num_friends <= std::min(12, total - 2); ++num_friends)
+        {
+            if (total - num_friends <= 12)
+                materials.push_back(Material{num_friends, total - num_friends});
+        }
+    }
+    return materials;
+}
+
+auto tablebase_size(Material material) -> u64
+{
+    return binomials[64][material.num_friends] *
+        binomials[64 - material.num_friends][material.num_enemies];
+}
+
+auto tablebase_index(BitBoard friends, BitBoard enemies) -> u64
+{
+    auto const material = material_of(friends, enemies);
+    auto const num_enemy_combinations = binomials[64 - material.num_friends][material.num_enemies];
+    return rank_combination(friends) * num_enemy_combinations +
+        rank_combination(compress_squares(enemies, friends));
+}
+
+auto tablebase_position(Material material, u64 index) -> std::pair<BitBoard, BitBoard>
+{
+    auto const num_free_squares = 64 - material.num_friends;
+    auto const num_enemy_combinations = binomials[num_free_squares][material.num_enemies];
+
+    auto const friends = unrank_combination(
+        index / num_enemy_combinations, 64, material.num_friends);
+    auto const compressed_enemies = unrank_combination(
+        index % num_enemy_combinations, num_free_squares, material.num_enemies);
+    return {friends, expand_squares(compressed_enemies, friends)};
+}
+
+auto Tablebase::open(std::string const& path) -> std::unique_ptr<Tablebase>
+{
+    auto file = MappedFile::open(path);
+    if (!file)
+        return nullptr;
+
+    auto tablebase = std::unique_ptr<Tablebase>{new Tablebase{std::move(*file)}};
+    auto const* bytes = tablebase->file_.data();
+    auto const size = tablebase->file_.size();
+
+    auto header = FileHeader{};
+    if (size < sizeof(header))
+        return nullptr;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+        return nullptr;
+
+    auto const directory_end = sizeof(header) + u64{header.num_tables} * sizeof(DirectoryEntry);
+    if (directory_end > size)
+        return nullptr;
+
+    for (auto i = u64{}; i < header.num_tables; ++i)
+    {
+        auto entry = DirectoryEntry{};
+        std::memcpy(&entry, bytes + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        auto const material = Material{
+            static_cast<int>(entry.num_friends),
+            static_cast<int>(entry.num_enemies),
+        };
+        if (entry.num_friends > max_pieces_per_player ||
+            entry.num_enemies > max_pieces_per_player || entry.size != tablebase_size(material) ||
+            entry.offset > size || entry.size > size - entry.offset)
+            return nullptr;
+
+        tablebase->tables_[entry.num_friends][entry.num_enemies] = bytes + entry.offset;
+    }
+
+    tablebase->max_pieces_ = static_cast<int>(header.max_pieces);
+    return tablebase;
+}
+
+auto Tablebase::probe(BitBoard friends, BitBoard enemies) const -> std::optional<TablebaseEntry>
+{
+    if (static_cast<int>(pop_count(friends | enemies)) > max_pieces_)
+        return std::nullopt;
+
+    auto const material = material_of(friends, enemies);
+    auto const* table = tables_[material.num_friends][material.num_enemies];
+    if (!table)
+        return std::nullopt;
+
+    return decode(table[tablebase_index(friends, enemies)]);
+}
+
+auto generate_tablebase(int max_pieces, std::string const& path, ThreadPool* pool) -> void
+{
+    auto const materials = list_tablebase_materials(max_pieces);
+    auto generator = TableGenerator{pool};
+
+    for (auto const material : materials)
+    {
+        // Solved along with the mirror image, which comes first
+        if (material.num_friends <= material.num_enemies)
+            generator.solve(material, Material{material.num_enemies, material.num_friends});
+    }
+
+    auto file = std::ofstream(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("Could not open '{}' for writing", path));
+
+    auto header = FileHeader{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.max_pieces = static_cast<u32>(max_pieces);
+    header.num_tables = static_cast<u32>(materials.size());
+    write_bytes(file, &header, sizeof(header));
+
+    auto offset = sizeof(header) + materials.size() * sizeof(DirectoryEntry);
+    for (auto const material : materials)
+    {
+        auto const entry = DirectoryEntry{
+            static_cast<u32>(material.num_friends),
+            static_cast<u32>(material.num_enemies),
+            offset,
+            tablebase_size(material),
+        };
+        write_bytes(file, &entry, sizeof(entry));
+        offset += entry.size;
+    }
+
+    auto buffer = std::vector<u8>{};
+    for (auto const material : materials)
+    {
+        auto const& values = generator.values(material);
+        buffer.resize(values.size());
+
+        // Positions that were never won or lost are draws
+        std::transform(values.begin(), values.end(), buffer.begin(), [](auto const& value) {
+            auto const v = value.load(std::memory_order_relaxed);
+            return v == unknown_value ? draw_value : v;
+        });
+        write_bytes(file, buffer.data(), buffer.size());
+    }
+
+    if (!file)
+        throw std::runtime_error(fmt::format("Could not write '{}'", path));
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "internal_types.h"
+#include "mapped_file.h"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rock::internal
+{
+
+struct ThreadPool;
+
+/**
+ * The number of pieces of each player, from the point of view of the player to move
+ */
+struct Material
+{
+    int num_friends;
+    int num_enemies;
+
+    friend constexpr auto operator==(Material const& a, Material const& b) -> bool
+    {
+        return a.num_friends == b.num_friends && a.num_enemies == b.num_enemies;
+    }
+};
+
+/**
+ * The materials with a table, for a total of up to `max_pieces`. A player with a single piece has
+ * already connected, so each player has at least two.
+ */
+auto list_tablebase_materials(int max_pieces) -> std::vector<Material>;
+
+/**
+ * The positions of a material are numbered by the combination of squares of the player to move,
+ * then by the combination of the remaining squares taken by the opponent
+ */
+auto tablebase_size(Material) -> u64;
+auto tablebase_index(BitBoard friends, BitBoard enemies) -> u64;
+auto tablebase_position(Material, u64 index) -> std::pair<BitBoard, BitBoard>;
+
+/**
+ * The result of a position with best play, and how many moves it takes to reach it. The winner
+ * plays for the fastest win and the loser for the slowest loss.
+ */
+struct TablebaseEntry
+{
+    GameResult result;
+    int distance;
+};
+
+/**
+ * Endgame tablebases, as written by `generate_tablebase`, memory-mapped from a file
+ *
+ * The file starts with a header and a directory of the tables it holds, followed by the tables,
+ * with one byte for each position.
+ */
+struct Tablebase
+{
+    /**
+     * Returns null if the file cannot be read or is not a tablebase file
+     */
+    static auto open(std::string const& path) -> std::unique_ptr<Tablebase>;
+
+    /**
+     * Positions with more pieces in total than this are never in the tablebase
+     */
+    auto max_pieces() const -> int { return max_pieces_; }
+
+    auto probe(BitBoard friends, BitBoard enemies) const -> std::optional<TablebaseEntry>;
+
+private:
+    static constexpr auto max_pieces_per_player = 12;
+
+    explicit Tablebase(MappedFile file) : file_{std::move(file)} {}
+
+    MappedFile file_;
+
+    // By the number of pieces of the player to move, then of the opponent
+    std::array<std::array<u8 const*, max_pieces_per_player + 1>, max_pieces_per_player + 1>
+        tables_{};
+    int max_pieces_{};
+};
+
+/**
+ * Solve every position with up to `max_pieces` pieces by retrograde analysis, and write the
+ * tables to a file
+ *
+ * The materials are solved from the fewest pieces up, as a capture leads to a table that is
+ * already solved. Each material is solved together with its mirror image (the same numbers of
+ * pieces, with the other player to move), in rounds: round `n` finds the positions won in `n`
+ * moves, by a move to a position lost in `n - 1`, and the positions lost in `n`, where every move
+ * leads to a position won in less. Positions that are neither won nor lost once a round finds
+ * nothing more are draws. Each round is shared out between the threads of the pool, if there is
+ * one.
+ *
+ * Throws `std::runtime_error` if the file cannot be written.
+ */
+auto generate_tablebase(int max_pieces, std::string const& path, ThreadPool* = nullptr) -> void;
+
+}  // namespace rock::internal
@@ -0,0 +1,284 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rock::internal
+{
+
+namespace
+{
+    // The pool (and index within it) of the pool thread running on this thread, if any
+    thread_local ThreadPool const* this_thread_pool = nullptr;
+    thread_local std::size_t this_thread_index = 0;
+
+    auto pin_this_thread(std::size_t index) -> void
+    {
+#ifdef __linux__
+        auto const num_cores = std::max(1u, std::thread::hardware_concurrency());
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(index % num_cores, &cpu_set);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+        (void)index;
+#endif
+    }
+}  // namespace
+
+ThreadPool::ThreadPool(ThreadPoolConfig const& config)
+    : global_queue_capacity_{config.global_queue_capacity}
+{
+    auto const num_threads = std::max(std::size_t{1}, config.num_threads);
+
+    // All the workers must exist before any of them starts looking for tasks to steal
+    for (auto i = std::size_t{}; i < num_threads; ++i)
+        workers_.push_back(std::make_unique<Worker>());
+
+    for (auto i = std::size_t{}; i < num_threads; ++i)
+    {
+        workers_[i]->thread = std::thread{[this, i, pin = config.pin_threads] {
+            if (pin)
+                pin_this_thread(i);
+            run_worker(i);
+        }};
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        auto const lock = std::lock_guard{sleep_mutex_};
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& worker : workers_)
+        worker->thread.join();
+}
+
+auto ThreadPool::current_worker_index() const -> std::optional<std::size_t>
+{
+    if (this_thread_pool != this)
+        return std::nullopt;
+    return this_thread_index;
+}
+
+auto ThreadPool::submit(Task task) -> void
+{
+    push(std::move(task), /*may_run_inline=*/true);
+}
+
+auto ThreadPool::enqueue(Task task) -> void
+{
+    push(std::move(task), /*may_run_inline=*/false);
+}
+
+auto ThreadPool::push(Task task, bool may_run_inline) -> void
+{
+    if (auto const index = current_worker_index())
+    {
+        auto& worker = *workers_[*index];
+        auto const lock = std::lock_guard{worker.mutex};
+        worker.tasks.push_back(std::move(task));
+    }
+    else
+    {
+        auto lock = std::unique_lock{global_mutex_};
+        if (may_run_inline && global_queue_.size() >= global_queue_capacity_)
+        {
+            lock.unlock();
+            task();
+            return;
+        }
+        global_queue_.push_back(std::move(task));
+    }
+
+    ++num_queued_;
+    wake_one();
+}
+
+auto ThreadPool::wake_one() -> void
+{
+    // Only take the lock if a thread may be sleeping. A thread going to sleep counts itself as
+    // sleeping before checking for queued tasks, so either it sees the new task, or it is seen.
+    if (num_sleeping_ == 0)
+        return;
+
+    {
+        auto const lock = std::lock_guard{sleep_mutex_};
+    }
+    wake_.notify_one();
+}
+
+auto ThreadPool::find_task(std::optional<std::size_t> own_index) -> std::optional<Task>
+{
+    auto task = std::optional<Task>{};
+
+    auto const take = [&](std::deque<Task>& tasks, bool newest) {
+        if (tasks.empty())
+            return false;
+        if (newest)
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        --num_queued_;
+        return true;
+    };
+
+    if (num_queued_ == 0)
+        return std::nullopt;
+
+    if (own_index)
+    {
+        auto& worker = *workers_[*own_index];
+        auto const lock = std::lock_guard{worker.mutex};
+        if (take(worker.tasks, true))
+            return task;
+    }
+
+    {
+        auto const lock = std::lock_guard{global_mutex_};
+        if (take(global_queue_, false))
+            return task;
+    }
+
+    auto const start = own_index.value_or(0) + 1;
+    for (auto i = std::size_t{}; i < workers_.size(); ++i)
+    {
+        auto& victim = *workers_[(start + i) % workers_.size()];
+        auto const lock = std::lock_guard{victim.mutex};
+        if (take(victim.tasks, false))
+            return task;
+    }
+
+    return std::nullopt;
+}
+
+auto ThreadPool::run_worker(std::size_t index) -> void
+{
+    this_thread_pool = this;
+    this_thread_index = index;
+
+    while (true)
+    {
+        if (auto task = find_task(index))
+        {
+            (*task)();
+            continue;
+        }
+
+        auto lock = std::unique_lock{sleep_mutex_};
+        ++num_sleeping_;
+        wake_.wait(lock, [&] { return stopping_ || num_queued_ > 0; });
+        --num_sleeping_;
+
+        if (stopping_ && num_queued_ == 0)
+            return;
+    }
+}
+
+auto TaskGroup::run_slot(Slot& slot) -> void
+{
+    try
+    {
+        slot.task();
+    }
+    catch (...)
+    {
+        auto const lock = std::lock_guard{mutex_};
+        if (!exception_)
+            exception_ = std::current_exception();
+    }
+    slot.task = nullptr;
+
+    // The group may be destroyed as soon as the waiting thread sees this, which it can only do
+    // once the lock is released
+    auto const lock = std::lock_guard{mutex_};
+    if (--pending_ == 0)
+        done_.notify_all();
+}
+
+auto TaskGroup::add(Task task, bool may_run_inline) -> void
+{
+    auto slot = std::make_shared<Slot>();
+    slot->task = std::move(task);
+    slot->group = this;
+
+    ++pending_;
+    {
+        auto const lock = std::lock_guard{mutex_};
+        slots_.push_back(slot);
+    }
+
+    if (!pool_)
+    {
+        if (may_run_inline && !slot->is_claimed.exchange(true))
+            run_slot(*slot);
+        return;
+    }
+
+    // Only a task that has not been claimed yet can touch the group, which is then still alive
+    auto pool_task = [slot = std::move(slot)] {
+        if (!slot->is_claimed.exchange(true))
+            slot->group->run_slot(*slot);
+    };
+    if (may_run_inline)
+        pool_->submit(std::move(pool_task));
+    else
+        pool_->enqueue(std::move(pool_task));
+}
+
+auto TaskGroup::run(Task task) -> void
+{
+    add(std::move(task), /*may_run_inline=*/true);
+}
+
+auto TaskGroup::run_until_stopped(Task task) -> void
+{
+    add(std::move(task), /*may_run_inline=*/false);
+}
+
+auto TaskGroup::wait() -> void
+{
+    auto lock = std::unique_lock{mutex_};
+    while (pending_ > 0)
+    {
+        // Help with the tasks of the group that have not started
+        if (next_slot_ < slots_.size())
+        {
+            auto const slot = std::move(slots_[next_slot_++]);
+            if (slot->is_claimed.exchange(true))
+                continue;
+
+            lock.unlock();
+            run_slot(*slot);
+            lock.lock();
+            continue;
+        }
+
+        // The rest are running elsewhere, and may add tasks of their own to the group
+        done_.wait_for(lock, std::chrono::microseconds{200}, [&] {
+            return pending_ == 0 || next_slot_ < slots_.size();
+        });
+    }
+    slots_.clear();
+    next_slot_ = 0;
+
+    if (auto const exception = std::exchange(exception_, nullptr))
+        std::rethrow_exception(exception);
+}
+
+}  // namespace rock::internal
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace rock::internal
+{
+
+using Task = std::function<void()>;
+
+struct ThreadPoolConfig
+{
+    std::size_t num_threads{1};
+    bool pin_threads{};
+    std::size_t global_queue_capacity{1024};
+};
+
+/**
+ * Work-stealing thread pool
+ *
+ * Each thread has its own deque of tasks. Tasks submitted from one of the pool's threads go on
+ * that thread's deque, which it works through newest first, while idle threads steal the oldest
+ * tasks from the other deques. Tasks submitted from any other thread go on a global queue. The
+ * global queue is bounded: when it is full, `submit` has the submitting thread run the task
+ * itself, which keeps a fast producer from queuing an unbounded amount of work. Tasks that only
+ * end when told to must never run that way, so `enqueue` queues them whatever the size.
+ */
+struct ThreadPool
+{
+    explicit ThreadPool(ThreadPoolConfig const&);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    auto operator=(ThreadPool const&) -> ThreadPool& = delete;
+
+    auto num_threads() const -> std::size_t { return workers_.size(); }
+
+    /**
+     * Queue the task, or run it on the calling thread if the global queue is full
+     */
+    auto submit(Task) -> void;
+
+    /**
+     * Queue the task, even if the global queue is full
+     */
+    auto enqueue(Task) -> void;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex{};
+        std::deque<Task> tasks{};
+        std::thread thread{};
+    };
+
+    auto push(Task, bool may_run_inline) -> void;
+    auto run_worker(std::size_t index) -> void;
+    auto find_task(std::optional<std::size_t> own_index) -> std::optional<Task>;
+    auto current_worker_index() const -> std::optional<std::size_t>;
+    auto wake_one() -> void;
+
+    std::vector<std::unique_ptr<Worker>> workers_{};
+
+    std::mutex global_mutex_{};
+    std::deque<Task> global_queue_{};
+    std::size_t global_queue_capacity_;
+
+    // Idle threads sleep until a task is queued
+    std::atomic<std::size_t> num_queued_{};
+    std::atomic<std::size_t> num_sleeping_{};
+    std::mutex sleep_mutex_{};
+    std::condition_variable wake_{};
+    bool stopping_{};
+};
+
+/**
+ * A set of tasks that can be waited on together. Waiting runs the group's own tasks that have not
+ * started yet on the waiting thread, so tasks may start and wait on groups of their own without
+ * tying up the pool, and never runs the tasks of other groups, whose thread-local state (such as
+ * the transposition table and Monte-Carlo tree of an analysis) the waiting thread may be using.
+ *
+ * A task given to `run` may so run on the thread that waits, or on the thread that calls `run`
+ * when the global queue is full. It must be finite, and must not touch the thread-local state of
+ * the analysis on whose behalf it runs. A task that only ends when told to is given to
+ * `run_until_stopped` instead, and must be told to stop before the group is waited on.
+ *
+ * Without a pool, tasks are run straight away on the calling thread.
+ */
+struct TaskGroup
+{
+    explicit TaskGroup(ThreadPool* pool) : pool_{pool} {}
+
+    TaskGroup(TaskGroup const&) = delete;
+    auto operator=(TaskGroup const&) -> TaskGroup& = delete;
+
+    /**
+     * Must have been waited on
+     */
+    ~TaskGroup() { assert(pending_ == 0); }
+
+    auto run(Task) -> void;
+
+    /**
+     * Run the task on a thread of the pool, never on the calling thread. Without a pool, or with
+     * fewer threads than tasks, the task may not start until the group is waited on.
+     */
+    auto run_until_stopped(Task) -> void;
+
+    /**
+     * Wait for all the tasks to finish, rethrowing the first exception thrown by any of them
+     */
+    auto wait() -> void;
+
+private:
+    /**
+     * A task of the group, run by whichever of the pool and the waiting thread claims it first.
+     * The pool holds on to it until then, which may be after the group is gone.
+     */
+    struct Slot
+    {
+        Task task;
+        TaskGroup* group;
+        std::atomic<bool> is_claimed{};
+    };
+
+    auto add(Task, bool may_run_inline) -> void;
+    auto run_slot(Slot&) -> void;
+
+    ThreadPool* pool_;
+    std::atomic<std::size_t> pending_{};
+
+    std::mutex mutex_{};
+    std::condition_variable done_{};
+    std::exception_ptr exception_{};
+
+    // The tasks of the group, oldest first, of which those from the next one on may not have
+    // started yet
+    std::vector<std::shared_ptr<Slot>> slots_{};
+    std::size_t next_slot_{};
+};
+
+}  // namespace rock::internal
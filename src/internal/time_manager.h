@@ -0,0 +1,113 @@
+#pragma once
+
+#include "rock/algorithms.h"
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+namespace rock::internal
+{
+
+using SearchClock = std::chrono::steady_clock;
+
+/**
+ * Decides how long an iterative deepening search may run, from the time limits of the search
+ *
+ * There are two budgets: a soft one, after which no new depth is started, and a hard one, at
+ * which the running depth is abandoned. Before starting a depth, its cost is predicted from the
+ * cost of the previous depth and the branching factor observed so far, so that a depth which
+ * would only be abandoned is not started.
+ */
+struct TimeManager
+{
+    explicit TimeManager(
+        SearchLimits const& limits, SearchClock::time_point start = SearchClock::now())
+        : start_{start}, last_iteration_end_{start}
+    {
+        if (limits.move_time)
+            set_budget(*limits.move_time, *limits.move_time);
+
+        if (limits.clock)
+        {
+            auto const& clock = *limits.clock;
+            auto const moves_to_go = std::max(1, clock.moves_to_go.value_or(default_moves_to_go));
+
+            // Keep a margin for the time taken to get the move back to the caller
+            auto const usable = std::max(clock.remaining - overhead, clock.remaining / 2);
+            auto const allocation = usable / moves_to_go + clock.increment * 3 / 4;
+
+            set_budget(std::min(allocation, usable / 2), std::min(allocation * 4, usable * 3 / 4));
+        }
+    }
+
+    /**
+     * After this point, the running depth should be abandoned
+     */
+    auto hard_deadline() const -> std::optional<SearchClock::time_point>
+    {
+        if (!hard_budget_)
+            return std::nullopt;
+        return start_ + *hard_budget_;
+    }
+
+    /**
+     * The time to stop a search that loses nothing by stopping at any point, rather than by
+     * depths
+     */
+    auto soft_deadline() const -> std::optional<SearchClock::time_point>
+    {
+        if (!soft_budget_)
+            return std::nullopt;
+        return start_ + *soft_budget_;
+    }
+
+    /**
+     * Called each time a depth completes
+     */
+    auto should_start_next_iteration(SearchClock::time_point now = SearchClock::now()) -> bool
+    {
+        auto const iteration = std::chrono::duration<double>(now - last_iteration_end_).count();
+        auto const elapsed = now - start_;
+
+        // Very short iterations are dominated by noise, so their ratio is not trusted
+        auto branching_factor = default_branching_factor;
+        if (previous_iteration_ > min_measurable_iteration)
+        {
+            branching_factor = std::clamp(
+                iteration / previous_iteration_, min_branching_factor, max_branching_factor);
+        }
+
+        previous_iteration_ = iteration;
+        last_iteration_end_ = now;
+
+        if (!soft_budget_)
+            return true;
+
+        auto const predicted = std::chrono::duration_cast<SearchClock::duration>(
+            std::chrono::duration<double>(iteration * branching_factor));
+        return elapsed < *soft_budget_ && elapsed + predicted <= *hard_budget_;
+    }
+
+private:
+    static constexpr auto default_moves_to_go = 30;
+    static constexpr auto overhead = std::chrono::milliseconds{10};
+    static constexpr auto default_branching_factor = 4.0;
+    static constexpr auto min_branching_factor = 1.5;
+    static constexpr auto max_branching_factor = 10.0;
+    static constexpr auto min_measurable_iteration = 1e-4;
+
+    auto set_budget(SearchClock::duration soft, SearchClock::duration hard) -> void
+    {
+        soft_budget_ = soft_budget_ ? std::min(*soft_budget_, soft) : soft;
+        hard_budget_ = hard_budget_ ? std::min(*hard_budget_, hard) : hard;
+    }
+
+    SearchClock::time_point start_;
+    SearchClock::time_point last_iteration_end_;
+    double previous_iteration_{};
+
+    std::optional<SearchClock::duration> soft_budget_{};
+    std::optional<SearchClock::duration> hard_budget_{};
+};
+
+}  // namespace rock::internal
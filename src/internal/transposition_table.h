@@ -4,7 +4,14 @@
 #include "diagnostics.h"
 #include "internal_types.h"
 #include "rock/types.h"
+#include "symmetry.h"
 #include <absl/hash/hash.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <optional>
+#include <thread>
+#include <vector>
 
 namespace rock::internal
 {
@@ -41,15 +48,58 @@ public:
         InternalMoveRecommendation recommendation{};
         int depth{};
         NodeType type{};
+
+        // Entries from an earlier generation can be replaced by any new entry. Wide enough not to
+        // wrap around in the life of a table that is aged before every search, and takes what
+        // would otherwise be padding.
+        u32 generation{};
     };
 
+    static_assert(sizeof(Value) == 56);
+
     static constexpr auto default_size = std::size_t{16};
 
-    explicit TranspositionTable(std::size_t size = default_size)
-        : size_{size}, data_(std::size_t{2} << size_, Value{})
+    /**
+     * A table that is shared between threads locks each entry while it is used. The threads must
+     * then only use `load` and `update`, as the entries returned by `lookup` are not locked.
+     */
+    explicit TranspositionTable(std::size_t size = default_size, bool is_shared = false)
+        : size_{size},
+          data_(std::size_t{2} << size_, Value{}),
+          locks_(is_shared ? std::min(num_locks, data_.size()) : 0)
     {}
 
-    auto reset() -> void { std::fill(data_.begin(), data_.end(), Value{}); }
+    auto reset() -> void
+    {
+        std::fill(data_.begin(), data_.end(), Value{});
+        generation_ = 0;
+    }
+
+    /**
+     * Whether positions that are reflections or rotations of each other share an entry. The
+     * entries are keyed by the canonical version of each position (see `canonicalize`), and their
+     * moves are turned back to match the position they are loaded for. This costs a few flips of
+     * each board per access, in return for finding transpositions that differ by a symmetry, as
+     * is common in openings, where the starting position is symmetric.
+     *
+     * The scores are only shared correctly if the evaluation is symmetric too. Switching the mode
+     * clears the table.
+     */
+    auto set_symmetric(bool is_symmetric) -> void
+    {
+        if (is_symmetric == is_symmetric_)
+            return;
+        is_symmetric_ = is_symmetric;
+        reset();
+    }
+    auto is_symmetric() const -> bool { return is_symmetric_; }
+
+    /**
+     * Keep the entries, but let them be replaced as if they were empty. This is for starting a
+     * search of a position close to the previous one, where the old entries may still help.
+     */
+    auto age() -> void { ++generation_; }
+    auto generation() const -> u32 { return generation_; }
 
     struct LookupResult
     {
@@ -63,8 +113,13 @@ public:
         bool was_found;
     };
 
+    /**
+     * The entries returned by `lookup` are keyed by the exact position, so it must not be used on
+     * symmetric tables
+     */
     auto lookup(u64 friends, u64 enemies) const -> ConstLookupResult
     {
+        assert(!is_symmetric_);
         auto const index = compute_hash(friends, enemies) % (std::size_t{2} << size_);
         auto const* value = &data_[index];
         return {value, value->matches(friends, enemies)};
@@ -72,6 +127,7 @@ public:
 
     auto lookup(u64 friends, u64 enemies) -> LookupResult
     {
+        assert(!is_symmetric_);
         auto const index = compute_hash(friends, enemies) % (std::size_t{2} << size_);
         auto* value = &data_[index];
 #ifdef DIAGNOSTICS
@@ -82,9 +138,98 @@ public:
         return {value, value->matches(friends, enemies)};
     }
 
+    /**
+     * A copy of the entry for the position, if there is one
+     */
+    auto load(u64 friends, u64 enemies) const -> std::optional<Value>
+    {
+        auto const key = make_key(friends, enemies);
+        auto const index = compute_hash(key.friends, key.enemies) % (std::size_t{2} << size_);
+        auto value = with_entry_locked(index, [&]() -> std::optional<Value> {
+            auto const& value = data_[index];
+            if (!value.matches(key.friends, key.enemies))
+                return std::nullopt;
+            return value;
+        });
+
+        if (value)
+            value->recommendation.move = undo_symmetry(value->recommendation.move, key.symmetry);
+        return value;
+    }
+
+    /**
+     * Call `f(value, was_found)` with the entry that the position belongs in, which holds another
+     * position if it was not found
+     */
+    template <typename F>
+    auto update(u64 friends, u64 enemies, F&& f) -> void
+    {
+        if (!is_symmetric_)
+        {
+            auto const index = compute_hash(friends, enemies) % (std::size_t{2} << size_);
+            with_entry_locked(index, [&] {
+                auto& value = data_[index];
+                f(value, value.matches(friends, enemies));
+            });
+            return;
+        }
+
+        // `f` sees the entry as if it were for the position it was given
+        auto const key = canonicalize(friends, enemies);
+        auto const index = compute_hash(key.friends, key.enemies) % (std::size_t{2} << size_);
+        with_entry_locked(index, [&] {
+            auto& value = data_[index];
+            auto copy = value;
+            copy.recommendation.move = undo_symmetry(copy.recommendation.move, key.symmetry);
+
+            f(copy, copy.matches(key.friends, key.enemies));
+
+            if (copy.matches(friends, enemies))
+                copy.set_key(key.friends, key.enemies);
+            copy.recommendation.move = apply_symmetry(copy.recommendation.move, key.symmetry);
+            value = copy;
+        });
+    }
+
 private:
+    auto make_key(u64 friends, u64 enemies) const -> CanonicalPosition
+    {
+        return is_symmetric_ ? canonicalize(friends, enemies)
+                             : CanonicalPosition{friends, enemies, Symmetry{}};
+    }
+
+    // Entries share locks, which only matters if two threads want entries with the same lock at
+    // the same time
+    static constexpr auto num_locks = std::size_t{1} << 12;
+
+    template <typename F>
+    auto with_entry_locked(std::size_t index, F&& f) const -> decltype(f())
+    {
+        if (locks_.empty())
+            return f();
+
+        // Entries are held for a handful of instructions, so spin rather than sleep
+        auto& lock = locks_[index % locks_.size()];
+        while (lock.exchange(true, std::memory_order_acquire))
+        {
+            while (lock.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+        }
+
+        struct Unlock
+        {
+            std::atomic<bool>& lock;
+            ~Unlock() { lock.store(false, std::memory_order_release); }
+        } const unlock{lock};
+
+        return f();
+    }
+
     std::size_t size_{};
     std::vector<Value> data_{};
+    mutable std::vector<std::atomic<bool>> locks_{};
+    u32 generation_{};
+    bool is_symmetric_{};
 };
 
 }  // namespace rock::internal
@@ -0,0 +1,16 @@
+#pragma once
+
+// Generated by rock_tune. Regenerate with the tool rather than editing by hand.
+// Source: hand-set initial weights
+
+#include "evaluation_weights.h"
+
+namespace rock::internal
+{
+
+inline constexpr EvaluationWeights tuned_evaluation_weights = {
+    /*centre_circles=*/{10, 10, 10},
+    /*tempo=*/20,
+};
+
+}  // namespace rock::internal
@@ -0,0 +1,185 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+/**
+ * The analyses reported to the callbacks, by request
+ */
+struct Results
+{
+    auto callback()
+    {
+        return [this](rock::AnalysisService::RequestId id, rock::PositionAnalysis const& analysis) {
+            auto const lock = std::lock_guard{mutex};
+            ++counts[id];
+            analyses[id] = analysis;
+        };
+    }
+
+    std::mutex mutex{};
+    std::map<rock::AnalysisService::RequestId, int> counts{};
+    std::map<rock::AnalysisService::RequestId, rock::PositionAnalysis> analyses{};
+};
+
+}  // namespace
+
+TEST_CASE("rock::AnalysisService")
+{
+    auto executor = rock::Executor{rock::ExecutorConfig{3}};
+    auto service = rock::AnalysisService{executor};
+    auto results = Results{};
+
+    auto limits = rock::SearchLimits{};
+    limits.depth = 4;
+
+    auto positions = std::map<rock::AnalysisService::RequestId, rock::Position>{};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        for (auto const player : {rock::Player::White, rock::Player::Black})
+        {
+            auto const position = rock::Position{board, player};
+            positions.emplace(service.submit(position, limits, results.callback()), position);
+        }
+    }
+    service.wait();
+    CHECK(service.num_pending() == 0);
+
+    // Each analysis is reported exactly once
+    REQUIRE(results.counts.size() == positions.size());
+    for (auto const& [id, position] : positions)
+    {
+        CHECK(results.counts[id] == 1);
+        auto const& analysis = results.analyses[id];
+        REQUIRE(analysis.best_move.has_value());
+        CHECK(rock::is_move_legal(*analysis.best_move, position));
+        CHECK(analysis.nodes > 0);
+        CHECK_FALSE(service.cancel(id));
+    }
+}
+
+TEST_CASE("rock::AnalysisService_limits")
+{
+    auto executor = rock::Executor{rock::ExecutorConfig{2}};
+    auto service = rock::AnalysisService{executor};
+    auto results = Results{};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    // The Monte-Carlo engine is used when asked for
+    auto limits = rock::SearchLimits{};
+    limits.engine = rock::SearchEngine::MonteCarlo;
+    limits.nodes = 2000;
+    auto const monte_carlo = service.submit(position, limits, results.callback());
+    service.wait();
+    REQUIRE(results.analyses[monte_carlo].best_move.has_value());
+    CHECK(rock::is_move_legal(*results.analyses[monte_carlo].best_move, position));
+    CHECK(results.analyses[monte_carlo].nodes == 2000);
+
+    // The symmetry of the table cannot differ between analyses
+    limits = rock::SearchLimits{};
+    limits.depth = 2;
+    limits.symmetric_transpositions = true;
+    CHECK_THROWS_AS(service.submit(position, limits, results.callback()), std::invalid_argument);
+    CHECK(service.num_pending() == 0);
+
+    auto symmetric_service = rock::AnalysisService{executor, rock::AnalysisServiceConfig{1, true}};
+    auto const symmetric = symmetric_service.submit(position, limits, results.callback());
+    symmetric_service.wait();
+    CHECK(results.analyses[symmetric].best_move.has_value());
+}
+
+TEST_CASE("rock::AnalysisService_cancel")
+{
+    auto executor = rock::Executor{rock::ExecutorConfig{1}};
+    auto service = rock::AnalysisService{executor};
+    auto results = Results{};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    // Without limits, the analyses only end when cancelled, and the second one waits for the
+    // thread that the first one is using
+    auto const running = service.submit(position, rock::SearchLimits{}, results.callback());
+    auto const queued = service.submit(position, rock::SearchLimits{}, results.callback());
+    std::this_thread::sleep_for(ch::milliseconds{50});
+    CHECK(service.num_pending() == 2);
+
+    CHECK(service.cancel(queued));
+    auto const t_cancel = Clock::now();
+    CHECK(service.cancel(running));
+    service.wait();
+    auto const t_done = Clock::now();
+
+    CHECK(results.analyses[running].best_move.has_value());
+    CHECK_FALSE(results.analyses[queued].best_move.has_value());
+    CHECK(t_done - t_cancel < ch::milliseconds{100});
+
+    // Analyses are queued even when the queue is full, so that they can still be cancelled
+    auto unqueued_executor = rock::Executor{rock::ExecutorConfig{1, false, 0}};
+    auto unqueued = rock::AnalysisService{unqueued_executor};
+    auto const unlimited = unqueued.submit(position, rock::SearchLimits{}, results.callback());
+    CHECK(unqueued.cancel(unlimited));
+    unqueued.wait();
+
+    // Destroying the service cancels its analyses
+    auto other = std::make_unique<rock::AnalysisService>(executor);
+    other->submit(position, rock::SearchLimits{}, results.callback());
+    std::this_thread::sleep_for(ch::milliseconds{10});
+    auto const t_destroy = Clock::now();
+    other.reset();
+    CHECK(Clock::now() - t_destroy < ch::milliseconds{100});
+}
+
+TEST_CASE("rock::AnalysisService_shared_table_speed")
+{
+    constexpr auto depth = 8;
+
+    auto executor = rock::Executor{rock::ExecutorConfig{2}};
+    auto results = Results{};
+    auto limits = rock::SearchLimits{};
+    limits.depth = depth;
+
+    auto shared_nodes = rock::u64{};
+    auto own_nodes = rock::u64{};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+
+        // A client analyzes the position, and then another one the position after its best move,
+        // as when two clients follow the same game
+        auto service = rock::AnalysisService{executor};
+        auto const first = service.submit(position, limits, results.callback());
+        service.wait();
+
+        auto const& pv = results.analyses[first].principal_variation;
+        REQUIRE_FALSE(pv.empty());
+        auto const next_position = rock::apply_move(pv[0], position);
+
+        auto const second = service.submit(next_position, limits, results.callback());
+        service.wait();
+        CHECK(results.analyses[second].best_move.has_value());
+        shared_nodes += results.analyses[second].nodes;
+
+        // The same analysis without the first one to build on
+        own_nodes += rock::analyze_position(next_position, limits).nodes;
+    }
+
+    auto const num_boards = std::size(random_game_boards_10_moves);
+    fmt::print(
+        "rock::AnalysisService: analysis to depth {} of the position after the last one's best "
+        "move [with the shared table = {} nodes] [on its own = {} nodes]\n",
+        depth,
+        shared_nodes / num_boards,
+        own_nodes / num_boards);
+    CHECK(shared_nodes < own_nodes);
+}
@@ -0,0 +1,103 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+auto example_positions() -> std::vector<rock::Position>
+{
+    auto positions = std::vector<rock::Position>{};
+    for (auto const& board : random_game_boards_5_moves)
+        positions.push_back(rock::Position{board, rock::Player::White});
+    for (auto const& board : random_game_boards_10_moves)
+        positions.push_back(rock::Position{board, rock::Player::White});
+    for (auto const& board : assorted_random_game_boards)
+        positions.push_back(rock::Position{board, rock::Player::White});
+    return positions;
+}
+
+}  // namespace
+
+TEST_CASE("rock::analyze_positions")
+{
+    auto const positions = example_positions();
+    auto limits = rock::SearchLimits{};
+    limits.depth = 4;
+
+    auto expected = std::vector<rock::PositionAnalysis>{};
+    for (auto const& position : positions)
+        expected.push_back(rock::analyze_position(position, limits));
+
+    for (auto const num_threads : {1u, 3u, 100u})
+    {
+        auto executor = rock::Executor{rock::ExecutorConfig{num_threads}};
+        auto const result = rock::analyze_positions(positions, limits, executor);
+        REQUIRE(result.size() == expected.size());
+        for (auto i = std::size_t{}; i < result.size(); ++i)
+        {
+            CHECK(result[i].best_move == expected[i].best_move);
+            CHECK(result[i].score == expected[i].score);
+            CHECK(result[i].principal_variation == expected[i].principal_variation);
+            CHECK(result[i].nodes == expected[i].nodes);
+        }
+    }
+
+    auto executor = rock::Executor{rock::ExecutorConfig{3}};
+
+    // Each position is reported exactly once
+    auto counts = std::vector<int>(positions.size());
+    rock::analyze_positions(
+        positions.data(), positions.size(), limits, executor, [&](std::size_t index, auto const&) {
+            ++counts[index];
+        });
+    CHECK(std::all_of(counts.begin(), counts.end(), [](int c) { return c == 1; }));
+
+    // An exception from the callback stops the batch
+    auto num_reported = 0;
+    auto const throw_on_third = [&](std::size_t, auto const&) {
+        if (++num_reported == 3)
+            throw std::runtime_error{"stop"};
+    };
+    CHECK_THROWS_AS(
+        rock::analyze_positions(
+            positions.data(), positions.size(), limits, executor, throw_on_third),
+        std::runtime_error);
+    CHECK(num_reported == 3);
+}
+
+TEST_CASE("rock::analyze_positions_speed")
+{
+    auto const positions = example_positions();
+    auto limits = rock::SearchLimits{};
+    limits.depth = 5;
+
+    auto const num_threads = std::size_t{std::max(4u, std::thread::hardware_concurrency())};
+    for (auto const threads : {std::size_t{1}, num_threads})
+    {
+        auto executor = rock::Executor{rock::ExecutorConfig{threads}};
+
+        // Once to allocate each thread's table, and once to time
+        rock::analyze_positions(positions, limits, executor);
+
+        auto const t_begin = Clock::now();
+        auto const result = rock::analyze_positions(positions, limits, executor);
+        auto const duration = ch::duration<double>(Clock::now() - t_begin).count();
+
+        fmt::print(
+            "rock::analyze_positions (depth = 5, threads = {}) [positions = {}] "
+            "[{:.1f} positions/s]\n",
+            threads,
+            result.size(),
+            static_cast<double>(result.size()) / duration);
+    }
+}
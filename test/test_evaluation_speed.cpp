@@ -0,0 +1,75 @@
+#include "example_boards.h"
+#include "internal/evaluation_weights.h"
+#include "internal/search.h"
+#include "internal/tuned_evaluation_weights.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+
+namespace ch = std::chrono;
+using Clock = ch::high_resolution_clock;
+
+namespace
+{
+
+template <typename Weights>
+auto time_search(char const* name, int depth) -> rock::ScoreType
+{
+    auto table = rock::internal::TranspositionTable(18);
+    auto checksum = rock::ScoreType{};
+
+    auto const t_begin = Clock::now();
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        table.reset();
+        for (auto d = 1; d <= depth; ++d)
+        {
+            auto searcher = rock::internal::BasicSearcher<Weights>(d, &table);
+            checksum += searcher.search(position.friends(), position.enemies()).score;
+        }
+    }
+    auto const t_end = Clock::now();
+
+    fmt::print(
+        "{} search (depth = {}) [duration = {:4}ms]\n",
+        name,
+        depth,
+        ch::duration_cast<ch::milliseconds>(t_end - t_begin).count());
+
+    return checksum;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::parse_evaluation_weights")
+{
+    auto const& tuned = rock::internal::tuned_evaluation_weights;
+
+    auto const round_trip = rock::internal::parse_evaluation_weights(
+        rock::internal::format_evaluation_weights(tuned), {});
+    REQUIRE(round_trip.has_value());
+    CHECK(rock::internal::to_vector(*round_trip) == rock::internal::to_vector(tuned));
+
+    auto const partial = rock::internal::parse_evaluation_weights("tempo 7\n", tuned);
+    REQUIRE(partial.has_value());
+    CHECK(partial->tempo == 7);
+    CHECK(partial->centre_circles[0] == tuned.centre_circles[0]);
+
+    CHECK_FALSE(rock::internal::parse_evaluation_weights("unknown 1\n", tuned).has_value());
+    CHECK_FALSE(rock::internal::parse_evaluation_weights("tempo x\n", tuned).has_value());
+}
+
+TEST_CASE("rock::evaluation_weights_speed")
+{
+    // With the runtime weights equal to the compiled ones, the searches are identical, and only
+    // differ in whether the weights can be constant folded
+    rock::internal::runtime_evaluation_weights = rock::internal::tuned_evaluation_weights;
+
+    auto const compiled =
+        time_search<rock::internal::CompiledEvaluationWeights>("Compiled evaluation weights", 7);
+    auto const runtime =
+        time_search<rock::internal::RuntimeEvaluationWeights>("Runtime evaluation weights ", 7);
+
+    CHECK(compiled == runtime);
+}
@@ -0,0 +1,240 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include "rock/starting_position.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+TEST_CASE("rock::GameAnalyzer_runs_to_max_depth")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto reports = std::atomic<int>{};
+
+    analyzer.set_max_depth(4);
+    analyzer.set_report_callback([&](rock::GameAnalyzer&) { ++reports; });
+    analyzer.analyze_position(rock::starting_position);
+    analyzer.wait_for_analysis();
+
+    CHECK_FALSE(analyzer.is_analysis_ongoing());
+    CHECK(reports == 5);  // Depths 0 to 4
+
+    auto const progress = analyzer.progress();
+    auto const analysis = analyzer.best_analysis_so_far();
+    CHECK(progress.depth == 4);
+    CHECK(progress.nodes > 0);
+    REQUIRE(progress.best_move.has_value());
+    CHECK(progress.best_move == analysis.best_move);
+    CHECK(progress.score == analysis.score);
+    CHECK(rock::is_move_legal(*progress.best_move, rock::starting_position));
+    CHECK_FALSE(analysis.principal_variation.empty());
+}
+
+TEST_CASE("rock::GameAnalyzer_stops_from_another_thread")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    auto const t_start = Clock::now();
+    analyzer.analyze_position(position);
+    auto const t_started = Clock::now();
+
+    CHECK(analyzer.is_analysis_ongoing());
+
+    // Poll until the search is a few depths in, as a UI thread would
+    while (analyzer.progress().depth < 5)
+        std::this_thread::sleep_for(ch::milliseconds{1});
+
+    auto const t_stop = Clock::now();
+    analyzer.stop_analysis();
+    analyzer.wait_for_analysis();
+    auto const t_stopped = Clock::now();
+
+    CHECK_FALSE(analyzer.is_analysis_ongoing());
+    auto const analysis = analyzer.best_analysis_so_far();
+    REQUIRE(analysis.best_move.has_value());
+    CHECK(rock::is_move_legal(*analysis.best_move, position));
+
+    fmt::print(
+        "rock::GameAnalyzer: analyze_position returned in {}us, stopped in {}us "
+        "(after {}ms of search)\n",
+        ch::duration_cast<ch::microseconds>(t_started - t_start).count(),
+        ch::duration_cast<ch::microseconds>(t_stopped - t_stop).count(),
+        ch::duration_cast<ch::milliseconds>(t_stop - t_started).count());
+
+    // Starting a new analysis replaces the old one
+    analyzer.set_max_depth(3);
+    analyzer.analyze_position(rock::starting_position);
+    analyzer.analyze_position(position);
+    analyzer.wait_for_analysis();
+    CHECK(analyzer.progress().depth == 3);
+    CHECK(analyzer.best_analysis_so_far().best_move.has_value());
+}
+
+TEST_CASE("rock::GameAnalyzer_finished_callback")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+    auto finished = std::atomic<int>{};
+    auto has_move = std::atomic<bool>{};
+
+    analyzer.set_finished_callback([&](rock::GameAnalyzer& a) {
+        has_move = a.best_analysis_so_far().best_move.has_value();
+        ++finished;
+    });
+
+    // Reaching the limits
+    auto limits = rock::SearchLimits{};
+    limits.depth = 3;
+    analyzer.analyze_position(position, limits);
+    analyzer.wait_for_analysis();
+    CHECK(finished == 1);
+    CHECK(has_move);
+
+    // Being stopped
+    analyzer.analyze_position(position);
+    while (analyzer.progress().depth < 2)
+        std::this_thread::sleep_for(ch::milliseconds{1});
+    analyzer.stop_analysis();
+    analyzer.wait_for_analysis();
+    CHECK(finished == 2);
+    CHECK(has_move);
+
+    // Being replaced by another analysis
+    analyzer.analyze_position(position);
+    analyzer.analyze_position(position, limits);
+    analyzer.wait_for_analysis();
+    CHECK(finished == 4);
+}
+
+namespace
+{
+
+// Analyze a position, and return the position after the recommended move, ready for pondering
+auto play_recommended_move(rock::GameAnalyzer& analyzer, rock::Position const& position)
+    -> rock::Position
+{
+    auto limits = rock::SearchLimits{};
+    limits.depth = 5;
+    analyzer.analyze_position(position, limits);
+    analyzer.wait_for_analysis();
+
+    auto const pv = analyzer.best_analysis_so_far().principal_variation;
+    REQUIRE(pv.size() >= 2);
+    return rock::apply_move(pv[0], position);
+}
+
+}  // namespace
+
+TEST_CASE("rock::GameAnalyzer_ponder_hit")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto const position = rock::Position{assorted_random_game_boards[1], rock::Player::White};
+    auto const after_our_move = play_recommended_move(analyzer, position);
+    auto const expected_reply = analyzer.best_analysis_so_far().principal_variation[1];
+
+    auto limits = rock::SearchLimits{};
+    limits.move_time = ch::milliseconds{50};
+
+    // Only the position after the recommended move can be pondered
+    CHECK_FALSE(analyzer.ponder(position, limits).has_value());
+    CHECK_FALSE(analyzer.is_analysis_ongoing());
+
+    auto const reply = analyzer.ponder(after_our_move, limits);
+    REQUIRE(reply == expected_reply);
+    CHECK(analyzer.is_pondering());
+
+    // The time limit does not apply while pondering
+    std::this_thread::sleep_for(ch::milliseconds{100});
+    CHECK(analyzer.is_analysis_ongoing());
+
+    auto const t_hit = Clock::now();
+    analyzer.ponder_hit();
+    CHECK_FALSE(analyzer.is_pondering());
+    analyzer.wait_for_analysis();
+    fmt::print(
+        "rock::GameAnalyzer: analysis ended {}ms after the ponder hit\n",
+        ch::duration_cast<ch::milliseconds>(Clock::now() - t_hit).count());
+
+    auto const pondered_position = rock::apply_move(*reply, after_our_move);
+    auto const analysis = analyzer.best_analysis_so_far();
+    REQUIRE(analysis.best_move.has_value());
+    CHECK(rock::is_move_legal(*analysis.best_move, pondered_position));
+}
+
+TEST_CASE("rock::GameAnalyzer_ponder_miss")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto const position = rock::Position{assorted_random_game_boards[1], rock::Player::White};
+    auto const after_our_move = play_recommended_move(analyzer, position);
+
+    auto limits = rock::SearchLimits{};
+    limits.move_time = ch::milliseconds{50};
+
+    auto const reply = analyzer.ponder(after_our_move, limits);
+    REQUIRE(reply.has_value());
+
+    auto const moves = rock::list_moves(after_our_move);
+    auto const other =
+        *std::find_if(moves.begin(), moves.end(), [&](rock::Move m) { return !(m == *reply); });
+    auto const actual_position = rock::apply_move(other, after_our_move);
+
+    analyzer.analyze_position(actual_position, limits);
+    CHECK_FALSE(analyzer.is_pondering());
+    analyzer.wait_for_analysis();
+
+    auto const analysis = analyzer.best_analysis_so_far();
+    REQUIRE(analysis.best_move.has_value());
+    CHECK(rock::is_move_legal(*analysis.best_move, actual_position));
+}
+
+TEST_CASE("rock::GameAnalyzer_ponder_latency")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto limits = rock::SearchLimits{};
+    limits.depth = 8;
+
+    auto without_pondering = Clock::duration{};
+    auto with_pondering = Clock::duration{};
+    auto num_hits = 0;
+
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+
+        analyzer.analyze_position(position, limits);
+        analyzer.wait_for_analysis();
+        auto const pv = analyzer.best_analysis_so_far().principal_variation;
+        if (pv.size() < 2)
+            continue;
+
+        auto const after_our_move = rock::apply_move(pv[0], position);
+        auto const after_reply = rock::apply_move(pv[1], after_our_move);
+
+        // The opponent thinks for a short while, and then makes the expected reply
+        REQUIRE(analyzer.ponder(after_our_move, limits).has_value());
+        std::this_thread::sleep_for(ch::milliseconds{50});
+        auto const t_hit = Clock::now();
+        analyzer.ponder_hit();
+        analyzer.wait_for_analysis();
+        with_pondering += Clock::now() - t_hit;
+        ++num_hits;
+
+        auto const t_begin = Clock::now();
+        analyzer.analyze_position(after_reply, limits);
+        analyzer.wait_for_analysis();
+        without_pondering += Clock::now() - t_begin;
+    }
+
+    REQUIRE(num_hits > 0);
+    fmt::print(
+        "rock::GameAnalyzer: mean move latency to depth 8 [without pondering = {:.1f}ms] "
+        "[after 50ms of pondering = {:.1f}ms]\n",
+        ch::duration<double, std::milli>(without_pondering).count() / num_hits,
+        ch::duration<double, std::milli>(with_pondering).count() / num_hits);
+}
@@ -0,0 +1,342 @@
+#include "example_boards.h"
+#include "internal/game_record.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/parse.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+/**
+ * Play the game out from the position with a shallow search, returning its moves and outcome
+ */
+auto play_out(rock::Position position, rock::SearchLimits const& limits)
+    -> rock::internal::GameRecord
+{
+    constexpr auto max_game_length = 200;
+
+    auto record = rock::internal::GameRecord{position, {}, rock::GameOutcome::Draw};
+    for (auto i = 0; i < max_game_length; ++i)
+    {
+        auto const outcome = rock::get_game_outcome(position);
+        if (outcome != rock::GameOutcome::Ongoing)
+        {
+            record.outcome = outcome;
+            break;
+        }
+
+        auto const analysis = rock::analyze_position(position, limits);
+        REQUIRE(analysis.best_move.has_value());
+        auto const move = *analysis.best_move;
+        record.moves.push_back(move);
+        position = rock::apply_move(move, position);
+    }
+    return record;
+}
+
+auto is_same_position(rock::Position const& a, rock::Position const& b) -> bool
+{
+    return a.board()[rock::Player::White] == b.board()[rock::Player::White] &&
+        a.board()[rock::Player::Black] == b.board()[rock::Player::Black] &&
+        a.player_to_move() == b.player_to_move();
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::GameRecordWriter")
+{
+    constexpr auto path = "rock_test_games.bin";
+
+    auto limits = rock::SearchLimits{};
+    limits.depth = 2;
+
+    auto games = std::vector<rock::internal::GameRecord>{};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        games.push_back(play_out(rock::Position{board, rock::Player::White}, limits));
+        games.push_back(play_out(rock::Position{board, rock::Player::Black}, limits));
+    }
+
+    {
+        auto writer = rock::internal::GameRecordWriter{path};
+        for (auto const& game : games)
+            writer.write(game);
+        CHECK(writer.num_games() == games.size());
+    }
+
+    auto const read = rock::internal::read_game_records(path);
+    REQUIRE(read.has_value());
+    REQUIRE(read->size() == games.size());
+    for (auto i = std::size_t{}; i < games.size(); ++i)
+    {
+        CHECK((*read)[i].start.board()[rock::Player::White] ==
+              games[i].start.board()[rock::Player::White]);
+        CHECK((*read)[i].start.board()[rock::Player::Black] ==
+              games[i].start.board()[rock::Player::Black]);
+        CHECK((*read)[i].start.player_to_move() == games[i].start.player_to_move());
+        CHECK((*read)[i].moves == games[i].moves);
+        CHECK((*read)[i].outcome == games[i].outcome);
+    }
+
+    // A truncated file is not read
+    {
+        auto file = std::ofstream(path, std::ios::binary | std::ios::app);
+        file.put('x');
+    }
+    CHECK_FALSE(rock::internal::read_game_records(path).has_value());
+    CHECK_FALSE(rock::internal::read_game_records("does_not_exist.bin").has_value());
+
+    std::remove(path);
+}
+
+TEST_CASE("rock::internal::pack_move")
+{
+    for (auto from = 0; from < 64; ++from)
+    {
+        for (auto to = 0; to < 64; ++to)
+        {
+            auto const move = rock::Move{rock::BoardCoordinates{from}, rock::BoardCoordinates{to}};
+            CHECK(rock::internal::pack_move(move) < (1 << 12));
+            CHECK(rock::internal::unpack_move(rock::internal::pack_move(move)) == move);
+        }
+    }
+
+    CHECK(rock::internal::packed_moves_size(0) == 0);
+    CHECK(rock::internal::packed_moves_size(1) == 2);
+    CHECK(rock::internal::packed_moves_size(2) == 3);
+    CHECK(rock::internal::packed_moves_size(3) == 5);
+}
+
+TEST_CASE("rock::internal::read_varint")
+{
+    for (auto const value :
+         {rock::u64{}, rock::u64{127}, rock::u64{128}, rock::u64{300}, ~rock::u64{}})
+    {
+        auto buffer = std::vector<rock::u8>{0xFF};
+        rock::internal::append_varint(buffer, value);
+        CHECK(buffer.size() == 1 + (value < 128 ? 1 : value < 16384 ? 2 : 10));
+
+        auto offset = std::size_t{1};
+        CHECK(rock::internal::read_varint(buffer.data(), buffer.size(), offset) == value);
+        CHECK(offset == buffer.size());
+
+        // Cut short
+        offset = 1;
+        CHECK_FALSE(rock::internal::read_varint(buffer.data(), buffer.size() - 1, offset));
+    }
+
+    // More than 64 bits
+    auto const too_long = std::vector<rock::u8>(11, 0x80);
+    auto offset = std::size_t{};
+    CHECK_FALSE(rock::internal::read_varint(too_long.data(), too_long.size(), offset));
+}
+
+TEST_CASE("rock::internal::PositionRecordFile")
+{
+    constexpr auto path = "rock_test_positions.bin";
+
+    auto records = std::vector<rock::internal::PositionRecord>{};
+    auto outcome = 0;
+    for (auto const& board : assorted_random_game_boards)
+    {
+        for (auto const player : {rock::Player::White, rock::Player::Black})
+        {
+            records.push_back(rock::internal::PositionRecord{
+                rock::Position{board, player}, static_cast<rock::GameOutcome>(outcome++ % 4)});
+        }
+    }
+
+    {
+        auto writer = rock::internal::PositionRecordWriter{path};
+        for (auto const& record : records)
+            writer.write(record);
+        CHECK(writer.num_positions() == records.size());
+    }
+
+    auto const file = rock::internal::PositionRecordFile::open(path);
+    REQUIRE(file.has_value());
+    REQUIRE(file->size() == records.size());
+
+    auto i = std::size_t{};
+    for (auto const record : *file)
+    {
+        CHECK(is_same_position(record.position, records[i].position));
+        CHECK(record.outcome == records[i].outcome);
+        CHECK(is_same_position((*file)[i].position, records[i].position));
+        ++i;
+    }
+    CHECK(i == records.size());
+
+    // A partial record is not read
+    {
+        auto out = std::ofstream(path, std::ios::binary | std::ios::app);
+        out.put('x');
+    }
+    CHECK_FALSE(rock::internal::PositionRecordFile::open(path).has_value());
+
+    std::remove(path);
+}
+
+TEST_CASE("rock::internal::GameRecordFile")
+{
+    constexpr auto path = "rock_test_game_views.bin";
+
+    auto limits = rock::SearchLimits{};
+    limits.depth = 1;
+
+    auto games = std::vector<rock::internal::GameRecord>{};
+    for (auto const& board : random_game_boards_5_moves)
+        games.push_back(play_out(rock::Position{board, rock::Player::White}, limits));
+
+    // Odd and even numbers of moves, and none at all
+    games.push_back(rock::internal::GameRecord{games[0].start, {}, rock::GameOutcome::Draw});
+    games.push_back(rock::internal::GameRecord{
+        games[0].start, {games[0].moves[0]}, rock::GameOutcome::Ongoing});
+
+    {
+        auto writer = rock::internal::GameRecordWriter{path};
+        for (auto const& game : games)
+            writer.write(game);
+    }
+
+    auto const file = rock::internal::GameRecordFile::open(path);
+    REQUIRE(file.has_value());
+    REQUIRE(file->num_games() == games.size());
+
+    auto i = std::size_t{};
+    for (auto const game : *file)
+    {
+        REQUIRE(i < games.size());
+        CHECK(is_same_position(game.start, games[i].start));
+        CHECK(game.outcome == games[i].outcome);
+        REQUIRE(game.moves.size() == games[i].moves.size());
+
+        auto position = games[i].start;
+        auto j = std::size_t{};
+        for (auto const& game_position : game.positions())
+        {
+            CHECK(is_same_position(game_position, position));
+            CHECK(game.moves[j] == games[i].moves[j]);
+            position = rock::apply_move(games[i].moves[j], position);
+            ++j;
+        }
+        CHECK(j == games[i].moves.size());
+        ++i;
+    }
+
+    std::remove(path);
+}
+
+TEST_CASE("rock::internal::PositionRecordFile_speed")
+{
+    constexpr auto fen_path = "rock_test_positions.txt";
+    constexpr auto binary_path = "rock_test_positions_speed.bin";
+    constexpr auto num_copies = 2000;
+
+    {
+        auto text = std::ofstream(fen_path);
+        auto writer = rock::internal::PositionRecordWriter{binary_path};
+        for (auto i = 0; i < num_copies; ++i)
+        {
+            for (auto const& board : assorted_random_game_boards)
+            {
+                text << rock::format_as_fen(board) << " w\n";
+                writer.write(rock::internal::PositionRecord{
+                    rock::Position{board, rock::Player::White}, rock::GameOutcome::Ongoing});
+            }
+        }
+    }
+
+    // Reading each file the usual way, and adding up the boards so that nothing is skipped
+    auto const t_text = Clock::now();
+    auto text_sum = rock::u64{};
+    auto num_text = std::size_t{};
+    {
+        auto text = std::ifstream(fen_path);
+        auto line = std::string{};
+        while (std::getline(text, line))
+        {
+            auto stream = std::istringstream{line};
+            auto fen = std::string{};
+            auto side = std::string{};
+            stream >> fen >> side;
+            auto const position =
+                rock::Position{*rock::parse_fen_to_board(fen), *rock::parse_player(side)};
+            text_sum += position.board()[rock::Player::White];
+            ++num_text;
+        }
+    }
+
+    auto const t_binary = Clock::now();
+    auto binary_sum = rock::u64{};
+    auto num_binary = std::size_t{};
+    {
+        auto const file = rock::internal::PositionRecordFile::open(binary_path);
+        REQUIRE(file.has_value());
+        for (auto const record : *file)
+        {
+            binary_sum += record.position.board()[rock::Player::White];
+            ++num_binary;
+        }
+    }
+    auto const t_end = Clock::now();
+
+    CHECK(num_text == num_binary);
+    CHECK(text_sum == binary_sum);
+
+    auto const text_seconds = ch::duration<double>(t_binary - t_text).count();
+    auto const binary_seconds = ch::duration<double>(t_end - t_binary).count();
+    fmt::print(
+        "Reading {} positions: [FEN text = {:.0f} positions/s] [binary records = {:.0f} "
+        "positions/s]\n",
+        num_binary,
+        num_text / text_seconds,
+        num_binary / binary_seconds);
+
+    std::remove(fen_path);
+    std::remove(binary_path);
+}
+
+TEST_CASE("rock::analyze_position_keep_transpositions_speed")
+{
+    // Self-play at a shallow depth, where clearing the table before each move costs more than the
+    // search itself
+    constexpr auto depth = 3;
+    constexpr auto num_boards = 4;
+
+    for (auto const keep_transpositions : {false, true})
+    {
+        auto limits = rock::SearchLimits{};
+        limits.depth = depth;
+        limits.keep_transpositions = keep_transpositions;
+
+        auto num_moves = std::size_t{};
+        auto const t_begin = Clock::now();
+        for (auto i = 0; i < num_boards; ++i)
+        {
+            auto const& board = random_game_boards_5_moves[i];
+            auto const record = play_out(rock::Position{board, rock::Player::White}, limits);
+            num_moves += record.moves.size();
+            CHECK(record.outcome != rock::GameOutcome::Ongoing);
+        }
+        auto const duration = ch::duration<double>(Clock::now() - t_begin).count();
+
+        fmt::print(
+            "Self-play at depth {} ({} table): {} moves, {:.0f} moves per second\n",
+            depth,
+            keep_transpositions ? "kept" : "cleared",
+            num_moves,
+            num_moves / duration);
+    }
+}
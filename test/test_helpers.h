@@ -0,0 +1,23 @@
+#pragma once
+
+#include "rock/algorithms.h"
+#include "rock/types.h"
+#include <doctest/doctest.h>
+
+/**
+ * Check that the analysis recommends a move, and that its principal variation starts with the
+ * move and is legal from the position
+ */
+inline auto check_analysis(rock::PositionAnalysis const& analysis, rock::Position position)
+    -> void
+{
+    REQUIRE(analysis.best_move.has_value());
+    REQUIRE_FALSE(analysis.principal_variation.empty());
+    CHECK(analysis.principal_variation.front() == *analysis.best_move);
+
+    for (auto const move : analysis.principal_variation)
+    {
+        REQUIRE(rock::is_move_legal(move, position));
+        position = rock::apply_move(move, position);
+    }
+}
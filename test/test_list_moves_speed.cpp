@@ -0,0 +1,227 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include "rock/starting_position.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+namespace ch = std::chrono;
+using Clock = ch::high_resolution_clock;
+
+namespace
+{
+
+/**
+ * Counts the heap allocations made by the current thread while it exists, so that the
+ * allocation-free API can be checked against the std::vector one. Allocations on other threads,
+ * and outside any counter, are not counted.
+ */
+struct AllocationCounter
+{
+    AllocationCounter() : previous_{current} { current = this; }
+    ~AllocationCounter() { current = previous_; }
+
+    AllocationCounter(AllocationCounter const&) = delete;
+    auto operator=(AllocationCounter const&) -> AllocationCounter& = delete;
+
+    auto count() const -> std::size_t { return count_; }
+
+    static auto on_allocation() -> void
+    {
+        if (current)
+            ++current->count_;
+    }
+
+private:
+    static thread_local AllocationCounter* current;
+
+    AllocationCounter* previous_;
+    std::size_t count_{};
+};
+
+thread_local AllocationCounter* AllocationCounter::current = nullptr;
+
+auto allocate(std::size_t size) -> void*
+{
+    AllocationCounter::on_allocation();
+    size = std::max(size, std::size_t{1});
+    while (true)
+    {
+        if (auto* ptr = std::malloc(size))
+            return ptr;
+        auto const handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc{};
+        handler();
+    }
+}
+
+auto allocate(std::size_t size, std::align_val_t alignment) -> void*
+{
+    AllocationCounter::on_allocation();
+    // `aligned_alloc` needs the size to be a multiple of the alignment
+    auto const align = static_cast<std::size_t>(alignment);
+    size = (std::max(size, std::size_t{1}) + align - 1) / align * align;
+    while (true)
+    {
+        if (auto* ptr = std::aligned_alloc(align, size))
+            return ptr;
+        auto const handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc{};
+        handler();
+    }
+}
+
+}  // namespace
+
+// Replacing the allocation functions is the only way to see the allocations made inside the
+// library. The plain and aligned forms, and their sized deletes, are all replaced. The array and
+// nothrow forms call them by default. They all allocate the way the standard ones do, so the rest
+// of the tests are not affected.
+auto operator new(std::size_t size) -> void*
+{
+    return allocate(size);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void*
+{
+    return allocate(size, alignment);
+}
+
+auto operator delete(void* ptr) noexcept -> void
+{
+    std::free(ptr);
+}
+
+auto operator delete(void* ptr, std::size_t) noexcept -> void
+{
+    std::free(ptr);
+}
+
+auto operator delete(void* ptr, std::align_val_t) noexcept -> void
+{
+    std::free(ptr);
+}
+
+auto operator delete(void* ptr, std::size_t, std::align_val_t) noexcept -> void
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+template <typename F>
+auto measure(char const* name, F&& f) -> void
+{
+    constexpr auto repetitions = 2000;
+
+    auto const counter = AllocationCounter{};
+    auto const t_begin = Clock::now();
+
+    auto checksum = std::size_t{};
+    for (auto i = 0; i < repetitions; ++i)
+        for (auto const& board : assorted_random_game_boards)
+            checksum += f(rock::Position{board, rock::Player::White});
+
+    auto const t_end = Clock::now();
+    auto const allocations = counter.count();
+
+    auto const calls = repetitions * std::size(assorted_random_game_boards);
+    auto const ns = ch::duration_cast<ch::nanoseconds>(t_end - t_begin).count();
+
+    fmt::print(
+        "{} [calls = {}] [allocations = {}] [latency = {:.1f}ns/call] [checksum = {}]\n",
+        name,
+        calls,
+        allocations,
+        static_cast<double>(ns) / static_cast<double>(calls),
+        checksum);
+}
+
+}  // namespace
+
+TEST_CASE("rock::list_moves_fixed_capacity")
+{
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+
+        auto const expected = rock::list_moves(position);
+        auto moves = rock::MoveList{};
+        rock::list_moves(position, &moves);
+
+        CHECK(std::equal(moves.begin(), moves.end(), expected.begin(), expected.end()));
+        CHECK(moves.size() == rock::count_moves(position));
+
+        for (auto const move : moves)
+        {
+            auto const expected_destinations = rock::list_legal_destinations(move.from, position);
+            auto destinations = rock::DestinationList{};
+            rock::list_legal_destinations(move.from, position, &destinations);
+
+            CHECK(std::equal(
+                destinations.begin(),
+                destinations.end(),
+                expected_destinations.begin(),
+                expected_destinations.end()));
+        }
+    }
+
+    auto destinations = rock::DestinationList{};
+    rock::list_legal_destinations({0, 0}, rock::starting_position, &destinations);
+    CHECK(destinations.empty());
+}
+
+TEST_CASE("rock::list_moves_speed")
+{
+    measure("rock::list_moves(position) -> std::vector", [](rock::Position const& position) {
+        return rock::list_moves(position).size();
+    });
+
+    measure("rock::list_moves(position, MoveList*)", [](rock::Position const& position) {
+        auto moves = rock::MoveList{};
+        rock::list_moves(position, &moves);
+        return moves.size();
+    });
+
+    measure(
+        "rock::list_legal_destinations(from, position) -> std::vector",
+        [](rock::Position const& position) {
+            auto count = std::size_t{};
+            for (auto pieces = position.friends(); pieces;)
+                count += rock::list_legal_destinations(pieces.extract_one().coordinates(), position)
+                             .size();
+            return count;
+        });
+
+    measure(
+        "rock::list_legal_destinations(from, position, DestinationList*)",
+        [](rock::Position const& position) {
+            auto count = std::size_t{};
+            auto destinations = rock::DestinationList{};
+            for (auto pieces = position.friends(); pieces;)
+            {
+                rock::list_legal_destinations(
+                    pieces.extract_one().coordinates(), position, &destinations);
+                count += destinations.size();
+            }
+            return count;
+        });
+
+    auto const counter = AllocationCounter{};
+    auto moves = rock::MoveList{};
+    auto destinations = rock::DestinationList{};
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        rock::list_moves(position, &moves);
+        for (auto const move : moves)
+            rock::list_legal_destinations(move.from, position, &destinations);
+    }
+    CHECK(counter.count() == 0);
+}
@@ -0,0 +1,84 @@
+#include "internal/match_statistics.h"
+#include <doctest/doctest.h>
+#include <cmath>
+#include <random>
+
+using rock::internal::MatchResults;
+using rock::internal::SprtDecision;
+using rock::internal::SprtSettings;
+
+TEST_CASE("rock::internal::estimate_elo")
+{
+    CHECK_FALSE(rock::internal::estimate_elo(MatchResults{}).has_value());
+
+    auto estimate = rock::internal::estimate_elo(MatchResults{100, 100, 100});
+    REQUIRE(estimate.has_value());
+    CHECK(std::abs(estimate->elo) < 1e-9);
+    CHECK(estimate->error > 0.0);
+
+    // A score of 75% is 191 Elo
+    estimate = rock::internal::estimate_elo(MatchResults{500, 500, 0});
+    REQUIRE(estimate.has_value());
+    CHECK(std::abs(estimate->elo - 190.85) < 0.01);
+
+    // The interval narrows with the number of games
+    auto const few = rock::internal::estimate_elo(MatchResults{60, 20, 40});
+    auto const many = rock::internal::estimate_elo(MatchResults{600, 200, 400});
+    CHECK(std::abs(few->elo - many->elo) < 1e-9);
+    CHECK(many->error < few->error / 3.0);
+
+    estimate = rock::internal::estimate_elo(MatchResults{10, 0, 0});
+    CHECK(std::isinf(estimate->elo));
+    CHECK(estimate->elo > 0.0);
+    CHECK(std::isinf(estimate->error));
+}
+
+TEST_CASE("rock::internal::sprt_decision")
+{
+    auto const settings = SprtSettings{0.0, 10.0, 0.05, 0.05};
+    CHECK(std::abs(settings.lower_bound() + 2.944) < 0.001);
+    CHECK(std::abs(settings.upper_bound() - 2.944) < 0.001);
+
+    CHECK(rock::internal::sprt_log_likelihood_ratio(MatchResults{}, settings) == 0.0);
+    CHECK(rock::internal::sprt_decision(MatchResults{}, settings) == SprtDecision::Continue);
+    CHECK(rock::internal::sprt_decision(MatchResults{1000, 0, 0}, settings) ==
+          SprtDecision::AcceptElo1);
+    CHECK(rock::internal::sprt_decision(MatchResults{0, 0, 1000}, settings) ==
+          SprtDecision::AcceptElo0);
+
+    // Simulated matches between engines of a known difference in strength stop early with the
+    // right decision almost every time
+    constexpr auto num_matches = 100;
+    constexpr auto draw_ratio = 0.4;
+    constexpr auto max_games = 200'000;
+
+    auto rng = std::mt19937_64{1};
+    for (auto const elo : {0.0, 10.0})
+    {
+        auto const score = 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+        auto const win_ratio = score - draw_ratio / 2.0;
+        auto dist = std::uniform_real_distribution<double>{};
+
+        auto num_correct = 0;
+        for (auto match = 0; match < num_matches; ++match)
+        {
+            auto results = MatchResults{};
+            auto decision = SprtDecision::Continue;
+            while (decision == SprtDecision::Continue && results.num_games() < max_games)
+            {
+                auto const x = dist(rng);
+                if (x < win_ratio)
+                    ++results.wins;
+                else if (x < win_ratio + draw_ratio)
+                    ++results.draws;
+                else
+                    ++results.losses;
+                decision = rock::internal::sprt_decision(results, settings);
+            }
+
+            auto const expected = elo == 0.0 ? SprtDecision::AcceptElo0 : SprtDecision::AcceptElo1;
+            num_correct += decision == expected;
+        }
+        CHECK(num_correct >= 85);
+    }
+}
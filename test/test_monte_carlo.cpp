@@ -0,0 +1,275 @@
+#include "example_boards.h"
+#include "internal/monte_carlo.h"
+#include "internal/thread_pool.h"
+#include "rock/algorithms.h"
+#include "rock/starting_position.h"
+#include "test_helpers.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+auto monte_carlo_limits(rock::u64 iterations)
+{
+    auto limits = rock::SearchLimits{};
+    limits.engine = rock::SearchEngine::MonteCarlo;
+    limits.nodes = iterations;
+    return limits;
+}
+
+/**
+ * Positions where the player to move can win at once, from games played out by a shallow search
+ */
+auto positions_with_winning_moves() -> std::vector<rock::Position>
+{
+    constexpr auto max_game_length = 200;
+
+    auto positions = std::vector<rock::Position>{};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto position = rock::Position{board, rock::Player::White};
+        auto previous = position;
+        for (auto i = 0; i < max_game_length &&
+             rock::get_game_outcome(position) == rock::GameOutcome::Ongoing;
+             ++i)
+        {
+            previous = position;
+            position = rock::apply_move(*rock::analyze_position(position, 2).best_move, position);
+        }
+
+        auto const outcome = rock::get_game_outcome(position);
+        auto const winner = previous.player_to_move() == rock::Player::White
+            ? rock::GameOutcome::WhiteWins
+            : rock::GameOutcome::BlackWins;
+        if (outcome == winner)
+            positions.push_back(previous);
+    }
+    return positions;
+}
+
+/**
+ * Play a game from the position, with one player using each engine, and return the outcome
+ */
+auto play_game(
+    rock::Position position, rock::Player monte_carlo_player, rock::u64 iterations, int depth)
+    -> rock::GameOutcome
+{
+    constexpr auto max_game_length = 200;
+
+    for (auto i = 0; i < max_game_length; ++i)
+    {
+        auto const outcome = rock::get_game_outcome(position);
+        if (outcome != rock::GameOutcome::Ongoing)
+            return outcome;
+
+        auto const analysis = position.player_to_move() == monte_carlo_player
+            ? rock::analyze_position(position, monte_carlo_limits(iterations))
+            : rock::analyze_position(position, depth);
+        position = rock::apply_move(*analysis.best_move, position);
+    }
+    return rock::GameOutcome::Draw;
+}
+
+}  // namespace
+
+TEST_CASE("rock::analyze_position_with_monte_carlo")
+{
+    constexpr auto iterations = rock::u64{3000};
+
+    auto const& start = rock::starting_position;
+    auto analysis = rock::analyze_position(start, monte_carlo_limits(iterations));
+    check_analysis(analysis, start);
+    CHECK(analysis.nodes == iterations);
+
+    for (auto const& board : random_game_boards_5_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        check_analysis(rock::analyze_position(position, monte_carlo_limits(iterations)), position);
+    }
+
+    // Random playouts instead of evaluating the leaves
+    auto limits = monte_carlo_limits(iterations);
+    limits.playout_plies = 4;
+    check_analysis(rock::analyze_position(start, limits), start);
+
+    // A time limit alone
+    limits = rock::SearchLimits{};
+    limits.engine = rock::SearchEngine::MonteCarlo;
+    limits.move_time = ch::milliseconds{20};
+    auto const t_begin = Clock::now();
+    check_analysis(rock::analyze_position(start, limits), start);
+    CHECK(Clock::now() - t_begin < ch::milliseconds{150});
+
+    // The threads of an executor grow the same tree
+    auto executor = rock::Executor{rock::ExecutorConfig{3}};
+    analysis = rock::analyze_position(start, monte_carlo_limits(iterations), executor);
+    check_analysis(analysis, start);
+    CHECK(analysis.nodes >= iterations);
+
+    // With no room in the queue, the helpers are still queued rather than run by the main search
+    auto unqueued_executor = rock::Executor{rock::ExecutorConfig{2, false, 0}};
+    analysis = rock::analyze_position(start, monte_carlo_limits(1000), unqueued_executor);
+    check_analysis(analysis, start);
+
+    // Analyses run by the executor's own threads each keep to their own tree, even when a thread
+    // waiting for its helpers could pick up another analysis
+    auto tasks = rock::internal::TaskGroup{&executor.thread_pool()};
+    for (auto const& board : random_game_boards_5_moves)
+    {
+        tasks.run([&] {
+            auto const position = rock::Position{board, rock::Player::White};
+            check_analysis(
+                rock::analyze_position(position, monte_carlo_limits(iterations), executor),
+                position);
+        });
+    }
+    tasks.wait();
+}
+
+TEST_CASE("rock::analyze_position_with_monte_carlo_in_parallel_node_limit")
+{
+    // The helper threads share the iteration limit with the main search
+    constexpr auto iterations = rock::u64{50'000};
+    auto executor = rock::Executor{rock::ExecutorConfig{3}};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    auto const analysis =
+        rock::analyze_position(position, monte_carlo_limits(iterations), executor);
+    check_analysis(analysis, position);
+    CHECK(analysis.nodes >= iterations);
+    CHECK(analysis.nodes < iterations + iterations / 4);
+}
+
+TEST_CASE("rock::analyze_position_with_monte_carlo_finds_wins")
+{
+    auto const positions = positions_with_winning_moves();
+    REQUIRE_FALSE(positions.empty());
+
+    for (auto const& position : positions)
+    {
+        auto const analysis = rock::analyze_position(position, monte_carlo_limits(2000));
+        REQUIRE(analysis.best_move.has_value());
+
+        auto const is_white = position.player_to_move() == rock::Player::White;
+        auto const next_position = rock::apply_move(*analysis.best_move, position);
+        CHECK(rock::get_game_outcome(next_position) ==
+              (is_white ? rock::GameOutcome::WhiteWins : rock::GameOutcome::BlackWins));
+        CHECK(analysis.score == (is_white ? rock::internal::big : -rock::internal::big));
+    }
+}
+
+TEST_CASE("rock::internal::MonteCarloTree::set_root")
+{
+    auto const& start = rock::starting_position;
+    auto const settings = rock::internal::MonteCarloSettings{};
+    auto tree = rock::internal::MonteCarloTree(1 << 16);
+
+    CHECK_FALSE(tree.set_root(start.friends(), start.enemies(), settings));
+    auto control = rock::internal::SearchControl{};
+    control.node_limit = 5000;
+    control.poll();
+    tree.search(control, 1);
+    CHECK(tree.root_visits() == 5000);
+    CHECK(tree.num_nodes() <= 1 << 16);
+
+    auto const analysis = tree.analysis_for(start, *tree.best_move());
+    check_analysis(analysis, start);
+    REQUIRE(analysis.principal_variation.size() >= 2);
+
+    // Two moves on, the part of the tree below the position is kept
+    auto position = rock::apply_move(analysis.principal_variation[0], start);
+    position = rock::apply_move(analysis.principal_variation[1], position);
+    auto const num_nodes = tree.num_nodes();
+    CHECK(tree.set_root(position.friends(), position.enemies(), settings));
+    CHECK(tree.root_visits() > 0);
+    CHECK(tree.num_nodes() < num_nodes);
+
+    control = rock::internal::SearchControl{};
+    control.node_limit = 1000;
+    control.poll();
+    auto const visits = tree.root_visits();
+    tree.search(control, 2);
+    CHECK(tree.root_visits() == visits + 1000);
+    check_analysis(tree.analysis_for(position, *tree.best_move()), position);
+
+    // Anything else starts again
+    CHECK_FALSE(tree.set_root(start.friends(), start.enemies(), settings));
+    CHECK(tree.root_visits() == 0);
+    CHECK(tree.num_nodes() == 1);
+
+    // As does clearing the tree, even for the same position
+    control = rock::internal::SearchControl{};
+    control.node_limit = 1000;
+    control.poll();
+    tree.search(control, 3);
+    tree.clear();
+    tree.set_root(start.friends(), start.enemies(), settings);
+    CHECK(tree.root_visits() == 0);
+    CHECK(tree.num_nodes() == 1);
+}
+
+TEST_CASE("rock::analyze_position_with_ai_difficulty_level_monte_carlo")
+{
+    auto const& start = rock::starting_position;
+    for (auto level = 0; level <= 10; ++level)
+    {
+        auto const analysis = rock::analyze_position_with_ai_difficulty_level(
+            start, level, rock::SearchEngine::MonteCarlo);
+        check_analysis(analysis, start);
+    }
+}
+
+TEST_CASE("rock::analyze_position_with_monte_carlo_speed")
+{
+    constexpr auto iterations = rock::u64{100'000};
+
+    auto nodes = rock::u64{};
+    auto const t_begin = Clock::now();
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        nodes += rock::analyze_position(position, monte_carlo_limits(iterations)).nodes;
+    }
+    auto const duration = ch::duration<double>(Clock::now() - t_begin).count();
+    fmt::print("Monte-Carlo search: {:.0f} iterations per second\n", nodes / duration);
+
+    // A few games against the alpha-beta search, with each engine playing both sides
+    constexpr auto game_iterations = rock::u64{10'000};
+    constexpr auto depth = 3;
+    constexpr auto num_boards = 3;
+
+    auto wins = 0;
+    auto draws = 0;
+    auto losses = 0;
+    for (auto i = 0; i < num_boards; ++i)
+    {
+        auto const position = rock::Position{random_game_boards_5_moves[i], rock::Player::White};
+        for (auto const player : {rock::Player::White, rock::Player::Black})
+        {
+            auto const outcome = play_game(position, player, game_iterations, depth);
+            auto const winner = player == rock::Player::White ? rock::GameOutcome::WhiteWins
+                                                              : rock::GameOutcome::BlackWins;
+            if (outcome == rock::GameOutcome::Draw)
+                ++draws;
+            else if (outcome == winner)
+                ++wins;
+            else
+                ++losses;
+        }
+    }
+
+    fmt::print(
+        "Monte-Carlo search ({} iterations) against alpha-beta (depth {}): {} wins, {} draws, {} "
+        "losses\n",
+        game_iterations,
+        depth,
+        wins,
+        draws,
+        losses);
+}
@@ -59,3 +59,26 @@ TEST_CASE("rock::count_moves")
         n,
         ch::duration_cast<ch::milliseconds>(t_end - t_begin).count());
 }
+
+TEST_CASE("rock::count_moves_in_parallel")
+{
+    auto const starting_position = rock::Position{rock::starting_board, rock::Player::White};
+    auto const level = 5;
+    auto executor = rock::Executor{};
+
+    for (auto l = 0; l <= 4; ++l)
+        CHECK(rock::count_moves(starting_position, l, executor) ==
+              rock::count_moves(starting_position, l));
+
+    auto const t_begin = Clock::now();
+    auto const n = rock::count_moves(starting_position, level, executor);
+    auto const t_end = Clock::now();
+
+    std::cout << fmt::format(
+        "rock::count_moves(starting_position, {}, executor) = {} [threads = {}] "
+        "[duration = {}ms]\n",
+        level,
+        n,
+        executor.num_threads(),
+        ch::duration_cast<ch::milliseconds>(t_end - t_begin).count());
+}
@@ -0,0 +1,151 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+// The analysis of each move with a separate search, which the MultiPV search replaces
+auto analyze_moves_separately(rock::Position const& position, int depth)
+    -> std::map<rock::Move, rock::PositionAnalysis>
+{
+    auto result = std::map<rock::Move, rock::PositionAnalysis>{};
+    for (auto const move : rock::list_moves(position))
+        result[move] = rock::analyze_position(rock::apply_move(move, position), depth - 1);
+    return result;
+}
+
+auto sorted_scores(std::map<rock::Move, rock::PositionAnalysis> const& moves)
+    -> std::vector<rock::ScoreType>
+{
+    auto scores = std::vector<rock::ScoreType>{};
+    for (auto const& [move, analysis] : moves)
+        scores.push_back(analysis.score);
+    std::sort(scores.begin(), scores.end(), std::greater<>{});
+    return scores;
+}
+
+template <typename F>
+auto time_ms(F&& f) -> double
+{
+    auto const t_begin = Clock::now();
+    for (auto const& board : assorted_random_game_boards)
+        f(rock::Position{board, rock::Player::White});
+    return ch::duration<double, std::milli>(Clock::now() - t_begin).count();
+}
+
+}  // namespace
+
+TEST_CASE("rock::analyze_available_moves")
+{
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        auto const separate = analyze_moves_separately(position, 4);
+
+        // All exact
+        auto const multi_pv = rock::analyze_available_moves(position, 4);
+        REQUIRE(multi_pv.size() == separate.size());
+        for (auto const& [move, analysis] : multi_pv)
+        {
+            REQUIRE(separate.count(move) == 1);
+            CHECK(analysis.score == separate.at(move).score);
+            CHECK(analysis.principal_variation.empty() == !analysis.best_move.has_value());
+            if (analysis.best_move)
+                CHECK(analysis.principal_variation.front() == *analysis.best_move);
+        }
+
+        // Only the best three exact. Scores are from white's point of view, so the bounds on
+        // the other moves are upper bounds.
+        auto const top_3 = rock::analyze_available_moves(position, 4, 3);
+        REQUIRE(top_3.size() == separate.size());
+        for (auto const& [move, analysis] : top_3)
+            CHECK(analysis.score >= separate.at(move).score);
+
+        auto const expected = sorted_scores(separate);
+        auto const actual = sorted_scores(top_3);
+        CHECK(std::equal(expected.begin(), expected.begin() + 3, actual.begin()));
+    }
+}
+
+TEST_CASE("rock::analyze_available_moves_in_parallel")
+{
+    auto executors = std::vector<std::unique_ptr<rock::Executor>>{};
+    for (auto const num_threads : {1u, 2u, 3u, 8u, 100u})
+        executors.push_back(std::make_unique<rock::Executor>(rock::ExecutorConfig{num_threads}));
+
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        auto const serial = rock::analyze_available_moves(position, 4);
+
+        for (auto const& executor : executors)
+        {
+            auto const parallel =
+                rock::analyze_available_moves(position, 4, std::nullopt, executor.get());
+
+            REQUIRE(parallel.size() == serial.size());
+            for (auto const& [move, analysis] : parallel)
+            {
+                REQUIRE(serial.count(move) == 1);
+                CHECK(analysis.score == serial.at(move).score);
+                CHECK(analysis.best_move == serial.at(move).best_move);
+            }
+        }
+
+        // With only some moves exact, the result depends on how the moves are shared out, but
+        // not on the timing of the threads
+        auto const first = rock::analyze_available_moves(position, 4, 2, executors[2].get());
+        auto const second = rock::analyze_available_moves(position, 4, 2, executors[2].get());
+        for (auto const& [move, analysis] : first)
+        {
+            CHECK(analysis.score == second.at(move).score);
+            CHECK(analysis.principal_variation == second.at(move).principal_variation);
+        }
+    }
+}
+
+TEST_CASE("rock::analyze_available_moves_speed")
+{
+    for (auto depth = 2; depth <= 6; depth += 2)
+    {
+        auto const separate = time_ms([&](auto const& p) { analyze_moves_separately(p, depth); });
+        auto const all = time_ms([&](auto const& p) { rock::analyze_available_moves(p, depth); });
+        auto const best =
+            time_ms([&](auto const& p) { rock::analyze_available_moves(p, depth, 1); });
+
+        fmt::print(
+            "Analyze available moves (depth = {}): separate searches = {:7.1f}ms, "
+            "MultiPV = {:7.1f}ms, MultiPV (1 exact) = {:7.1f}ms\n",
+            depth,
+            separate,
+            all,
+            best);
+    }
+
+    auto executor = rock::Executor{rock::ExecutorConfig{4}};
+    for (auto level = 0; level <= 9; ++level)
+    {
+        auto const serial = time_ms(
+            [&](auto const& p) { rock::analyze_position_with_ai_difficulty_level(p, level); });
+        auto const parallel = time_ms([&](auto const& p) {
+            rock::analyze_position_with_ai_difficulty_level(p, level, &executor);
+        });
+
+        fmt::print(
+            "AI difficulty level {}: serial = {:7.1f}ms, {} threads = {:7.1f}ms\n",
+            level,
+            serial,
+            executor.num_threads(),
+            parallel);
+    }
+}
@@ -0,0 +1,181 @@
+#include "example_boards.h"
+#include "internal/move_generation.h"
+#include "internal/nnue.h"
+#include "internal/search.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace ch = std::chrono;
+using Clock = ch::high_resolution_clock;
+
+using rock::internal::EvaluationNetwork;
+
+namespace
+{
+
+auto make_random_network(unsigned seed) -> std::unique_ptr<EvaluationNetwork>
+{
+    auto rng = std::mt19937{seed};
+    auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>{lo, hi}(rng); };
+
+    auto network = std::make_unique<EvaluationNetwork>();
+    for (auto& row : network->input_weights)
+        for (auto& w : row)
+            w = static_cast<std::int16_t>(uniform(-20, 20));
+    for (auto& b : network->input_biases)
+        b = static_cast<std::int16_t>(uniform(-30, 60));
+    for (auto& row : network->hidden_weights)
+        for (auto& w : row)
+            w = static_cast<std::int16_t>(uniform(-127, 127));
+    for (auto& b : network->hidden_biases)
+        b = uniform(-1000, 1000);
+    for (auto& w : network->output_weights)
+        w = static_cast<std::int16_t>(uniform(-127, 127));
+    network->output_bias = uniform(-100, 100);
+    return network;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::evaluate_network")
+{
+    auto const network = make_random_network(1);
+    auto rng = std::mt19937{2};
+
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto friends = board[rock::Player::White];
+        auto enemies = board[rock::Player::Black];
+        auto accumulator = rock::internal::refresh_accumulator(*network, friends, enemies);
+
+        // Play out a random game, checking the incremental accumulator against a full refresh,
+        // and the optimized evaluation against the scalar reference
+        for (auto ply = 0; ply < 40; ++ply)
+        {
+            auto const refreshed = rock::internal::refresh_accumulator(*network, friends, enemies);
+            CHECK(std::equal(
+                std::begin(accumulator.friends_view),
+                std::end(accumulator.friends_view),
+                std::begin(refreshed.friends_view)));
+            CHECK(std::equal(
+                std::begin(accumulator.enemies_view),
+                std::end(accumulator.enemies_view),
+                std::begin(refreshed.enemies_view)));
+
+            CHECK(
+                rock::internal::evaluate_network(*network, accumulator) ==
+                rock::internal::evaluate_network_reference(*network, friends, enemies));
+
+            auto moves = rock::internal::generate_moves(friends, enemies);
+            auto candidates = std::vector<std::pair<rock::u64, rock::u64>>{};
+            rock::internal::for_each_move(
+                moves, [&](rock::u64 from, rock::u64 to) { candidates.emplace_back(from, to); });
+            if (candidates.empty())
+                break;
+
+            auto const [from, to] = candidates[rng() % candidates.size()];
+            auto next = rock::internal::NetworkAccumulator{};
+            rock::internal::apply_move_low_level(
+                from, to, &friends, &enemies, *network, accumulator, &next);
+
+            std::swap(friends, enemies);
+            accumulator = next;
+        }
+    }
+}
+
+TEST_CASE("rock::internal::load_evaluation_network")
+{
+    auto const network = make_random_network(3);
+    auto const path = std::string{"rock_test_network.bin"};
+
+    REQUIRE(rock::internal::save_evaluation_network(*network, path));
+    auto const loaded = rock::internal::load_evaluation_network(path);
+    REQUIRE(loaded != nullptr);
+
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const friends = board[rock::Player::White];
+        auto const enemies = board[rock::Player::Black];
+        CHECK(
+            rock::internal::evaluate_network_reference(*network, friends, enemies) ==
+            rock::internal::evaluate_network_reference(*loaded, friends, enemies));
+    }
+
+    CHECK(rock::load_evaluation_network(path));
+    auto const analysis = rock::analyze_position({assorted_random_game_boards[0], {}}, 4);
+    CHECK(analysis.best_move.has_value());
+    rock::clear_evaluation_network();
+
+    std::remove(path.c_str());
+    CHECK(rock::internal::load_evaluation_network(path) == nullptr);
+    CHECK_FALSE(rock::load_evaluation_network(path));
+}
+
+TEST_CASE("rock::evaluate_network_speed")
+{
+    auto const network = make_random_network(4);
+    constexpr auto repetitions = 20000;
+
+    auto checksum = rock::ScoreType{};
+    auto const t_heuristic_begin = Clock::now();
+    for (auto i = 0; i < repetitions; ++i)
+        for (auto const& board : assorted_random_game_boards)
+            checksum += rock::internal::evaluate_leaf_position(
+                board[rock::Player::White], board[rock::Player::Black]);
+    auto const t_heuristic_end = Clock::now();
+
+    auto accumulators = std::vector<rock::internal::NetworkAccumulator>{};
+    for (auto const& board : assorted_random_game_boards)
+        accumulators.push_back(rock::internal::refresh_accumulator(
+            *network, board[rock::Player::White], board[rock::Player::Black]));
+
+    auto const t_network_begin = Clock::now();
+    for (auto i = 0; i < repetitions; ++i)
+        for (auto const& accumulator : accumulators)
+            checksum += rock::internal::evaluate_network(*network, accumulator);
+    auto const t_network_end = Clock::now();
+
+    auto const evaluations = static_cast<double>(repetitions * accumulators.size());
+    auto const per_second = [&](auto duration) {
+        return evaluations / ch::duration<double>(duration).count();
+    };
+
+    fmt::print(
+        "Evaluations per second: heuristic = {:.3g}, network = {:.3g} [checksum = {}]\n",
+        per_second(t_heuristic_end - t_heuristic_begin),
+        per_second(t_network_end - t_network_begin),
+        checksum);
+
+    // Time the same fixed-depth searches with each evaluation
+    auto table = rock::internal::TranspositionTable(18);
+    auto const time_search = [&](char const* name, EvaluationNetwork const* n) {
+        auto control = rock::internal::SearchControl{};
+        auto const t_begin = Clock::now();
+        for (auto const& board : assorted_random_game_boards)
+        {
+            table.reset();
+            for (auto depth = 1; depth <= 6; ++depth)
+            {
+                auto searcher = rock::internal::Searcher(depth, &table, &control, n);
+                searcher.search_root(board[rock::Player::White], board[rock::Player::Black]);
+            }
+        }
+        auto const duration = ch::duration<double>(Clock::now() - t_begin).count();
+
+        fmt::print(
+            "Search to depth 6 with {} evaluation [duration = {:4.0f}ms] [nodes = {}] "
+            "[{:.3g} nodes/s]\n",
+            name,
+            duration * 1000.0,
+            control.nodes,
+            static_cast<double>(control.nodes) / duration);
+    };
+
+    time_search("heuristic", nullptr);
+    time_search("network  ", network.get());
+}
@@ -0,0 +1,142 @@
+#include "example_boards.h"
+#include "internal/opening_book.h"
+#include "internal/symmetry.h"
+#include "rock/algorithms.h"
+#include "rock/starting_position.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+using rock::internal::InternalMove;
+
+namespace
+{
+
+auto book_moves_of(rock::Position const& position, std::size_t count) -> std::vector<rock::Move>
+{
+    auto moves = rock::list_moves(position);
+    moves.resize(std::min(moves.size(), count));
+    return moves;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::OpeningBook")
+{
+    auto const path = std::string{"rock_test_book.bin"};
+    auto const& start = rock::starting_position;
+    auto const other = rock::Position{random_game_boards_10_moves[0], rock::Player::White};
+
+    auto builder = rock::internal::OpeningBookBuilder{};
+    auto const start_moves = book_moves_of(start, 3);
+    for (auto i = std::size_t{}; i < start_moves.size(); ++i)
+    {
+        auto const move = InternalMove::from(start_moves[i]);
+        builder.add_move(start.friends(), start.enemies(), move, static_cast<rock::u32>(i + 1));
+    }
+
+    // The same move again adds up
+    auto const other_move = InternalMove::from(book_moves_of(other, 1).front());
+    builder.add_move(other.friends(), other.enemies(), other_move, 5);
+    builder.add_move(other.friends(), other.enemies(), other_move, 7);
+    CHECK(builder.num_moves() == start_moves.size() + 1);
+
+    builder.write(path);
+    auto const book = rock::internal::OpeningBook::open(path);
+    REQUIRE(book);
+    CHECK(book->num_moves() == builder.num_moves());
+
+    // By weight
+    auto const start_entries = book->lookup(start.friends(), start.enemies());
+    REQUIRE(start_entries.size() == start_moves.size());
+    CHECK(start_entries.front().move == InternalMove::from(start_moves.back()));
+    CHECK(start_entries.front().weight == start_moves.size());
+
+    // Every symmetric version of a position finds its moves, turned to match it
+    for (auto flips = 0; flips < 8; ++flips)
+    {
+        auto const symmetry = rock::internal::Symmetry{static_cast<rock::u8>(flips)};
+        auto const entries = book->lookup(
+            rock::internal::apply_symmetry(other.friends(), symmetry),
+            rock::internal::apply_symmetry(other.enemies(), symmetry));
+        REQUIRE(entries.size() == 1);
+        CHECK(entries.front().move == rock::internal::apply_symmetry(other_move, symmetry));
+        CHECK(entries.front().weight == 12);
+    }
+
+    auto const unknown = rock::Position{random_game_boards_10_moves[1], rock::Player::White};
+    CHECK(book->lookup(unknown.friends(), unknown.enemies()).empty());
+
+    // Merging books and games
+    auto merged = rock::internal::OpeningBookBuilder{};
+    merged.add_book(*book);
+    auto const game = std::vector{start_moves[1]};
+    merged.add_game(start, game, rock::GameOutcome::WhiteWins, 10);
+    merged.write(path);
+
+    auto const merged_book = rock::internal::OpeningBook::open(path);
+    REQUIRE(merged_book);
+    auto const merged_entries = merged_book->lookup(start.friends(), start.enemies());
+    REQUIRE(merged_entries.size() == start_moves.size());
+    CHECK(merged_entries.front().move == InternalMove::from(start_moves[1]));
+    CHECK(merged_entries.front().weight == 4);
+
+    std::remove(path.c_str());
+    CHECK(rock::internal::OpeningBook::open(path) == nullptr);
+}
+
+TEST_CASE("rock::analyze_position_with_ai_difficulty_level_from_book")
+{
+    auto const path = std::string{"rock_test_book.bin"};
+    auto const& start = rock::starting_position;
+    auto const start_moves = book_moves_of(start, 2);
+
+    auto builder = rock::internal::OpeningBookBuilder{};
+    for (auto const move : start_moves)
+        builder.add_move(start.friends(), start.enemies(), InternalMove::from(move), 1);
+    builder.write(path);
+
+    REQUIRE(rock::load_opening_book(path));
+    auto const book_moves = rock::probe_opening_book(start);
+    CHECK(book_moves.size() == start_moves.size());
+
+    // Timed against the search that the same level does without the book
+    constexpr auto ai_level = 10;
+    constexpr auto num_repeats = 1000;
+
+    auto t_begin = Clock::now();
+    for (auto i = 0; i < num_repeats; ++i)
+    {
+        auto const analysis = rock::analyze_position_with_ai_difficulty_level(start, ai_level);
+        REQUIRE(analysis.best_move);
+        CHECK(std::find(start_moves.begin(), start_moves.end(), *analysis.best_move) !=
+              start_moves.end());
+        CHECK(analysis.nodes == 0);
+    }
+    auto const book_duration = (Clock::now() - t_begin) / num_repeats;
+
+    // Lower levels still search
+    CHECK(rock::analyze_position_with_ai_difficulty_level(start, 5).nodes > 0);
+
+    rock::clear_opening_book();
+    CHECK(rock::probe_opening_book(start).empty());
+
+    t_begin = Clock::now();
+    auto const searched = rock::analyze_position_with_ai_difficulty_level(start, ai_level);
+    auto const search_duration = Clock::now() - t_begin;
+    CHECK(searched.nodes > 0);
+
+    fmt::print(
+        "Level {} from the starting position: book = {:.1f}us, search = {:.1f}ms\n",
+        ai_level,
+        ch::duration<double, std::micro>(book_duration).count(),
+        ch::duration<double, std::milli>(search_duration).count());
+
+    std::remove(path.c_str());
+    CHECK_FALSE(rock::load_opening_book(path));
+}
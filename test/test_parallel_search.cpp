@@ -0,0 +1,139 @@
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include "test_helpers.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+constexpr rock::ParallelSearch parallel_searches[] = {
+    rock::ParallelSearch::LazySmp,
+    rock::ParallelSearch::SplitPoints,
+};
+
+auto to_string(rock::ParallelSearch parallel_search) -> char const*
+{
+    return parallel_search == rock::ParallelSearch::LazySmp ? "lazy SMP" : "split points";
+}
+
+}  // namespace
+
+TEST_CASE("rock::analyze_position_in_parallel")
+{
+    for (auto const num_threads : {1u, 3u})
+    {
+        auto executor = rock::Executor{rock::ExecutorConfig{num_threads}};
+
+        for (auto const parallel_search : parallel_searches)
+        {
+            auto limits = rock::SearchLimits{};
+            limits.depth = 5;
+            for (auto const& board : random_game_boards_10_moves)
+            {
+                auto const position = rock::Position{board, rock::Player::White};
+                auto const analysis =
+                    rock::analyze_position(position, limits, executor, parallel_search);
+                check_analysis(analysis, position);
+                CHECK(analysis.nodes > 0);
+            }
+
+            // The helper threads are stopped along with the main search, so it takes about its time
+            limits = rock::SearchLimits{};
+            limits.move_time = ch::milliseconds{20};
+            auto const position =
+                rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+            auto const t_begin = Clock::now();
+            auto const analysis =
+                rock::analyze_position(position, limits, executor, parallel_search);
+            fmt::print(
+                "{} with {} threads: 20ms search took {}ms\n",
+                to_string(parallel_search),
+                num_threads,
+                ch::duration_cast<ch::milliseconds>(Clock::now() - t_begin).count());
+            check_analysis(analysis, position);
+        }
+    }
+}
+
+TEST_CASE("rock::analyze_position_in_parallel_node_limit")
+{
+    // The helper threads share the node limit, rather than each being given what was left of it
+    constexpr auto node_limit = rock::u64{200'000};
+    auto executor = rock::Executor{rock::ExecutorConfig{8}};
+    auto limits = rock::SearchLimits{};
+    limits.nodes = node_limit;
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    for (auto const parallel_search : parallel_searches)
+    {
+        auto const analysis = rock::analyze_position(position, limits, executor, parallel_search);
+        check_analysis(analysis, position);
+        CHECK(analysis.nodes >= node_limit);
+        CHECK(analysis.nodes < node_limit + node_limit / 4);
+    }
+}
+
+TEST_CASE("rock::analyze_position_in_parallel_without_queue")
+{
+    // With no room in the queue, the helpers are still queued rather than run by the main search
+    auto executor = rock::Executor{rock::ExecutorConfig{2, false, 0}};
+    auto limits = rock::SearchLimits{};
+    limits.depth = 3;
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    for (auto const parallel_search : parallel_searches)
+    {
+        check_analysis(
+            rock::analyze_position(position, limits, executor, parallel_search), position);
+    }
+}
+
+TEST_CASE("rock::analyze_position_in_parallel_speed")
+{
+    auto limits = rock::SearchLimits{};
+    limits.depth = 7;
+
+    auto const time_boards = [&](auto&& analyze) {
+        auto nodes = rock::u64{};
+        auto const t_begin = Clock::now();
+        for (auto const& board : assorted_random_game_boards)
+            nodes += analyze(rock::Position{board, rock::Player::White}).nodes;
+        auto const duration = ch::duration<double, std::milli>(Clock::now() - t_begin).count();
+        return std::pair{duration, nodes};
+    };
+
+    auto const [serial_duration, serial_nodes] =
+        time_boards([&](auto const& position) { return rock::analyze_position(position, limits); });
+    fmt::print(
+        "Parallel search (depth = {}): serial = {:7.1f}ms [nodes = {}]\n",
+        *limits.depth,
+        serial_duration,
+        serial_nodes);
+
+    for (auto const num_threads : {4u, 8u, 16u})
+    {
+        auto executor = rock::Executor{rock::ExecutorConfig{num_threads}};
+
+        for (auto const parallel_search : parallel_searches)
+        {
+            auto const [duration, nodes] = time_boards([&](auto const& position) {
+                return rock::analyze_position(position, limits, executor, parallel_search);
+            });
+            fmt::print(
+                "Parallel search (depth = {}): {:12} with {:2} threads = {:7.1f}ms "
+                "[speedup = {:.2f}] [nodes = {}]\n",
+                *limits.depth,
+                to_string(parallel_search),
+                num_threads,
+                duration,
+                serial_duration / duration,
+                nodes);
+        }
+    }
+}
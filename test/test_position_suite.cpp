@@ -0,0 +1,170 @@
+#include "example_boards.h"
+#include "internal/position_suite.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/parse.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+TEST_CASE("rock::parse_fen_to_position")
+{
+    auto const fen = rock::format_as_fen(assorted_random_game_boards[0]);
+
+    auto const position = rock::parse_fen_to_position(fen + " b");
+    REQUIRE(position.has_value());
+    CHECK(position->board()[rock::Player::White] ==
+          assorted_random_game_boards[0][rock::Player::White]);
+    CHECK(position->board()[rock::Player::Black] ==
+          assorted_random_game_boards[0][rock::Player::Black]);
+    CHECK(position->player_to_move() == rock::Player::Black);
+
+    CHECK(rock::parse_fen_to_position(fen + "  w 1-0")->player_to_move() == rock::Player::White);
+    CHECK_FALSE(rock::parse_fen_to_position(fen).has_value());
+    CHECK_FALSE(rock::parse_fen_to_position(fen + " x").has_value());
+    CHECK_FALSE(rock::parse_fen_to_position("8/8/8/8/8/8/8/9x w").has_value());
+}
+
+TEST_CASE("rock::internal::parse_suite_line")
+{
+    auto const fen = rock::format_as_fen(assorted_random_game_boards[1]);
+
+    auto const annotated = rock::internal::parse_suite_line(
+        fen + " w bm b1-h1; ce -35; id \"a; b\"; c9 \"1/2-1/2\"; D1 12; D2 144");
+    REQUIRE(annotated.has_value());
+    CHECK(annotated->best_move == rock::parse_move("b1-h1"));
+    CHECK(annotated->score == rock::ScoreType{-35});
+    CHECK(annotated->result == 0.5);
+    REQUIRE(annotated->perft_counts.size() == 2);
+    CHECK(annotated->perft_counts[1].depth == 2);
+    CHECK(annotated->perft_counts[1].num_positions == 144);
+
+    // A bare result, as in the corpora of rock_tune
+    auto const labeled = rock::internal::parse_suite_line(fen + " b 0-1");
+    REQUIRE(labeled.has_value());
+    CHECK(labeled->result == 0.0);
+    CHECK_FALSE(labeled->best_move.has_value());
+
+    auto const plain = rock::internal::parse_suite_line(fen + " b");
+    REQUIRE(plain.has_value());
+    CHECK_FALSE(plain->result.has_value());
+    CHECK(plain->perft_counts.empty());
+
+    CHECK_FALSE(rock::internal::parse_suite_line(fen + " w bm z9-a1").has_value());
+    CHECK_FALSE(rock::internal::parse_suite_line(fen + " w ce many").has_value());
+    CHECK_FALSE(rock::internal::parse_suite_line(fen + " w 2-0").has_value());
+    CHECK_FALSE(rock::internal::parse_suite_line(fen + " w D3").has_value());
+}
+
+TEST_CASE("rock::internal::PositionSuiteReader")
+{
+    auto const fen = rock::format_as_fen(assorted_random_game_boards[2]);
+    auto const text = fmt::format(
+        "# A comment\r\n"
+        "{0} w bm b1-h1;\r\n"
+        "\n"
+        "not a position\n"
+        "{0} b 1/2-1/2",
+        fen);
+
+    auto reader = rock::internal::PositionSuiteReader{text};
+    auto const first = reader.next();
+    REQUIRE(first.has_value());
+    CHECK(first->best_move.has_value());
+    auto const second = reader.next();
+    REQUIRE(second.has_value());
+    CHECK(second->position.player_to_move() == rock::Player::Black);
+    CHECK(second->result == 0.5);
+    CHECK_FALSE(reader.next().has_value());
+    CHECK(reader.invalid_lines() == std::vector<std::size_t>{4});
+}
+
+TEST_CASE("rock::internal::read_position_suite_perft")
+{
+    constexpr auto path = "rock_test_suite.epd";
+    constexpr auto max_depth = 2;
+
+    {
+        auto file = std::ofstream(path);
+        for (auto const& board : assorted_random_game_boards)
+        {
+            auto const position = rock::Position{board, rock::Player::White};
+            file << rock::format_as_fen(board) << " w";
+            for (auto depth = 1; depth <= max_depth; ++depth)
+                file << fmt::format(" D{} {};", depth, rock::count_moves(position, depth));
+            file << '\n';
+        }
+    }
+
+    auto const suite = rock::internal::read_position_suite(path);
+    REQUIRE(suite.has_value());
+    CHECK(suite->invalid_lines.empty());
+    REQUIRE(suite->positions.size() == std::size(assorted_random_game_boards));
+
+    for (auto const& entry : suite->positions)
+    {
+        REQUIRE(entry.perft_counts.size() == max_depth);
+        for (auto const& count : entry.perft_counts)
+            CHECK(rock::count_moves(entry.position, count.depth) == count.num_positions);
+    }
+
+    CHECK_FALSE(rock::internal::read_position_suite("does_not_exist.epd").has_value());
+    std::remove(path);
+}
+
+TEST_CASE("rock::internal::read_position_suite_speed")
+{
+    constexpr auto path = "rock_test_suite_speed.epd";
+    constexpr auto num_copies = 2000;
+
+    {
+        auto file = std::ofstream(path);
+        for (auto i = 0; i < num_copies; ++i)
+        {
+            for (auto const& board : assorted_random_game_boards)
+                file << rock::format_as_fen(board) << " w 1-0\n";
+        }
+    }
+
+    // Reading the lines as rock_tune used to, with a stream for each line
+    auto const t_stream = Clock::now();
+    auto num_stream = std::size_t{};
+    {
+        auto file = std::ifstream(path);
+        auto line = std::string{};
+        while (std::getline(file, line))
+        {
+            auto stream = std::istringstream{line};
+            auto fen = std::string{};
+            auto side = std::string{};
+            auto result = std::string{};
+            stream >> fen >> side >> result;
+            num_stream += rock::parse_fen_to_board(fen) && rock::parse_player(side);
+        }
+    }
+
+    auto const t_suite = Clock::now();
+    auto const suite = rock::internal::read_position_suite(path);
+    auto const t_end = Clock::now();
+
+    REQUIRE(suite.has_value());
+    CHECK(suite->positions.size() == num_stream);
+    CHECK(suite->invalid_lines.empty());
+
+    fmt::print(
+        "Reading {} positions: [line streams = {:.0f} positions/s] [read_position_suite = {:.0f} "
+        "positions/s]\n",
+        num_stream,
+        num_stream / ch::duration<double>(t_suite - t_stream).count(),
+        suite->positions.size() / ch::duration<double>(t_end - t_suite).count());
+
+    std::remove(path);
+}
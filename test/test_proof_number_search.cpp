@@ -0,0 +1,151 @@
+#include "example_boards.h"
+#include "internal/move_generation.h"
+#include "internal/proof_number_search.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+using rock::internal::GameResult;
+using rock::internal::solve_with_proof_numbers;
+
+namespace
+{
+
+constexpr auto max_solver_nodes = std::size_t{1} << 18;
+
+/**
+ * The positions shortly before the end of games played out by a shallow search
+ */
+auto endgame_positions() -> std::vector<rock::Position>
+{
+    constexpr auto num_last_positions = 6;
+    constexpr auto max_game_length = 200;
+
+    auto positions = std::vector<rock::Position>{};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto game = std::vector{rock::Position{board, rock::Player::White}};
+        while (rock::get_game_outcome(game.back()) == rock::GameOutcome::Ongoing &&
+               game.size() < max_game_length)
+        {
+            auto const analysis = rock::analyze_position(game.back(), 2);
+            game.push_back(rock::apply_move(*analysis.best_move, game.back()));
+        }
+
+        auto const first = game.size() > num_last_positions ? game.size() - num_last_positions : 0;
+        for (auto i = first; i + 1 < game.size(); ++i)
+            positions.push_back(game[i]);
+    }
+    return positions;
+}
+
+auto solve(rock::Position const& position)
+{
+    return solve_with_proof_numbers(position.friends(), position.enemies(), max_solver_nodes);
+}
+
+auto is_forced_win(rock::ScoreType score) -> bool
+{
+    return score > rock::internal::big / 2 || score < -rock::internal::big / 2;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::solve_with_proof_numbers")
+{
+    auto num_solved = 0;
+
+    for (auto const& position : endgame_positions())
+    {
+        auto const solution = solve(position);
+        if (solution.result == GameResult::Unknown)
+            continue;
+        ++num_solved;
+
+        REQUIRE(rock::is_move_legal(*solution.move.to_standard_move(), position));
+        auto const next_position = rock::apply_move(*solution.move.to_standard_move(), position);
+        auto const next_solution = solve(next_position);
+
+        // The move keeps the result, now seen from the other side
+        if (solution.result == GameResult::Win)
+        {
+            CHECK(
+                (rock::get_game_outcome(next_position) != rock::GameOutcome::Ongoing ||
+                 next_solution.result == GameResult::Loss));
+        }
+        if (solution.result == GameResult::Loss)
+            CHECK(next_solution.result == GameResult::Win);
+
+        // A win found by a full-width search must also be found by the solver
+        auto const analysis = rock::analyze_position(position, 4);
+        auto const score = position.player_to_move() == rock::Player::White ? analysis.score
+                                                                            : -analysis.score;
+        if (is_forced_win(score))
+            CHECK(solution.result == (score > 0 ? GameResult::Win : GameResult::Loss));
+
+        // The search uses the solver's result as an exact score
+        auto limits = rock::SearchLimits{};
+        limits.depth = 8;
+        limits.solver_nodes = max_solver_nodes;
+        auto const solved_analysis = rock::analyze_position(position, limits);
+        CHECK(solved_analysis.best_move == solution.move.to_standard_move());
+        if (solution.result == GameResult::Win)
+            CHECK(solved_analysis.score == (position.player_to_move() == rock::Player::White
+                                                ? rock::internal::big
+                                                : -rock::internal::big));
+    }
+
+    CHECK(num_solved > 0);
+}
+
+TEST_CASE("rock::internal::solve_with_proof_numbers_speed")
+{
+    // How many nodes each approach takes to find the forced wins that a depth-6 search can see
+    constexpr auto max_depth = 6;
+
+    auto num_wins = 0;
+    auto alpha_beta_nodes = rock::u64{};
+    auto solver_nodes = rock::u64{};
+    auto alpha_beta_duration = Clock::duration{};
+    auto solver_duration = Clock::duration{};
+
+    for (auto const& position : endgame_positions())
+    {
+        auto t_begin = Clock::now();
+        auto analysis = rock::PositionAnalysis{};
+        auto nodes = rock::u64{};
+        for (auto depth = 1; depth <= max_depth && !is_forced_win(analysis.score); ++depth)
+        {
+            analysis = rock::analyze_position(position, depth);
+            nodes += analysis.nodes;
+        }
+        auto const alpha_beta_time = Clock::now() - t_begin;
+        if (!is_forced_win(analysis.score))
+            continue;
+
+        t_begin = Clock::now();
+        auto const solution = solve(position);
+        auto const solver_time = Clock::now() - t_begin;
+        CHECK(solution.result != GameResult::Unknown);
+
+        ++num_wins;
+        alpha_beta_nodes += nodes;
+        alpha_beta_duration += alpha_beta_time;
+        solver_nodes += solution.nodes;
+        solver_duration += solver_time;
+    }
+
+    fmt::print(
+        "Forced wins ({} positions): alpha-beta = {} nodes, {:.1f}ms; proof-number search = {} "
+        "nodes, {:.1f}ms\n",
+        num_wins,
+        alpha_beta_nodes,
+        ch::duration<double, std::milli>(alpha_beta_duration).count(),
+        solver_nodes,
+        ch::duration<double, std::milli>(solver_duration).count());
+}
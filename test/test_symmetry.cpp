@@ -0,0 +1,244 @@
+#include "example_boards.h"
+#include "internal/move_generation.h"
+#include "internal/search.h"
+#include "internal/symmetry.h"
+#include "internal/transposition_table.h"
+#include "rock/algorithms.h"
+#include "rock/starting_position.h"
+#include "test_helpers.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <set>
+#include <utility>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+using rock::internal::Symmetry;
+
+namespace
+{
+
+/**
+ * The symmetry applied one square at a time
+ */
+auto apply_symmetry_by_squares(rock::u64 board, Symmetry symmetry) -> rock::u64
+{
+    auto result = rock::u64{};
+    for (auto square = 0; square < 64; ++square)
+    {
+        if (!(board & (rock::u64{1} << square)))
+            continue;
+
+        auto x = square % 8;
+        auto y = square / 8;
+        if (symmetry.flips & Symmetry::flip_diagonal)
+            std::swap(x, y);
+        if (symmetry.flips & Symmetry::flip_vertical)
+            y = 7 - y;
+        if (symmetry.flips & Symmetry::flip_horizontal)
+            x = 7 - x;
+        result |= rock::u64{1} << (y * 8 + x);
+    }
+    return result;
+}
+
+auto all_symmetries()
+{
+    auto symmetries = std::vector<Symmetry>{};
+    for (auto flips = 0; flips < 8; ++flips)
+        symmetries.push_back(Symmetry{static_cast<rock::u8>(flips)});
+    return symmetries;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::apply_symmetry")
+{
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const pieces = rock::u64{board[rock::Player::White]};
+        CHECK(rock::internal::flip_vertical(pieces) ==
+              rock::internal::flip_vertical_manual(pieces));
+
+        for (auto const symmetry : all_symmetries())
+        {
+            auto const transformed = rock::internal::apply_symmetry(pieces, symmetry);
+            CHECK(transformed == apply_symmetry_by_squares(pieces, symmetry));
+            CHECK(rock::internal::undo_symmetry(transformed, symmetry) == pieces);
+        }
+    }
+}
+
+TEST_CASE("rock::internal::canonicalize")
+{
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const friends = rock::u64{board[rock::Player::White]};
+        auto const enemies = rock::u64{board[rock::Player::Black]};
+        auto const canonical = rock::internal::canonicalize(friends, enemies);
+
+        CHECK(rock::internal::apply_symmetry(friends, canonical.symmetry) == canonical.friends);
+        CHECK(rock::internal::apply_symmetry(enemies, canonical.symmetry) == canonical.enemies);
+
+        // Every symmetric version has the same canonical version
+        for (auto const symmetry : all_symmetries())
+        {
+            auto const other = rock::internal::canonicalize(
+                rock::internal::apply_symmetry(friends, symmetry),
+                rock::internal::apply_symmetry(enemies, symmetry));
+            CHECK(other.friends == canonical.friends);
+            CHECK(other.enemies == canonical.enemies);
+        }
+    }
+}
+
+TEST_CASE("rock::internal::TranspositionTable::set_symmetric")
+{
+    auto table = rock::internal::TranspositionTable(10);
+    table.set_symmetric(true);
+
+    auto const friends = rock::u64{random_game_boards_10_moves[0][rock::Player::White]};
+    auto const enemies = rock::u64{random_game_boards_10_moves[0][rock::Player::Black]};
+    auto moves = rock::internal::generate_moves(friends, enemies);
+    auto move = rock::internal::InternalMove{};
+    rock::internal::for_each_move(moves, [&](rock::u64 from_board, rock::u64 to_board) {
+        move = rock::internal::InternalMove{from_board, to_board};
+    });
+
+    table.update(friends, enemies, [&](rock::internal::TranspositionTable::Value& value, bool) {
+        value.set_key(friends, enemies);
+        value.recommendation = {move, 42};
+        value.depth = 3;
+    });
+
+    // Each symmetric version finds the entry, with the move turned to match it
+    for (auto const symmetry : all_symmetries())
+    {
+        auto const entry = table.load(
+            rock::internal::apply_symmetry(friends, symmetry),
+            rock::internal::apply_symmetry(enemies, symmetry));
+        REQUIRE(entry);
+        CHECK(entry->recommendation.move == rock::internal::apply_symmetry(move, symmetry));
+        CHECK(entry->recommendation.score == 42);
+        CHECK(entry->depth == 3);
+    }
+
+    table.set_symmetric(false);
+    CHECK_FALSE(table.load(friends, enemies));
+}
+
+TEST_CASE("rock::analyze_position_with_symmetric_transpositions")
+{
+    auto limits = rock::SearchLimits{};
+    limits.depth = 5;
+    limits.symmetric_transpositions = true;
+
+    auto const& start = rock::starting_position;
+    check_analysis(rock::analyze_position(start, limits), start);
+    for (auto const& board : random_game_boards_5_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        check_analysis(rock::analyze_position(position, limits), position);
+    }
+
+    // The mode can be switched between analyses on the same thread
+    limits.symmetric_transpositions = false;
+    check_analysis(rock::analyze_position(start, limits), start);
+}
+
+TEST_CASE("rock::analyze_position_with_symmetric_transpositions_speed")
+{
+    // How many more transpositions there are to find: the distinct positions a few moves from the
+    // start, with and without counting symmetric positions as the same
+    constexpr auto num_plies = 3;
+
+    auto positions = std::set<std::pair<rock::u64, rock::u64>>{};
+    auto canonical_positions = std::set<std::pair<rock::u64, rock::u64>>{};
+    auto frontier = std::vector{std::pair{
+        rock::u64{rock::starting_position.friends()},
+        rock::u64{rock::starting_position.enemies()},
+    }};
+    for (auto ply = 0; ply < num_plies; ++ply)
+    {
+        auto next_frontier = std::vector<std::pair<rock::u64, rock::u64>>{};
+        for (auto const& [friends, enemies] : frontier)
+        {
+            auto moves = rock::internal::generate_moves(friends, enemies);
+            rock::internal::for_each_move(moves, [&](rock::u64 from_board, rock::u64 to_board) {
+                auto f = rock::BitBoard{friends};
+                auto e = rock::BitBoard{enemies};
+                rock::internal::apply_move_low_level(from_board, to_board, &f, &e);
+                if (positions.insert({e, f}).second)
+                    next_frontier.push_back({e, f});
+
+                auto const canonical = rock::internal::canonicalize(e, f);
+                canonical_positions.insert({canonical.friends, canonical.enemies});
+            });
+        }
+        frontier = std::move(next_frontier);
+    }
+
+    // The cost of a canonical key next to the hash that every table access already computes
+    constexpr auto num_repeats = 200;
+    auto checksum = rock::u64{};
+    auto t_begin = Clock::now();
+    for (auto i = 0; i < num_repeats; ++i)
+    {
+        for (auto const& [friends, enemies] : positions)
+            checksum += rock::internal::compute_hash(friends ^ i, enemies);
+    }
+    auto const hash_duration = Clock::now() - t_begin;
+
+    t_begin = Clock::now();
+    for (auto i = 0; i < num_repeats; ++i)
+    {
+        for (auto const& [friends, enemies] : positions)
+            checksum += rock::internal::canonicalize(friends ^ i, enemies).friends;
+    }
+    auto const canonicalize_duration = Clock::now() - t_begin;
+    auto const num_calls = static_cast<double>(positions.size() * num_repeats);
+
+    fmt::print(
+        "Positions within {} moves of the start: {} distinct, {} up to symmetry; hash {:.1f}ns, "
+        "canonicalize {:.1f}ns ({})\n",
+        num_plies,
+        positions.size(),
+        canonical_positions.size(),
+        ch::duration<double, std::nano>(hash_duration).count() / num_calls,
+        ch::duration<double, std::nano>(canonicalize_duration).count() / num_calls,
+        checksum % 10);
+
+    // How many of those positions a search of the starting position leaves in the table, where
+    // a later search reaching them would find a move to try first
+    constexpr auto depth = 6;
+    for (auto const is_symmetric : {false, true})
+    {
+        auto table = rock::internal::TranspositionTable(18);
+        table.set_symmetric(is_symmetric);
+        auto control = rock::internal::SearchControl{};
+
+        t_begin = Clock::now();
+        for (auto d = 1; d <= depth; ++d)
+        {
+            auto searcher = rock::internal::Searcher(d, &table, &control);
+            searcher.search_root(
+                rock::starting_position.friends(), rock::starting_position.enemies());
+        }
+        auto const duration = Clock::now() - t_begin;
+
+        auto num_found = 0;
+        for (auto const& [friends, enemies] : positions)
+            num_found += table.load(friends, enemies).has_value();
+
+        fmt::print(
+            "Search of the start to depth {} ({} keys): {} nodes, {:.0f}ms, {} of the positions "
+            "found in the table\n",
+            depth,
+            is_symmetric ? "symmetric" : "exact",
+            control.nodes,
+            ch::duration<double, std::milli>(duration).count(),
+            num_found);
+    }
+}
@@ -0,0 +1,202 @@
+#include "internal/move_generation.h"
+#include "internal/proof_number_search.h"
+#include "internal/tablebase.h"
+#include "internal/thread_pool.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+using rock::internal::GameResult;
+using rock::internal::Material;
+
+namespace
+{
+
+// Every position of a table is checked in full, so only a sample of them
+constexpr auto sample_step = rock::u64{997};
+
+auto position_from(std::pair<rock::BitBoard, rock::BitBoard> const& pieces) -> rock::Position
+{
+    return rock::Position{rock::Board{pieces.first, pieces.second}, rock::Player::White};
+}
+
+/**
+ * A capture down to a single piece connects it, and there are no tables for that
+ */
+auto probe_or_finish(
+    rock::internal::Tablebase const& tablebase, rock::BitBoard friends, rock::BitBoard enemies)
+    -> rock::internal::TablebaseEntry
+{
+    if (friends.count() > 1 && enemies.count() > 1)
+    {
+        auto const entry = tablebase.probe(friends, enemies);
+        REQUIRE(entry);
+        return *entry;
+    }
+
+    bool const has_player_won = rock::internal::are_pieces_all_together(friends);
+    bool const has_player_lost = rock::internal::are_pieces_all_together(enemies);
+    if (has_player_won && has_player_lost)
+        return {GameResult::Draw, 0};
+    return {has_player_won ? GameResult::Win : GameResult::Loss, 0};
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::tablebase_index")
+{
+    auto const materials = rock::internal::list_tablebase_materials(6);
+    CHECK(materials.size() == 6);
+    CHECK(materials.front() == Material{2, 2});
+
+    for (auto const material : materials)
+    {
+        auto const size = rock::internal::tablebase_size(material);
+        for (auto index = rock::u64{}; index < size; index += size / 1000 + 1)
+        {
+            auto const [friends, enemies] = rock::internal::tablebase_position(material, index);
+            REQUIRE(friends.count() == static_cast<std::size_t>(material.num_friends));
+            REQUIRE(enemies.count() == static_cast<std::size_t>(material.num_enemies));
+            REQUIRE((friends & enemies) == 0);
+            REQUIRE(rock::internal::tablebase_index(friends, enemies) == index);
+        }
+    }
+}
+
+TEST_CASE("rock::internal::generate_tablebase")
+{
+    auto const path = std::string{"rock_test_tablebase.bin"};
+    auto const material = Material{2, 2};
+
+    auto pool = rock::internal::ThreadPool{rock::internal::ThreadPoolConfig{2}};
+    auto const t_begin = Clock::now();
+    rock::internal::generate_tablebase(4, path, &pool);
+    auto const duration = Clock::now() - t_begin;
+
+    auto const tablebase = rock::internal::Tablebase::open(path);
+    REQUIRE(tablebase);
+    CHECK(tablebase->max_pieces() == 4);
+
+    auto num_wins = 0;
+    auto num_losses = 0;
+    auto num_draws = 0;
+    auto max_distance = 0;
+
+    auto const size = rock::internal::tablebase_size(material);
+    for (auto index = rock::u64{}; index < size; index += sample_step)
+    {
+        auto const [friends, enemies] = rock::internal::tablebase_position(material, index);
+        auto const entry = tablebase->probe(friends, enemies);
+        REQUIRE(entry);
+        max_distance = std::max(max_distance, entry->distance);
+
+        if (entry->result == GameResult::Win)
+            ++num_wins;
+        else if (entry->result == GameResult::Loss)
+            ++num_losses;
+        else
+            ++num_draws;
+
+        bool const is_over = rock::internal::are_pieces_all_together(friends) ||
+            rock::internal::are_pieces_all_together(enemies);
+        if (is_over)
+        {
+            CHECK(entry->distance == 0);
+            continue;
+        }
+
+        // The entry follows from the entries of the positions after each move
+        auto has_losing_child = false;
+        auto has_shorter_losing_child = false;
+        auto are_all_children_won_sooner = true;
+        auto moves = rock::internal::generate_moves(friends, enemies);
+        rock::internal::for_each_move(moves, [&](rock::u64 from_board, rock::u64 to_board) {
+            auto child_friends = friends;
+            auto child_enemies = enemies;
+            rock::internal::apply_move_low_level(
+                from_board, to_board, &child_friends, &child_enemies);
+
+            auto const child = probe_or_finish(*tablebase, child_enemies, child_friends);
+            if (child.result == GameResult::Loss)
+            {
+                has_losing_child = true;
+                has_shorter_losing_child |= child.distance < entry->distance - 1;
+            }
+            if (child.result != GameResult::Win || child.distance >= entry->distance)
+                are_all_children_won_sooner = false;
+        });
+
+        if (entry->result == GameResult::Win)
+            CHECK((has_losing_child && !has_shorter_losing_child));
+        if (entry->result == GameResult::Loss)
+            CHECK(are_all_children_won_sooner);
+        if (entry->result == GameResult::Draw)
+            CHECK_FALSE(has_losing_child);
+
+        // Anything the solver proves, the tablebase agrees with
+        if (entry->distance <= 5)
+        {
+            auto const solution =
+                rock::internal::solve_with_proof_numbers(friends, enemies, std::size_t{1} << 14);
+            if (solution.result == GameResult::Win || solution.result == GameResult::Loss)
+                CHECK(solution.result == entry->result);
+        }
+    }
+
+    CHECK(num_wins > 0);
+    CHECK(num_losses > 0);
+    CHECK(num_draws > 0);
+
+    fmt::print(
+        "Tablebase for 2 vs 2 ({} positions) generated in {:.1f}s; sampled {} wins, {} losses, {} "
+        "draws, longest {} moves\n",
+        size,
+        ch::duration<double>(duration).count(),
+        num_wins,
+        num_losses,
+        num_draws,
+        max_distance);
+
+    // Through the public interface, and in the search
+    REQUIRE(rock::load_tablebase(path));
+
+    auto num_searched = 0;
+    for (auto index = rock::u64{}; index < size && num_searched < 20; index += sample_step)
+    {
+        auto const position = position_from(rock::internal::tablebase_position(material, index));
+        auto const entry = tablebase->probe(position.friends(), position.enemies());
+        if (entry->result != GameResult::Win || entry->distance < 3)
+            continue;
+        ++num_searched;
+
+        auto const result = rock::probe_tablebase(position);
+        REQUIRE(result);
+        CHECK(result->outcome == rock::GameOutcome::WhiteWins);
+        CHECK(result->distance == entry->distance);
+
+        // A shallow search sees the win through the tablebase, and plays towards it
+        auto const analysis = rock::analyze_position(position, 1);
+        CHECK(analysis.score > rock::internal::big / 2);
+
+        auto const next_position = rock::apply_move(*analysis.best_move, position);
+        auto const next_result = rock::probe_tablebase(next_position);
+        REQUIRE(next_result);
+        CHECK(next_result->outcome == rock::GameOutcome::WhiteWins);
+        CHECK(next_result->distance == entry->distance - 1);
+    }
+    CHECK(num_searched > 0);
+
+    rock::clear_tablebase();
+    auto const any_position = position_from(rock::internal::tablebase_position(material, 0));
+    CHECK_FALSE(rock::probe_tablebase(any_position));
+
+    std::remove(path.c_str());
+    CHECK(rock::internal::Tablebase::open(path) == nullptr);
+    CHECK_FALSE(rock::load_tablebase(path));
+}
@@ -0,0 +1,184 @@
+#include "internal/thread_pool.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+using rock::internal::TaskGroup;
+using rock::internal::ThreadPool;
+using rock::internal::ThreadPoolConfig;
+
+namespace
+{
+
+// Fork-join recursion, with every call but the leaves starting two tasks and waiting for them
+auto count_leaves(ThreadPool* pool, int depth) -> long
+{
+    if (depth == 0)
+        return 1;
+
+    auto left = long{};
+    auto right = long{};
+    auto tasks = TaskGroup{pool};
+    tasks.run([&] { left = count_leaves(pool, depth - 1); });
+    tasks.run([&] { right = count_leaves(pool, depth - 1); });
+    tasks.wait();
+    return left + right;
+}
+
+template <typename F>
+auto time_per_task_ns(std::size_t num_tasks, F&& f) -> double
+{
+    auto const t_begin = Clock::now();
+    f();
+    auto const duration = ch::duration<double, std::nano>(Clock::now() - t_begin).count();
+    return duration / static_cast<double>(num_tasks);
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::ThreadPool")
+{
+    auto pool = ThreadPool{ThreadPoolConfig{4}};
+    CHECK(pool.num_threads() == 4);
+
+    // Every task runs once
+    auto counts = std::vector<std::atomic<int>>(10000);
+    auto tasks = TaskGroup{&pool};
+    for (auto& count : counts)
+        tasks.run([&count] { ++count; });
+    tasks.wait();
+    for (auto const& count : counts)
+        CHECK(count == 1);
+
+    // Tasks can wait on tasks of their own
+    CHECK(count_leaves(&pool, 12) == 4096);
+    CHECK(count_leaves(nullptr, 12) == 4096);
+
+    // The first exception is rethrown, after all the tasks are done
+    auto num_done = std::atomic<int>{};
+    auto failing = TaskGroup{&pool};
+    for (auto i = 0; i < 100; ++i)
+    {
+        failing.run([&, i] {
+            ++num_done;
+            if (i % 10 == 0)
+                throw std::runtime_error{"failed"};
+        });
+    }
+    CHECK_THROWS_AS(failing.wait(), std::runtime_error);
+    CHECK(num_done == 100);
+
+    // A full global queue makes the submitting thread run the task
+    auto small_pool = ThreadPool{ThreadPoolConfig{1, false, 1}};
+    auto const submitter = std::this_thread::get_id();
+    auto ran_on_submitter = std::atomic<int>{};
+    auto release = std::atomic<bool>{};
+    auto blocking = TaskGroup{&small_pool};
+    blocking.run([&] {
+        while (!release)
+            std::this_thread::yield();
+    });
+    for (auto i = 0; i < 10; ++i)
+    {
+        blocking.run([&] {
+            if (std::this_thread::get_id() == submitter)
+                ++ran_on_submitter;
+        });
+    }
+    release = true;
+    blocking.wait();
+    CHECK(ran_on_submitter >= 8);
+
+    // Tasks that run until stopped are queued even when there is no room, and never run on the
+    // submitting thread before they are stopped, as it would then never get to stop them
+    auto unbounded_pool = ThreadPool{ThreadPoolConfig{2, false, 0}};
+    auto stop = std::atomic<bool>{};
+    auto num_started = std::atomic<int>{};
+    auto helpers = TaskGroup{&unbounded_pool};
+    for (auto i = 0; i < 4; ++i)
+    {
+        helpers.run_until_stopped([&] {
+            CHECK((stop || std::this_thread::get_id() != submitter));
+            ++num_started;
+            while (!stop)
+                std::this_thread::yield();
+        });
+    }
+    while (num_started < 2)
+        std::this_thread::yield();
+    stop = true;
+    helpers.wait();
+    CHECK(num_started == 4);
+
+    // Waiting on a group never runs the tasks of another group
+    auto other = TaskGroup{&unbounded_pool};
+    auto other_ran_on_waiter = std::atomic<bool>{};
+    auto own = TaskGroup{&unbounded_pool};
+    auto release_own = std::atomic<bool>{};
+    own.run_until_stopped([&] {
+        while (!release_own)
+            std::this_thread::yield();
+    });
+    own.run_until_stopped([&] {
+        while (!release_own)
+            std::this_thread::yield();
+    });
+    for (auto i = 0; i < 10; ++i)
+    {
+        other.run_until_stopped([&] {
+            if (std::this_thread::get_id() == submitter)
+                other_ran_on_waiter = true;
+        });
+    }
+    auto releaser = std::thread{[&] {
+        std::this_thread::sleep_for(ch::milliseconds{20});
+        release_own = true;
+    }};
+    own.wait();
+    releaser.join();
+    other.wait();
+    CHECK_FALSE(other_ran_on_waiter);
+}
+
+TEST_CASE("rock::internal::ThreadPool_speed")
+{
+    constexpr auto num_tasks = std::size_t{100000};
+    auto const num_threads = std::size_t{std::max(4u, std::thread::hardware_concurrency())};
+    auto pool = ThreadPool{ThreadPoolConfig{num_threads, false, num_tasks}};
+
+    auto counter = std::atomic<std::size_t>{};
+    auto const submit_from_outside = time_per_task_ns(num_tasks, [&] {
+        auto tasks = TaskGroup{&pool};
+        for (auto i = std::size_t{}; i < num_tasks; ++i)
+            tasks.run([&] { ++counter; });
+        tasks.wait();
+    });
+
+    auto const fork_join = time_per_task_ns(std::size_t{2} << 16, [&] {
+        auto tasks = TaskGroup{&pool};
+        tasks.run([&] { count_leaves(&pool, 16); });
+        tasks.wait();
+    });
+
+    constexpr auto num_thread_tasks = std::size_t{1000};
+    auto const thread_per_task = time_per_task_ns(num_thread_tasks, [&] {
+        for (auto i = std::size_t{}; i < num_thread_tasks; ++i)
+            std::thread{[&] { ++counter; }}.join();
+    });
+
+    fmt::print(
+        "Task overhead [threads = {}]: submitted from outside = {:.0f}ns, fork-join from "
+        "inside = {:.0f}ns, std::thread per task = {:.0f}ns [checksum = {}]\n",
+        num_threads,
+        submit_from_outside,
+        fork_join,
+        thread_per_task,
+        counter.load());
+}
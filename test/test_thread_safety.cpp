@@ -0,0 +1,65 @@
+#include "doctest_formatting.h"
+#include "example_boards.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+auto analyze_all(int depth) -> std::vector<rock::PositionAnalysis>
+{
+    auto res = std::vector<rock::PositionAnalysis>{};
+    for (auto const& board : random_game_boards_10_moves)
+        res.push_back(rock::analyze_position({board, rock::Player::White}, depth));
+    return res;
+}
+
+}  // namespace
+
+TEST_CASE("rock::analyze_position_concurrently")
+{
+    constexpr auto depth = 5;
+    constexpr auto num_threads = 8;
+
+    auto const expected = analyze_all(depth);
+
+    auto results = std::vector<std::vector<rock::PositionAnalysis>>(num_threads);
+    auto threads = std::vector<std::thread>{};
+    for (auto t = 0; t < num_threads; ++t)
+        threads.emplace_back([&results, t] { results[t] = analyze_all(depth); });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto const& result : results)
+    {
+        REQUIRE(result.size() == expected.size());
+        for (auto i = std::size_t{}; i < result.size(); ++i)
+        {
+            CHECK(result[i].best_move == expected[i].best_move);
+            CHECK(result[i].score == expected[i].score);
+            CHECK(result[i].principal_variation == expected[i].principal_variation);
+        }
+    }
+}
+
+TEST_CASE("rock::release_analysis_memory")
+{
+    constexpr auto depth = 4;
+    auto const expected = analyze_all(depth);
+
+    // The analyses allocate the table again, and give the same results from an empty one
+    rock::release_analysis_memory();
+    auto const result = analyze_all(depth);
+    REQUIRE(result.size() == expected.size());
+    for (auto i = std::size_t{}; i < result.size(); ++i)
+    {
+        CHECK(result[i].best_move == expected[i].best_move);
+        CHECK(result[i].score == expected[i].score);
+    }
+    rock::release_analysis_memory();
+
+    // A thread that has not analyzed anything has nothing to release
+    std::thread{[] { rock::release_analysis_memory(); }}.join();
+}
@@ -0,0 +1,173 @@
+#include "example_boards.h"
+#include "internal/time_manager.h"
+#include "rock/algorithms.h"
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+
+namespace ch = std::chrono;
+using Clock = ch::steady_clock;
+
+namespace
+{
+
+struct LatencyRange
+{
+    ch::microseconds min{ch::microseconds::max()};
+    ch::microseconds max{};
+};
+
+template <typename F>
+auto measure_latency(char const* name, F&& analyze) -> LatencyRange
+{
+    auto range = LatencyRange{};
+
+    for (auto const& board : assorted_random_game_boards)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+
+        auto const t_begin = Clock::now();
+        auto const analysis = analyze(position);
+        auto const latency = ch::duration_cast<ch::microseconds>(Clock::now() - t_begin);
+
+        range.min = std::min(range.min, latency);
+        range.max = std::max(range.max, latency);
+
+        if (rock::get_game_outcome(position) == rock::GameOutcome::Ongoing)
+        {
+            REQUIRE(analysis.best_move.has_value());
+            CHECK(rock::is_move_legal(*analysis.best_move, position));
+            REQUIRE_FALSE(analysis.principal_variation.empty());
+            CHECK(analysis.principal_variation.front() == *analysis.best_move);
+        }
+    }
+
+    fmt::print("{} [latency = {}us .. {}us]\n", name, range.min.count(), range.max.count());
+
+    return range;
+}
+
+}  // namespace
+
+TEST_CASE("rock::internal::TimeManager")
+{
+    using rock::internal::TimeManager;
+    auto const t0 = rock::internal::SearchClock::now();
+    auto const ms = [&](int n) { return t0 + ch::milliseconds{n}; };
+
+    auto limits = rock::SearchLimits{};
+    CHECK_FALSE(TimeManager(limits, t0).hard_deadline().has_value());
+    CHECK(TimeManager(limits, t0).should_start_next_iteration(ms(100000)));
+
+    // Iterations taking 1, 4, 16, 64ms: the next one would take about 256ms
+    limits.move_time = ch::milliseconds{100};
+    auto manager = TimeManager(limits, t0);
+    CHECK(manager.hard_deadline() == ms(100));
+    CHECK(manager.should_start_next_iteration(ms(1)));
+    CHECK(manager.should_start_next_iteration(ms(5)));
+    CHECK(manager.should_start_next_iteration(ms(21)));
+    CHECK_FALSE(manager.should_start_next_iteration(ms(85)));
+
+    // A clock is spread over the remaining moves, with most of the increment added on
+    limits = rock::SearchLimits{};
+    limits.clock = rock::ClockState{ch::milliseconds{60000}, ch::milliseconds{1000}, 10};
+    manager = TimeManager(limits, t0);
+    REQUIRE(manager.hard_deadline().has_value());
+    CHECK(*manager.hard_deadline() > ms(6000));
+    CHECK(*manager.hard_deadline() < ms(60000));
+    CHECK(manager.should_start_next_iteration(ms(1000)));
+    CHECK_FALSE(manager.should_start_next_iteration(ms(7000)));
+
+    // The tightest of the limits applies
+    limits.move_time = ch::milliseconds{50};
+    CHECK(TimeManager(limits, t0).hard_deadline() == ms(50));
+}
+
+TEST_CASE("rock::analyze_position_with_time_limit")
+{
+    measure_latency("rock::analyze_position (depth = 6)              ", [](auto const& position) {
+        return rock::analyze_position(position, 6);
+    });
+
+    auto limits = rock::SearchLimits{};
+    limits.move_time = ch::milliseconds{20};
+
+    auto const range = measure_latency(
+        "rock::analyze_position (move_time = 20ms)      ",
+        [&](auto const& position) { return rock::analyze_position(position, limits); });
+
+    // The deadline is polled often enough that it is only overrun by a little, though leave
+    // plenty of room for a loaded machine
+    CHECK(range.max < ch::milliseconds{120});
+
+    limits = rock::SearchLimits{};
+    limits.clock = rock::ClockState{ch::milliseconds{1000}, ch::milliseconds{10}};
+
+    measure_latency(
+        "rock::analyze_position (clock = 1000ms + 10ms) ",
+        [&](auto const& position) { return rock::analyze_position(position, limits); });
+
+    // A depth limit still applies alongside a time limit, and gives the same result as a plain
+    // depth-limited search
+    limits = rock::SearchLimits{};
+    limits.depth = 4;
+    limits.move_time = ch::milliseconds{60000};
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        auto const timed = rock::analyze_position(position, limits);
+        auto const fixed = rock::analyze_position(position, 4);
+        CHECK(timed.best_move == fixed.best_move);
+        CHECK(timed.score == fixed.score);
+    }
+}
+
+TEST_CASE("rock::GameAnalyzer_with_time_limit")
+{
+    auto analyzer = rock::GameAnalyzer{};
+    auto const position = rock::Position{assorted_random_game_boards[0], rock::Player::White};
+
+    auto limits = rock::SearchLimits{};
+    limits.move_time = ch::milliseconds{30};
+
+    auto const t_begin = Clock::now();
+    analyzer.analyze_position(position, limits);
+    analyzer.wait_for_analysis();
+    auto const duration = Clock::now() - t_begin;
+
+    CHECK(duration < ch::milliseconds{130});
+    auto const analysis = analyzer.best_analysis_so_far();
+    REQUIRE(analysis.best_move.has_value());
+    CHECK(rock::is_move_legal(*analysis.best_move, position));
+}
+
+TEST_CASE("rock::analyze_position_with_node_limit")
+{
+    auto limits = rock::SearchLimits{};
+    limits.nodes = 20000;
+
+    for (auto const& board : random_game_boards_10_moves)
+    {
+        auto const position = rock::Position{board, rock::Player::White};
+        auto const first = rock::analyze_position(position, limits);
+        auto const second = rock::analyze_position(position, limits);
+
+        // The limit is exact, apart from finishing off the line being searched when it is hit
+        CHECK(first.nodes > 0);
+        CHECK(first.nodes <= *limits.nodes + 100);
+
+        // And the result only depends on the number of nodes, not on how fast they were searched
+        CHECK(first.nodes == second.nodes);
+        CHECK(first.best_move == second.best_move);
+        CHECK(first.score == second.score);
+        CHECK(first.principal_variation == second.principal_variation);
+    }
+
+    // Without a limit, the count covers every depth
+    auto const position = rock::Position{random_game_boards_10_moves[0], rock::Player::White};
+    auto const depth_3 = rock::analyze_position(position, 3);
+    auto const depth_4 = rock::analyze_position(position, 4);
+    CHECK(depth_3.nodes > 0);
+    CHECK(depth_4.nodes > depth_3.nodes);
+}
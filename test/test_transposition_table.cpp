@@ -0,0 +1,26 @@
+#include "example_boards.h"
+#include "internal/transposition_table.h"
+#include <doctest/doctest.h>
+
+TEST_CASE("rock::internal::TranspositionTable::age")
+{
+    auto table = rock::internal::TranspositionTable(10);
+    auto const friends = rock::u64{random_game_boards_10_moves[0][rock::Player::White]};
+    auto const enemies = rock::u64{random_game_boards_10_moves[0][rock::Player::Black]};
+
+    table.update(friends, enemies, [&](rock::internal::TranspositionTable::Value& value, bool) {
+        value.set_key(friends, enemies);
+        value.generation = table.generation();
+    });
+
+    // An entry stays old however many times the table is aged after it, as in a long game with
+    // pondering, which ages the table on every move
+    for (auto i = 0; i < 1000; ++i)
+    {
+        table.age();
+        CHECK(table.load(friends, enemies)->generation != table.generation());
+    }
+
+    table.reset();
+    CHECK(table.generation() == 0);
+}
@@ -0,0 +1,213 @@
+/**
+ * Builds opening books for `rock::load_opening_book`.
+ *
+ * Starting from the starting position, every position of the book is analyzed with a search of
+ * each available move. Of the few best moves, those that score within a margin of the best one go
+ * into the book, weighted by how close they come. The positions they lead to are analyzed in turn,
+ * up to the given number of moves from the start. Symmetric positions are analyzed once, as the
+ * book stores them together.
+ *
+ * An existing book can be merged in, for example to combine books built from different searches,
+ * or with statistics from played games.
+ */
+
+#include "command_line.h"
+#include "internal/opening_book.h"
+#include "rock/algorithms.h"
+#include "rock/executor.h"
+#include "rock/starting_position.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace rock;
+using namespace rock::internal;
+using namespace rock::tools;
+
+namespace
+{
+
+struct Options
+{
+    std::string output_path{};
+    std::string merge_path{};
+    int max_plies{6};
+    int depth{6};
+    std::size_t moves_per_position{3};
+    ScoreType margin{20};
+    std::size_t num_threads{};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_book <output> [--plies <n>] [--depth <n>] [--moves <n>] "
+                 "[--margin <score>] [--threads <n>] [--merge <book>]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--plies" && has_value)
+            options.max_plies = std::stoi(argv[++i]);
+        else if (arg == "--depth" && has_value)
+            options.depth = std::stoi(argv[++i]);
+        else if (arg == "--moves" && has_value)
+            options.moves_per_position = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg == "--margin" && has_value)
+            options.margin = std::max(ScoreType{}, ScoreType{std::stoll(argv[++i])});
+        else if (arg == "--threads" && has_value)
+            options.num_threads = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--merge" && has_value)
+            options.merge_path = argv[++i];
+        else if (options.output_path.empty() && is_positional_argument(arg))
+            options.output_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.output_path.empty() || options.max_plies < 1 || options.depth < 1)
+        return std::nullopt;
+
+    return options;
+}
+
+/**
+ * The best move gets a weight of 100, falling to 1 for a move that scores `margin` less
+ */
+auto weight_for(ScoreType loss, ScoreType margin) -> u32
+{
+    if (margin == 0)
+        return 100;
+    return static_cast<u32>(1 + (margin - loss) * 99 / margin);
+}
+
+/**
+ * Add the good moves of the position to the book, and return the positions they lead to
+ */
+auto add_position(
+    OpeningBookBuilder& builder,
+    Position const& position,
+    Options const& options,
+    Executor& executor) -> std::vector<Position>
+{
+    auto const analyses = analyze_available_moves(
+        position, options.depth, options.moves_per_position, &executor);
+
+    // Only the best moves have exact scores, and those end a game or have a principal variation.
+    // The scores are from white's point of view.
+    auto const sign = position.player_to_move() == Player::White ? 1 : -1;
+    auto scored_moves = std::vector<std::pair<ScoreType, Move>>{};
+    for (auto const& [move, analysis] : analyses)
+    {
+        bool const is_exact = !analysis.principal_variation.empty() ||
+            get_game_outcome(apply_move(move, position)) != GameOutcome::Ongoing;
+        if (is_exact)
+            scored_moves.emplace_back(sign * analysis.score, move);
+    }
+
+    std::sort(scored_moves.begin(), scored_moves.end(), [](auto const& a, auto const& b) {
+        return a.first > b.first;
+    });
+    if (scored_moves.size() > options.moves_per_position)
+        scored_moves.resize(options.moves_per_position);
+
+    auto next_positions = std::vector<Position>{};
+    for (auto const& [score, move] : scored_moves)
+    {
+        auto const loss = scored_moves.front().first - score;
+        if (loss > options.margin)
+            break;
+
+        builder.add_move(
+            position.friends(),
+            position.enemies(),
+            InternalMove::from(move),
+            weight_for(loss, options.margin));
+        next_positions.push_back(apply_move(move, position));
+    }
+    return next_positions;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto builder = OpeningBookBuilder{};
+        if (!options->merge_path.empty())
+        {
+            auto const book = OpeningBook::open(options->merge_path);
+            if (!book)
+            {
+                std::cerr << fmt::format("Could not read the book '{}'\n", options->merge_path);
+                return 1;
+            }
+            builder.add_book(*book);
+        }
+
+        auto executor = Executor{ExecutorConfig{options->num_threads}};
+        auto const t_begin = std::chrono::steady_clock::now();
+
+        auto seen = std::set<u64>{};
+        auto frontier = std::vector{starting_position};
+        auto num_positions = std::size_t{};
+        for (auto ply = 0; ply < options->max_plies; ++ply)
+        {
+            auto next_frontier = std::vector<Position>{};
+            for (auto const& position : frontier)
+            {
+                if (get_game_outcome(position) != GameOutcome::Ongoing ||
+                    !seen.insert(book_key(position.friends(), position.enemies())).second)
+                    continue;
+
+                ++num_positions;
+                for (auto const& next : add_position(builder, position, *options, executor))
+                    next_frontier.push_back(next);
+            }
+
+            std::cerr << fmt::format(
+                "Ply {}: {} positions, {} moves in the book\n",
+                ply + 1,
+                num_positions,
+                builder.num_moves());
+            frontier = std::move(next_frontier);
+        }
+
+        builder.write(options->output_path);
+        auto const duration = std::chrono::steady_clock::now() - t_begin;
+
+        std::cerr << fmt::format(
+            "Wrote {} moves of {} positions to {} in {:.1f}s\n",
+            builder.num_moves(),
+            num_positions,
+            options->output_path,
+            std::chrono::duration<double>(duration).count());
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/**
+ * Parsing the command lines of the tools
+ */
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace rock::tools
+{
+
+/**
+ * Whether the argument is a positional one, such as a path, rather than an option
+ */
+inline auto is_positional_argument(std::string const& arg) -> bool
+{
+    return !arg.empty() && arg.front() != '-';
+}
+
+/**
+ * The options parsed from the command line by the function, or nothing if they are invalid. The
+ * function returns nothing for an invalid option, and may throw `std::invalid_argument` or
+ * `std::out_of_range` for a value that is not a number, as `std::stoi` and the like do.
+ */
+template <typename Parse>
+auto parse_command_line(int argc, char** argv, Parse&& parse) -> decltype(parse(argc, argv))
+{
+    try
+    {
+        return parse(argc, argv);
+    }
+    catch (std::invalid_argument const&)
+    {
+        return std::nullopt;
+    }
+    catch (std::out_of_range const&)
+    {
+        return std::nullopt;
+    }
+}
+
+}  // namespace rock::tools
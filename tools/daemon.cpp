@@ -0,0 +1,296 @@
+/**
+ * Serves analyses to many clients over a Unix-domain socket, so that one process with one pool of
+ * threads and one transposition table (see `AnalysisService`) stands in for an engine process per
+ * client.
+ *
+ * Each client sends requests as lines of text, and may have many of them running at once, each
+ * named by a tag of its choosing:
+ *
+ *     analyze <tag> <fen> <w|b> [depth <n>] [nodes <n>] [movetime <ms>]
+ *     cancel <tag>
+ *
+ * Each analysis is answered, in the order they finish, with
+ *
+ *     result <tag> bestmove <m|(none)> score <n> nodes <n> pv <m>...
+ *
+ * with the score from the point of view of the player to move. A cancelled analysis is answered
+ * with what it found before it stopped. A request that cannot be carried out is answered with
+ *
+ *     error <tag> <message>
+ *
+ * The analyses of a client that disconnects are cancelled.
+ */
+
+#include "command_line.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/format.h"
+#include "rock/parse.h"
+#include "unix_socket.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace rock;
+using namespace rock::tools;
+
+namespace
+{
+
+struct Options
+{
+    std::string socket_path{};
+    std::size_t num_threads{std::max(1u, std::thread::hardware_concurrency())};
+    AnalysisServiceConfig service{};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_daemon <socket> [--threads <n>] [--table-mb <n>] [--symmetric]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--threads" && has_value)
+            options.num_threads = std::max(std::size_t{1}, std::size_t{std::stoul(argv[++i])});
+        else if (arg == "--table-mb" && has_value)
+            options.service.table_megabytes = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--symmetric")
+            options.service.symmetric_transpositions = true;
+        else if (options.socket_path.empty() && is_positional_argument(arg))
+            options.socket_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.socket_path.empty())
+        return std::nullopt;
+    return options;
+}
+
+/**
+ * A connected client, shared by the thread reading its requests and the callbacks of its analyses
+ */
+struct Client
+{
+    explicit Client(Socket s) : socket{std::move(s)} {}
+
+    auto send(std::string const& line) -> void
+    {
+        auto const lock = std::lock_guard{send_mutex};
+        send_line(socket, line);
+    }
+
+    Socket socket;
+    std::mutex send_mutex{};
+
+    // The analyses that have not been answered yet, by tag
+    std::mutex pending_mutex{};
+    std::unordered_map<std::string, AnalysisService::RequestId> pending{};
+};
+
+auto format_result(
+    std::string const& tag, Position const& position, PositionAnalysis const& analysis)
+    -> std::string
+{
+    auto const score =
+        position.player_to_move() == Player::White ? analysis.score : -analysis.score;
+    auto line = fmt::format(
+        "result {} bestmove {} score {} nodes {} pv",
+        tag,
+        analysis.best_move ? to_string(*analysis.best_move) : std::string{"(none)"},
+        score,
+        analysis.nodes);
+    for (auto const move : analysis.principal_variation)
+        line += ' ' + to_string(move);
+    return line;
+}
+
+/**
+ * Start the analysis of a request, with limits that start from the base limits
+ */
+auto analyze(
+    std::shared_ptr<Client> const& client,
+    AnalysisService& service,
+    SearchLimits const& base_limits,
+    std::istringstream& args) -> void
+{
+    auto tag = std::string{};
+    auto fen = std::string{};
+    auto side = std::string{};
+    args >> tag >> fen >> side;
+
+    auto const board = parse_fen_to_board(fen);
+    auto const player = parse_player(side);
+    if (tag.empty() || !board || !player)
+    {
+        client->send(fmt::format("error {} invalid position", tag.empty() ? "-" : tag));
+        return;
+    }
+    auto const position = Position{*board, *player};
+
+    auto limits = base_limits;
+    auto name = std::string{};
+    auto value = std::string{};
+    try
+    {
+        while (args >> name >> value)
+        {
+            if (name == "depth")
+                limits.depth = std::stoi(value);
+            else if (name == "nodes")
+                limits.nodes = u64{std::stoull(value)};
+            else if (name == "movetime")
+                limits.move_time = std::chrono::milliseconds{std::stoll(value)};
+            else
+                throw std::invalid_argument{name};
+        }
+    }
+    catch (std::exception const&)
+    {
+        client->send(fmt::format("error {} invalid limit '{}'", tag, name));
+        return;
+    }
+
+    // The tag is taken before submitting, and given the analysis once it is known, as the
+    // analysis may be answered before `submit` returns
+    {
+        auto const lock = std::lock_guard{client->pending_mutex};
+        if (!client->pending.emplace(tag, AnalysisService::RequestId{}).second)
+        {
+            client->send(fmt::format("error {} tag already in use", tag));
+            return;
+        }
+    }
+
+    auto const id = service.submit(
+        position, limits, [client, tag, position](auto, PositionAnalysis const& analysis) {
+            {
+                auto const lock = std::lock_guard{client->pending_mutex};
+                client->pending.erase(tag);
+            }
+            client->send(format_result(tag, position, analysis));
+        });
+
+    auto const lock = std::lock_guard{client->pending_mutex};
+    if (auto const it = client->pending.find(tag); it != client->pending.end())
+        it->second = id;
+}
+
+auto cancel(Client& client, AnalysisService& service, std::istringstream& args) -> void
+{
+    auto tag = std::string{};
+    args >> tag;
+
+    auto const lock = std::lock_guard{client.pending_mutex};
+    auto const it = client.pending.find(tag);
+    if (it == client.pending.end())
+    {
+        client.send(fmt::format("error {} no such analysis", tag.empty() ? "-" : tag));
+        return;
+    }
+    service.cancel(it->second);
+}
+
+auto serve(
+    std::shared_ptr<Client> const& client,
+    AnalysisService& service,
+    SearchLimits const& base_limits) -> void
+{
+    auto reader = LineReader{client->socket};
+    while (auto const line = reader.read_line())
+    {
+        auto args = std::istringstream{*line};
+        auto command = std::string{};
+        if (!(args >> command))
+            continue;
+
+        if (command == "analyze")
+            analyze(client, service, base_limits, args);
+        else if (command == "cancel")
+            cancel(*client, service, args);
+        else
+            client->send(fmt::format("error - unknown command '{}'", command));
+    }
+
+    auto const lock = std::lock_guard{client->pending_mutex};
+    for (auto const& [tag, id] : client->pending)
+        service.cancel(id);
+}
+
+std::string socket_path_to_remove{};
+
+auto remove_socket_and_exit(int) -> void
+{
+    ::unlink(socket_path_to_remove.c_str());
+    std::_Exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto executor = Executor{ExecutorConfig{options->num_threads}};
+        auto service = AnalysisService{executor, options->service};
+        auto base_limits = SearchLimits{};
+        base_limits.symmetric_transpositions = options->service.symmetric_transpositions;
+        auto const listener = listen_on_unix_socket(options->socket_path);
+
+        socket_path_to_remove = options->socket_path;
+        std::signal(SIGINT, remove_socket_and_exit);
+        std::signal(SIGTERM, remove_socket_and_exit);
+        std::cerr << fmt::format(
+            "Listening on {} with {} threads\n", options->socket_path, executor.num_threads());
+
+        // One thread per client, reading its requests, while the analyses run on the executor.
+        // The process only ends on a signal, so the threads are never joined.
+        while (true)
+        {
+            auto const fd = ::accept(listener.fd(), nullptr, nullptr);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                throw std::runtime_error(fmt::format("Could not accept: {}", strerror(errno)));
+            }
+
+            auto client = std::make_shared<Client>(Socket{fd});
+            std::thread{[client, &service, &base_limits] {
+                serve(client, service, base_limits);
+            }}.detach();
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,443 @@
+/**
+ * Runs the engine as a subprocess that talks a line protocol over stdin and stdout, modeled on
+ * UCI, so that front-ends can drive it the way they drive chess engines.
+ *
+ * Commands, one per line:
+ *
+ *     uci                               identify the engine, answered with "uciok"
+ *     isready                           answered with "readyok"
+ *     setoption name <name> value <v>   one of the options listed in answer to "uci"
+ *     ucinewgame                        stop any search, and forget the previous game
+ *     position startpos [moves <m>...]
+ *     position fen <fen> <w|b> [moves <m>...]
+ *     go [depth <n>] [nodes <n>] [movetime <ms>] [wtime <ms>] [btime <ms>] [winc <ms>]
+ *        [binc <ms>] [movestogo <n>] [infinite] [ponder]
+ *     stop                              stop the search, which then reports its move
+ *     ponderhit                         the opponent made the move that was pondered
+ *     quit
+ *
+ * Moves are written as by `to_string(Move)`, such as "b1-h1", and read by `parse_move`.
+ *
+ * The search runs in the background, so that the engine keeps reading commands. Each depth it
+ * completes is reported with a line of the form
+ *
+ *     info depth <n> score <cp <n>|win|loss> nodes <n> time <ms> nps <n> pv <m>...
+ *
+ * with the score from the point of view of the player to move, and the search ends with
+ *
+ *     bestmove <m> [ponder <m>]
+ *
+ * or "bestmove (none)" if there is no move. An infinite or pondering search only reports its move
+ * after "stop" or "ponderhit", even if it ends before.
+ *
+ * To ponder, the position sent with "go ponder" must be the one after the move the engine
+ * recommended and the reply it gave after "ponder". The search then picks up from the last one.
+ * For any other position, the search starts afresh and its limits apply from the start.
+ */
+
+#include "internal/move_generation.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/format.h"
+#include "rock/parse.h"
+#include "rock/starting_position.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace rock;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Engine
+{
+    Engine();
+
+    auto run() -> void;
+
+private:
+    auto uci() -> void;
+    auto set_option(std::istringstream& args) -> void;
+    auto new_game() -> void;
+    auto set_position(std::istringstream& args) -> void;
+    auto go(std::istringstream& args) -> void;
+    auto stop() -> void;
+    auto ponder_hit() -> void;
+
+    // Called from the worker thread of the analyzer
+    auto report_depth() -> void;
+    auto finish_search() -> void;
+
+    // Must be called with the mutex held
+    auto send(std::string const& line) -> void;
+    auto send_best_move() -> void;
+
+    GameAnalyzer analyzer_{};
+
+    // Guards the state of the search and the output, which the worker thread of the analyzer
+    // shares with the thread reading commands. It is never held while waiting for the analyzer.
+    std::mutex mutex_{};
+
+    Position position_{starting_position};
+
+    // The position before the last move sent with it, and that move, to ponder on
+    std::optional<Position> previous_position_{};
+    std::optional<Move> last_move_{};
+
+    bool is_searching_{};
+    bool has_search_finished_{};
+    bool is_infinite_{};
+    bool is_pondering_{};
+    Player searched_player_{};
+    Clock::time_point search_begin_{};
+};
+
+Engine::Engine()
+{
+    analyzer_.set_report_callback([this](GameAnalyzer&) { report_depth(); });
+    analyzer_.set_finished_callback([this](GameAnalyzer&) { finish_search(); });
+}
+
+auto Engine::run() -> void
+{
+    auto line = std::string{};
+    while (std::getline(std::cin, line))
+    {
+        auto args = std::istringstream{line};
+        auto command = std::string{};
+        if (!(args >> command))
+            continue;
+
+        if (command == "uci")
+            uci();
+        else if (command == "isready")
+        {
+            auto const lock = std::lock_guard{mutex_};
+            send("readyok");
+        }
+        else if (command == "setoption")
+            set_option(args);
+        else if (command == "ucinewgame")
+            new_game();
+        else if (command == "position")
+            set_position(args);
+        else if (command == "go")
+            go(args);
+        else if (command == "stop")
+            stop();
+        else if (command == "ponderhit")
+            ponder_hit();
+        else if (command == "quit")
+            break;
+        else
+        {
+            auto const lock = std::lock_guard{mutex_};
+            send(fmt::format("info string unknown command '{}'", command));
+        }
+    }
+
+    // A search in progress, even an infinite or pondering one, still reports its move
+    stop();
+    analyzer_.wait_for_analysis();
+}
+
+auto Engine::uci() -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    send("id name rock");
+    send("option name MaxDepth type spin default 100 min 1 max 100");
+    send("option name EvaluationNetwork type string default <empty>");
+    send("option name Tablebase type string default <empty>");
+    send("uciok");
+}
+
+auto Engine::set_option(std::istringstream& args) -> void
+{
+    auto token = std::string{};
+    auto name = std::string{};
+    auto value = std::string{};
+    args >> token >> name >> token;
+    std::getline(args >> std::ws, value);
+
+    // An empty value, or none at all, clears the option
+    auto const is_empty = value.empty() || value == "<empty>";
+    auto is_ok = true;
+    if (name == "MaxDepth")
+    {
+        try
+        {
+            analyzer_.set_max_depth(std::stoi(value));
+        }
+        catch (std::exception const&)
+        {
+            is_ok = false;
+        }
+    }
+    else if (name == "EvaluationNetwork")
+    {
+        if (is_empty)
+            clear_evaluation_network();
+        else
+            is_ok = load_evaluation_network(value);
+    }
+    else if (name == "Tablebase")
+    {
+        if (is_empty)
+            clear_tablebase();
+        else
+            is_ok = load_tablebase(value);
+    }
+    else
+        is_ok = false;
+
+    if (!is_ok)
+    {
+        auto const lock = std::lock_guard{mutex_};
+        send(fmt::format("info string could not set option '{}' to '{}'", name, value));
+    }
+}
+
+auto Engine::new_game() -> void
+{
+    stop();
+    analyzer_.wait_for_analysis();
+
+    auto const lock = std::lock_guard{mutex_};
+    position_ = starting_position;
+    previous_position_.reset();
+    last_move_.reset();
+}
+
+auto Engine::set_position(std::istringstream& args) -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+
+    auto token = std::string{};
+    args >> token;
+
+    auto position = starting_position;
+    if (token == "fen")
+    {
+        auto fen = std::string{};
+        auto side = std::string{};
+        args >> fen >> side;
+
+        auto const board = parse_fen_to_board(fen);
+        auto const player = parse_player(side);
+        if (!board || !player)
+        {
+            send(fmt::format("info string invalid position '{} {}'", fen, side));
+            return;
+        }
+        position = Position{*board, *player};
+        args >> token;
+    }
+    else if (token == "startpos")
+        args >> token;
+
+    auto previous_position = std::optional<Position>{};
+    auto last_move = std::optional<Move>{};
+    if (token == "moves")
+    {
+        while (args >> token)
+        {
+            auto const move = parse_move(token);
+            if (!move || !is_move_legal(*move, position))
+            {
+                send(fmt::format("info string illegal move '{}'", token));
+                return;
+            }
+            previous_position = position;
+            last_move = move;
+            position = apply_move(*move, position);
+        }
+    }
+
+    position_ = position;
+    previous_position_ = previous_position;
+    last_move_ = last_move;
+}
+
+auto Engine::go(std::istringstream& args) -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    if (is_searching_)
+    {
+        send("info string already searching");
+        return;
+    }
+
+    auto limits = SearchLimits{};
+    auto time = std::optional<std::chrono::milliseconds>{};
+    auto increment = std::chrono::milliseconds{};
+    auto moves_to_go = std::optional<int>{};
+    auto is_infinite = false;
+    auto is_pondering = false;
+    auto const is_white = position_.player_to_move() == Player::White;
+
+    auto token = std::string{};
+    try
+    {
+        while (args >> token)
+        {
+            auto value = std::string{};
+            if (token == "infinite")
+                is_infinite = true;
+            else if (token == "ponder")
+                is_pondering = true;
+            else if (!(args >> value))
+                break;
+            else if (token == "depth")
+                limits.depth = std::stoi(value);
+            else if (token == "nodes")
+                limits.nodes = u64{std::stoull(value)};
+            else if (token == "movetime")
+                limits.move_time = std::chrono::milliseconds{std::stoll(value)};
+            else if (token == (is_white ? "wtime" : "btime"))
+                time = std::chrono::milliseconds{std::stoll(value)};
+            else if (token == (is_white ? "winc" : "binc"))
+                increment = std::chrono::milliseconds{std::stoll(value)};
+            else if (token == "movestogo")
+                moves_to_go = std::stoi(value);
+        }
+    }
+    catch (std::exception const&)
+    {
+        send(fmt::format("info string invalid value for '{}'", token));
+        return;
+    }
+
+    if (time)
+        limits.clock = ClockState{*time, increment, moves_to_go};
+
+    is_searching_ = true;
+    has_search_finished_ = false;
+    is_infinite_ = is_infinite;
+    is_pondering_ = false;
+    searched_player_ = position_.player_to_move();
+    search_begin_ = Clock::now();
+
+    // Only the reply the last search expected can be pondered on from where that search left off
+    if (is_pondering && previous_position_)
+    {
+        auto const pv = analyzer_.best_analysis_so_far().principal_variation;
+        if (pv.size() >= 2 && pv[1] == *last_move_)
+            is_pondering_ = analyzer_.ponder(*previous_position_, limits).has_value();
+    }
+    if (!is_pondering_)
+        analyzer_.analyze_position(position_, limits);
+
+    // Without the reply, the search runs as usual but still waits for the ponder hit to report
+    is_pondering_ = is_pondering;
+}
+
+auto Engine::stop() -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    if (!is_searching_)
+        return;
+
+    is_infinite_ = false;
+    is_pondering_ = false;
+    if (has_search_finished_)
+        send_best_move();
+    else
+        analyzer_.stop_analysis();
+}
+
+auto Engine::ponder_hit() -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    if (!is_searching_ || !is_pondering_)
+        return;
+
+    is_pondering_ = false;
+    analyzer_.ponder_hit();
+    if (has_search_finished_ && !is_infinite_)
+        send_best_move();
+}
+
+auto Engine::report_depth() -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    auto const analysis = analyzer_.best_analysis_so_far();
+    auto const progress = analyzer_.progress();
+    if (!analysis.best_move)
+        return;
+
+    auto const score = searched_player_ == Player::White ? analysis.score : -analysis.score;
+    auto const score_str = score >= internal::big / 2 ? std::string{"win"}
+        : score <= -internal::big / 2                 ? std::string{"loss"}
+                                                      : fmt::format("cp {}", score);
+
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - search_begin_);
+    auto const nps = static_cast<u64>(
+        static_cast<double>(progress.nodes) / std::max(0.001, elapsed.count() / 1000.0));
+
+    auto line = fmt::format(
+        "info depth {} score {} nodes {} time {} nps {} pv",
+        progress.depth,
+        score_str,
+        progress.nodes,
+        elapsed.count(),
+        nps);
+    for (auto const move : analysis.principal_variation)
+        line += ' ' + to_string(move);
+    send(line);
+}
+
+auto Engine::finish_search() -> void
+{
+    auto const lock = std::lock_guard{mutex_};
+    has_search_finished_ = true;
+    if (!is_infinite_ && !is_pondering_)
+        send_best_move();
+}
+
+auto Engine::send(std::string const& line) -> void
+{
+    std::cout << line << std::endl;
+}
+
+auto Engine::send_best_move() -> void
+{
+    auto const analysis = analyzer_.best_analysis_so_far();
+    auto const& pv = analysis.principal_variation;
+
+    if (!analysis.best_move)
+        send("bestmove (none)");
+    else if (pv.size() >= 2 && pv[0] == *analysis.best_move)
+        send(fmt::format("bestmove {} ponder {}", to_string(pv[0]), to_string(pv[1])));
+    else
+        send(fmt::format("bestmove {}", to_string(*analysis.best_move)));
+
+    is_searching_ = false;
+}
+
+}  // namespace
+
+int main()
+{
+    try
+    {
+        auto engine = Engine{};
+        engine.run();
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
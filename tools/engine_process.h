@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+ * Engines run as subprocesses, such as rock_engine from another build, and talked to a line at a
+ * time over their standard input and output
+ */
+
+#include "unix_socket.h"
+#include <fmt/format.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+extern char** environ;
+
+namespace rock::tools
+{
+
+namespace detail
+{
+    /**
+     * A connected pair of sockets, which are closed in any process started from this one
+     */
+    inline auto make_socket_pair() -> std::pair<Socket, Socket>
+    {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        {
+            throw std::runtime_error(
+                fmt::format("Could not create socket pair: {}", strerror(errno)));
+        }
+        return {Socket{fds[0]}, Socket{fds[1]}};
+    }
+
+    /**
+     * Start the program with the socket as its standard input and output
+     */
+    inline auto spawn_with_socket(std::string const& path, Socket const& socket) -> pid_t
+    {
+        auto actions = posix_spawn_file_actions_t{};
+        ::posix_spawn_file_actions_init(&actions);
+        ::posix_spawn_file_actions_adddup2(&actions, socket.fd(), STDIN_FILENO);
+        ::posix_spawn_file_actions_adddup2(&actions, socket.fd(), STDOUT_FILENO);
+
+        auto program = path;
+        char* argv[] = {program.data(), nullptr};
+        auto pid = pid_t{};
+        auto const error = ::posix_spawn(&pid, path.c_str(), &actions, nullptr, argv, environ);
+        ::posix_spawn_file_actions_destroy(&actions);
+
+        if (error != 0)
+            throw std::runtime_error(fmt::format("Could not run '{}': {}", path, strerror(error)));
+        return pid;
+    }
+}  // namespace detail
+
+/**
+ * A running engine, which is told to quit, and waited for, when this is destroyed
+ */
+struct EngineProcess
+{
+    /**
+     * Throws `std::runtime_error` if the engine cannot be started
+     */
+    explicit EngineProcess(std::string const& path)
+        : EngineProcess{path, detail::make_socket_pair()}
+    {}
+
+    EngineProcess(EngineProcess const&) = delete;
+    auto operator=(EngineProcess const&) -> EngineProcess& = delete;
+
+    ~EngineProcess()
+    {
+        send_line(socket_, "quit");
+        auto status = 0;
+        while (::waitpid(pid_, &status, 0) < 0 && errno == EINTR)
+        {}
+    }
+
+    auto path() const -> std::string const& { return path_; }
+
+    /**
+     * Throws `std::runtime_error` if the engine has exited
+     */
+    auto send(std::string line) -> void
+    {
+        if (!send_line(socket_, std::move(line)))
+            throw std::runtime_error(fmt::format("Engine '{}' has exited", path_));
+    }
+
+    /**
+     * The next line from the engine, without its newline. Throws `std::runtime_error` if the
+     * engine has exited.
+     */
+    auto read_line() -> std::string
+    {
+        auto line = reader_.read_line();
+        if (!line)
+            throw std::runtime_error(fmt::format("Engine '{}' has exited", path_));
+        return std::move(*line);
+    }
+
+private:
+    EngineProcess(std::string const& path, std::pair<Socket, Socket> sockets)
+        : path_{path},
+          socket_{std::move(sockets.first)},
+          reader_{socket_},
+          pid_{detail::spawn_with_socket(path, sockets.second)}
+    {}
+
+    std::string path_;
+    Socket socket_;
+    LineReader reader_;
+    pid_t pid_;
+};
+
+}  // namespace rock::tools
@@ -0,0 +1,104 @@
+/**
+ * Generates endgame tablebases for `rock::load_tablebase`.
+ *
+ * Every position with up to the given number of pieces in total is solved by retrograde analysis
+ * (see `rock::internal::generate_tablebase`), and the tables are written to one file, with a byte
+ * for each position. The sizes grow quickly with the number of pieces:
+ *
+ *     --max-pieces 4:   4 MB (2 vs 2)
+ *     --max-pieces 5: 164 MB (adds 3 vs 2 and 2 vs 3)
+ *     --max-pieces 6: 5.5 GB (adds 4 vs 2, 3 vs 3 and 2 vs 4)
+ */
+
+#include "command_line.h"
+#include "internal/tablebase.h"
+#include "internal/thread_pool.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+
+using namespace rock;
+using namespace rock::internal;
+using namespace rock::tools;
+
+namespace
+{
+
+struct Options
+{
+    std::string output_path{};
+    int max_pieces{4};
+    std::size_t num_threads{std::max(1u, std::thread::hardware_concurrency())};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_tablebase <output> [--max-pieces <n>] [--threads <n>]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--max-pieces" && has_value)
+            options.max_pieces = std::stoi(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            options.num_threads = std::max(std::size_t{1}, std::size_t{std::stoul(argv[++i])});
+        else if (options.output_path.empty() && is_positional_argument(arg))
+            options.output_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.output_path.empty() || options.max_pieces < 4 || options.max_pieces > 24)
+        return std::nullopt;
+
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto size = u64{};
+        for (auto const material : list_tablebase_materials(options->max_pieces))
+            size += tablebase_size(material);
+        std::cerr << fmt::format(
+            "Solving {} positions with up to {} pieces\n", size, options->max_pieces);
+
+        auto pool = ThreadPool{ThreadPoolConfig{options->num_threads}};
+        auto const t_begin = std::chrono::steady_clock::now();
+        generate_tablebase(options->max_pieces, options->output_path, &pool);
+        auto const duration = std::chrono::steady_clock::now() - t_begin;
+
+        std::cerr << fmt::format(
+            "Wrote {} in {:.1f}s\n",
+            options->output_path,
+            std::chrono::duration<double>(duration).count());
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
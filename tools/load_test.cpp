@@ -0,0 +1,257 @@
+/**
+ * Loads the analysis daemon (rock_daemon) with clients that each follow a game, and reports the
+ * latency of their requests.
+ *
+ * Each client connects on its own, and asks for an analysis of each position of its game in turn,
+ * waiting for the answer before playing the recommended move and asking about the next position.
+ * A game starts with a number of random moves from the starting position, and starts over when it
+ * ends. Clients that follow the same game (see --games) ask about the same positions, as when
+ * several users watch one game.
+ *
+ * With --cancel-after, a request that has not been answered in that time is cancelled, which
+ * measures how quickly the daemon gives up on an analysis.
+ */
+
+#include "command_line.h"
+#include "random_opening.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/parse.h"
+#include "unix_socket.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rock;
+using namespace rock::tools;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string socket_path{};
+    std::size_t num_clients{8};
+    std::size_t num_requests{50};
+    std::optional<std::size_t> num_games{};
+    std::string limits{};
+    std::optional<std::chrono::milliseconds> cancel_after{};
+    int random_plies{8};
+    u64 seed{1};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_load_test <socket> [--clients <n>] [--requests <n>] [--games <n>] "
+                 "[--depth <n>] [--nodes <n>] [--movetime <ms>] [--cancel-after <ms>] "
+                 "[--random-plies <n>] [--seed <n>]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--clients" && has_value)
+            options.num_clients = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--requests" && has_value)
+            options.num_requests = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--games" && has_value)
+            options.num_games = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--depth" && has_value)
+            options.limits += fmt::format(" depth {}", std::stoi(argv[++i]));
+        else if (arg == "--nodes" && has_value)
+            options.limits += fmt::format(" nodes {}", std::stoull(argv[++i]));
+        else if (arg == "--movetime" && has_value)
+            options.limits += fmt::format(" movetime {}", std::stoll(argv[++i]));
+        else if (arg == "--cancel-after" && has_value)
+            options.cancel_after = std::chrono::milliseconds{std::stoll(argv[++i])};
+        else if (arg == "--random-plies" && has_value)
+            options.random_plies = std::stoi(argv[++i]);
+        else if (arg == "--seed" && has_value)
+            options.seed = u64{std::stoull(argv[++i])};
+        else if (options.socket_path.empty() && is_positional_argument(arg))
+            options.socket_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.socket_path.empty() || options.num_clients == 0 || options.num_requests == 0 ||
+        options.num_games == std::optional<std::size_t>{0} || options.random_plies < 0)
+        return std::nullopt;
+
+    // Without any limit, a shallow search keeps the requests short
+    if (options.limits.empty())
+        options.limits = " depth 6";
+
+    return options;
+}
+
+struct ClientResults
+{
+    std::vector<double> latencies_ms{};
+    std::size_t num_cancelled{};
+    std::size_t num_errors{};
+};
+
+auto run_client(Options const& options, std::size_t index) -> ClientResults
+{
+    auto const socket = connect_to_unix_socket(options.socket_path);
+    auto reader = LineReader{socket};
+    auto results = ClientResults{};
+
+    auto const game = options.num_games ? index % *options.num_games : index;
+    auto rng = std::mt19937_64{options.seed + game};
+    auto position = random_opening(options.random_plies, rng).current_position();
+
+    for (auto request = std::size_t{}; request < options.num_requests; ++request)
+    {
+        auto const tag = std::to_string(request);
+        auto const t_begin = Clock::now();
+        send_line(
+            socket,
+            fmt::format(
+                "analyze {} {} {}{}",
+                tag,
+                format_as_fen(position.board()),
+                position.player_to_move() == Player::White ? 'w' : 'b',
+                options.limits));
+
+        if (options.cancel_after && !reader.wait_for_line(*options.cancel_after))
+        {
+            send_line(socket, fmt::format("cancel {}", tag));
+            ++results.num_cancelled;
+        }
+
+        // A cancel that arrives after the answer is itself answered with an error, which is
+        // skipped when it comes before the answer to a later request
+        auto kind = std::string{};
+        auto fields = std::istringstream{};
+        while (true)
+        {
+            auto const line = reader.read_line();
+            if (!line)
+                throw std::runtime_error("The daemon closed the connection");
+
+            auto answer_tag = std::string{};
+            fields = std::istringstream{*line};
+            fields >> kind >> answer_tag;
+            if (answer_tag == tag)
+                break;
+        }
+        results.latencies_ms.push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - t_begin).count());
+
+        // result <tag> bestmove <m> ...
+        auto move_str = std::string{};
+        fields >> move_str >> move_str;
+        auto const move = parse_move(move_str);
+
+        if (kind != "result")
+            ++results.num_errors;
+        auto const next_position = move ? apply_move(*move, position) : position;
+        if (kind == "result" && move && get_game_outcome(next_position) == GameOutcome::Ongoing)
+            position = next_position;
+        else
+            position = random_opening(options.random_plies, rng).current_position();
+    }
+    return results;
+}
+
+auto percentile(std::vector<double> const& sorted, double fraction) -> double
+{
+    auto const index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto results = std::vector<ClientResults>(options->num_clients);
+        auto errors = std::vector<std::string>{};
+        auto errors_mutex = std::mutex{};
+        auto threads = std::vector<std::thread>{};
+        auto const t_begin = Clock::now();
+
+        for (auto i = std::size_t{}; i < options->num_clients; ++i)
+        {
+            threads.emplace_back([&, i] {
+                try
+                {
+                    results[i] = run_client(*options, i);
+                }
+                catch (std::exception const& e)
+                {
+                    auto const lock = std::lock_guard{errors_mutex};
+                    errors.push_back(e.what());
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        if (!errors.empty())
+            throw std::runtime_error(errors.front());
+
+        auto const duration =
+            std::chrono::duration<double>(Clock::now() - t_begin).count();
+        auto latencies = std::vector<double>{};
+        auto num_cancelled = std::size_t{};
+        auto num_errors = std::size_t{};
+        for (auto const& client : results)
+        {
+            latencies.insert(
+                latencies.end(), client.latencies_ms.begin(), client.latencies_ms.end());
+            num_cancelled += client.num_cancelled;
+            num_errors += client.num_errors;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << fmt::format(
+            "{} requests from {} clients in {:.1f}s ({:.1f} requests/s), {} cancelled, {} "
+            "errors\n"
+            "Latency: p50 {:.1f}ms, p90 {:.1f}ms, p99 {:.1f}ms, max {:.1f}ms\n",
+            latencies.size(),
+            options->num_clients,
+            duration,
+            static_cast<double>(latencies.size()) / duration,
+            num_cancelled,
+            num_errors,
+            percentile(latencies, 0.5),
+            percentile(latencies, 0.9),
+            percentile(latencies, 0.99),
+            latencies.back());
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,467 @@
+/**
+ * Plays a match between two configurations of the engine, to tell whether one is stronger.
+ *
+ * The games start from pairs of opening positions, either read from a file or made by a number of
+ * random moves from the starting position, and each opening is played twice, with each side
+ * playing each color once, so that an unbalanced opening favors neither. The games are played in
+ * parallel, one per thread. Games that go on for too long are counted as draws.
+ *
+ * The results are reported from the point of view of the first configuration, as an Elo
+ * difference with a 95% confidence interval. Unless it is disabled, a sequential probability
+ * ratio test decides between two hypotheses of the Elo difference, and stops the match as soon as
+ * it can tell which one holds.
+ *
+ * Openings format, one position per line:
+ *
+ *     <fen> <w|b>
+ *
+ * Annotations after the player to move are ignored (see `parse_suite_line`), so a corpus for
+ * rock_tune or an EPD suite can be used as is. Empty lines and lines starting with '#' are ignored.
+ *
+ * Either side can instead be played by the rock_engine of another build, such as one from before a
+ * change, given by its path. Each thread then runs its own copy of the engine, and sends it only
+ * the depth, node and time limits of the side, which are all its protocol takes.
+ */
+
+#include "command_line.h"
+#include "internal/match_statistics.h"
+#include "internal/position_suite.h"
+#include "internal/thread_pool.h"
+#include "engine_process.h"
+#include "random_opening.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/format.h"
+#include "rock/game.h"
+#include "rock/parse.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rock;
+using namespace rock::internal;
+using namespace rock::tools;
+
+namespace
+{
+
+struct Options
+{
+    SearchLimits limits[2]{};
+    std::string engine_paths[2]{};
+    std::string openings_path{};
+    std::size_t max_games{20000};
+    int random_plies{8};
+    std::size_t max_moves{300};
+    u64 seed{1};
+    std::size_t num_threads{std::max(1u, std::thread::hardware_concurrency())};
+    std::optional<SprtSettings> sprt{SprtSettings{}};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_match [--games <n>] [--openings <path>] [--random-plies <n>] "
+                 "[--max-moves <n>] [--seed <n>] [--threads <n>] [--elo0 <elo>] [--elo1 <elo>] "
+                 "[--alpha <p>] [--beta <p>] [--no-sprt] <engine options>\n"
+                 "Engine options, with <e> either a or b:\n"
+                 "    --<e>-depth <n> --<e>-nodes <n> --<e>-time <ms> --<e>-solver-nodes <n>\n"
+                 "    --<e>-symmetric --<e>-monte-carlo --<e>-playout-plies <n>\n"
+                 "    --<e>-engine <path to the rock_engine of another build>\n";
+}
+
+/**
+ * Parse an option of one of the engines, without its "--a-" or "--b-" prefix, advancing past its
+ * value if it has one. Returns false if it is not an engine option.
+ */
+auto parse_engine_option(
+    std::string const& name, int argc, char** argv, int& i, SearchLimits& limits) -> bool
+{
+    auto const has_value = i + 1 < argc;
+
+    if (name == "depth" && has_value)
+        limits.depth = std::stoi(argv[++i]);
+    else if (name == "nodes" && has_value)
+        limits.nodes = u64{std::stoull(argv[++i])};
+    else if (name == "time" && has_value)
+        limits.move_time = std::chrono::milliseconds{std::stoll(argv[++i])};
+    else if (name == "solver-nodes" && has_value)
+        limits.solver_nodes = std::size_t{std::stoul(argv[++i])};
+    else if (name == "symmetric")
+        limits.symmetric_transpositions = true;
+    else if (name == "monte-carlo")
+        limits.engine = SearchEngine::MonteCarlo;
+    else if (name == "playout-plies" && has_value)
+        limits.playout_plies = std::stoi(argv[++i]);
+    else
+        return false;
+
+    return true;
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+    auto sprt = SprtSettings{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--games" && has_value)
+            options.max_games = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--openings" && has_value)
+            options.openings_path = argv[++i];
+        else if (arg == "--random-plies" && has_value)
+            options.random_plies = std::stoi(argv[++i]);
+        else if (arg == "--max-moves" && has_value)
+            options.max_moves = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--seed" && has_value)
+            options.seed = u64{std::stoull(argv[++i])};
+        else if (arg == "--threads" && has_value)
+            options.num_threads = std::max(std::size_t{1}, std::size_t{std::stoul(argv[++i])});
+        else if (arg == "--elo0" && has_value)
+            sprt.elo0 = std::stod(argv[++i]);
+        else if (arg == "--elo1" && has_value)
+            sprt.elo1 = std::stod(argv[++i]);
+        else if (arg == "--alpha" && has_value)
+            sprt.alpha = std::stod(argv[++i]);
+        else if (arg == "--beta" && has_value)
+            sprt.beta = std::stod(argv[++i]);
+        else if (arg == "--no-sprt")
+            options.sprt = std::nullopt;
+        else if (arg == "--a-engine" && has_value)
+            options.engine_paths[0] = argv[++i];
+        else if (arg == "--b-engine" && has_value)
+            options.engine_paths[1] = argv[++i];
+        else if (arg.rfind("--a-", 0) == 0)
+        {
+            if (!parse_engine_option(arg.substr(4), argc, argv, i, options.limits[0]))
+                return std::nullopt;
+        }
+        else if (arg.rfind("--b-", 0) == 0)
+        {
+            if (!parse_engine_option(arg.substr(4), argc, argv, i, options.limits[1]))
+                return std::nullopt;
+        }
+        else
+            return std::nullopt;
+    }
+
+    if (options.sprt)
+    {
+        if (sprt.elo1 <= sprt.elo0 || sprt.alpha <= 0.0 || sprt.alpha >= 1.0 ||
+            sprt.beta <= 0.0 || sprt.beta >= 1.0)
+            return std::nullopt;
+        options.sprt = sprt;
+    }
+
+    if (options.max_games == 0 || options.random_plies < 0 || options.max_moves == 0)
+        return std::nullopt;
+
+    // Another build is only told the limits its protocol has
+    for (auto side = 0; side < 2; ++side)
+    {
+        auto const& limits = options.limits[side];
+        if (!options.engine_paths[side].empty() &&
+            (limits.solver_nodes || limits.symmetric_transpositions ||
+             limits.engine != SearchEngine::AlphaBeta || limits.playout_plies))
+            return std::nullopt;
+    }
+
+    // An engine given no limit searches to a fixed depth, so that its moves take the same effort
+    // whatever the machine and the load on it
+    for (auto& limits : options.limits)
+    {
+        if (!limits.depth && !limits.nodes && !limits.move_time &&
+            limits.engine == SearchEngine::AlphaBeta)
+            limits.depth = 4;
+    }
+
+    return options;
+}
+
+auto load_openings(std::string const& path) -> std::vector<Position>
+{
+    auto reader = PositionSuiteReader::open(path);
+    if (!reader)
+        throw std::runtime_error(fmt::format("Could not open openings '{}'", path));
+
+    auto openings = std::vector<Position>{};
+    while (auto const entry = reader->next())
+    {
+        if (get_game_outcome(entry->position) != GameOutcome::Ongoing)
+        {
+            std::cerr << fmt::format(
+                "{}:{}: the game is over, skipping\n", path, reader->line_number());
+            continue;
+        }
+        openings.push_back(entry->position);
+    }
+    for (auto const line_number : reader->invalid_lines())
+        std::cerr << fmt::format("{}:{}: could not parse line, skipping\n", path, line_number);
+
+    if (openings.empty())
+        throw std::runtime_error(fmt::format("No openings in '{}'", path));
+    return openings;
+}
+
+/**
+ * One side of the match, as a thread plays it: this build searching with the limits, or the
+ * engine of another build if there is one
+ */
+struct Side
+{
+    SearchLimits const* limits{};
+    EngineProcess* engine{};
+};
+
+/**
+ * The move the engine chooses after the moves from the opening, within the limits
+ */
+auto engine_move(
+    EngineProcess& engine,
+    Position const& opening,
+    std::vector<Move> const& moves,
+    SearchLimits const& limits) -> Move
+{
+    auto position = fmt::format(
+        "position fen {} {} moves",
+        format_as_fen(opening.board()),
+        opening.player_to_move() == Player::White ? 'w' : 'b');
+    for (auto const move : moves)
+        position += ' ' + to_string(move);
+    engine.send(position);
+
+    auto go = std::string{"go"};
+    if (limits.depth)
+        go += fmt::format(" depth {}", *limits.depth);
+    if (limits.nodes)
+        go += fmt::format(" nodes {}", *limits.nodes);
+    if (limits.move_time)
+        go += fmt::format(" movetime {}", limits.move_time->count());
+    engine.send(go);
+
+    // The search reports each depth before its move
+    while (true)
+    {
+        auto const line = engine.read_line();
+        auto fields = std::istringstream{line};
+        auto kind = std::string{};
+        auto move_str = std::string{};
+        if (!(fields >> kind >> move_str) || kind != "bestmove")
+            continue;
+
+        auto const move = parse_move(move_str);
+        if (!move)
+        {
+            throw std::runtime_error(
+                fmt::format("Engine '{}' sent no move: '{}'", engine.path(), line));
+        }
+        return *move;
+    }
+}
+
+/**
+ * Play a game from the opening, with each side choosing the moves of its player
+ *
+ * The limits do not keep transpositions, so that each move is searched afresh, and neither
+ * configuration carries on from the table or Monte-Carlo tree that the other left on the thread.
+ * The engine of another build is only told that a new game has started.
+ */
+auto play_game(Position opening, Side const& white, Side const& black, std::size_t max_moves)
+    -> GameOutcome
+{
+    for (auto const* side : {&white, &black})
+    {
+        if (side->engine)
+            side->engine->send("ucinewgame");
+    }
+
+    auto game = Game::from_position(opening);
+    auto moves = std::vector<Move>{};
+    for (auto i = std::size_t{}; i < max_moves && game.current_status() == GameOutcome::Ongoing;
+         ++i)
+    {
+        auto const& position = game.current_position();
+        auto const& side = position.player_to_move() == Player::White ? white : black;
+        auto const move = side.engine
+            ? engine_move(*side.engine, opening, moves, *side.limits)
+            : *analyze_position(position, *side.limits).best_move;
+
+        if (!game.make_move(move))
+        {
+            throw std::runtime_error(fmt::format(
+                "Engine '{}' played the illegal move {}", side.engine->path(), to_string(move)));
+        }
+        moves.push_back(move);
+    }
+
+    auto const status = game.current_status();
+    return status == GameOutcome::Ongoing ? GameOutcome::Draw : status;
+}
+
+auto format_results(MatchResults const& results, std::optional<SprtSettings> const& sprt)
+    -> std::string
+{
+    auto str = fmt::format(
+        "{} games, +{} ={} -{}", results.num_games(), results.wins, results.draws, results.losses);
+
+    if (auto const elo = estimate_elo(results))
+        str += fmt::format(", Elo {:.1f} +/- {:.1f}", elo->elo, elo->error);
+
+    if (sprt)
+    {
+        str += fmt::format(
+            ", LLR {:.2f} ({:.2f}, {:.2f})",
+            sprt_log_likelihood_ratio(results, *sprt),
+            sprt->lower_bound(),
+            sprt->upper_bound());
+    }
+    return str;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto const openings = options->openings_path.empty()
+            ? std::vector<Position>{}
+            : load_openings(options->openings_path);
+        auto const opening = [&](std::size_t pair) {
+            if (!openings.empty())
+                return openings[pair % openings.size()];
+            auto rng = std::mt19937_64{options->seed + pair};
+            return random_opening(options->random_plies, rng).current_position();
+        };
+
+        auto const report_interval = std::max(std::size_t{2}, options->max_games / 20);
+        auto next_game = std::atomic<std::size_t>{};
+        auto is_decided = std::atomic<bool>{};
+        auto has_failed = std::atomic<bool>{};
+        auto results_mutex = std::mutex{};
+        auto results = MatchResults{};
+        auto decision = SprtDecision::Continue;
+
+        auto pool = ThreadPool{ThreadPoolConfig{options->num_threads}};
+        auto tasks = TaskGroup{&pool};
+        auto const t_begin = std::chrono::steady_clock::now();
+
+        // One worker per thread, each playing games until there are none left or the test is
+        // decided. The two games of an opening are numbered next to each other, with the first
+        // engine playing white in the first of them. Games that finish after the test is decided
+        // are left out, so that the results are those it was decided on.
+        auto const play_games = [&] {
+            std::unique_ptr<EngineProcess> engines[2]{};
+            Side sides[2]{};
+            for (auto side = 0; side < 2; ++side)
+            {
+                auto const& path = options->engine_paths[side];
+                if (!path.empty())
+                    engines[side] = std::make_unique<EngineProcess>(path);
+                sides[side] = Side{&options->limits[side], engines[side].get()};
+            }
+
+            for (auto index = next_game++;
+                 index < options->max_games && !is_decided && !has_failed;
+                 index = next_game++)
+            {
+                auto const a_is_white = index % 2 == 0;
+                auto const& white = sides[a_is_white ? 0 : 1];
+                auto const& black = sides[a_is_white ? 1 : 0];
+                auto const outcome =
+                    play_game(opening(index / 2), white, black, options->max_moves);
+
+                auto const lock = std::lock_guard{results_mutex};
+                if (is_decided)
+                    break;
+                if (outcome == GameOutcome::Draw)
+                    ++results.draws;
+                else if ((outcome == GameOutcome::WhiteWins) == a_is_white)
+                    ++results.wins;
+                else
+                    ++results.losses;
+
+                if (options->sprt)
+                {
+                    decision = sprt_decision(results, *options->sprt);
+                    is_decided = decision != SprtDecision::Continue;
+                }
+                if (results.num_games() % report_interval == 0)
+                    std::cerr << format_results(results, options->sprt) << '\n';
+            }
+        };
+
+        // A worker that fails, such as when the engine of another build exits, stops the others
+        for (auto i = std::size_t{}; i < options->num_threads; ++i)
+        {
+            tasks.run([&] {
+                try
+                {
+                    play_games();
+                }
+                catch (...)
+                {
+                    has_failed = true;
+                    throw;
+                }
+            });
+        }
+        tasks.wait();
+
+        auto const duration = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - t_begin)
+                                  .count();
+        std::cout << fmt::format(
+            "{} in {:.1f}s\n", format_results(results, options->sprt), duration);
+
+        if (options->sprt)
+        {
+            switch (decision)
+            {
+            case SprtDecision::AcceptElo1:
+                std::cout << fmt::format(
+                    "H1 accepted: a is {} Elo stronger, rather than {}\n",
+                    options->sprt->elo1,
+                    options->sprt->elo0);
+                break;
+            case SprtDecision::AcceptElo0:
+                std::cout << fmt::format(
+                    "H0 accepted: a is {} Elo stronger, rather than {}\n",
+                    options->sprt->elo0,
+                    options->sprt->elo1);
+                break;
+            case SprtDecision::Continue:
+                std::cout << "Inconclusive\n";
+                break;
+            }
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
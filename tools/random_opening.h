@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * Random openings, for the tools that play or analyze games from varied positions
+ */
+
+#include "rock/algorithms.h"
+#include "rock/game.h"
+#include "rock/types.h"
+#include <cstddef>
+#include <random>
+
+namespace rock::tools
+{
+
+/**
+ * A game of random moves from the starting position, which is still going after them
+ */
+inline auto random_opening(int num_plies, std::mt19937_64& rng) -> Game
+{
+    while (true)
+    {
+        auto game = Game::standard_new_game();
+        for (auto ply = 0; ply < num_plies && game.current_status() == GameOutcome::Ongoing; ++ply)
+        {
+            auto const moves = list_moves(game.current_position());
+            auto dist = std::uniform_int_distribution<std::size_t>(0, moves.size() - 1);
+            game.make_move(moves[dist(rng)]);
+        }
+
+        if (game.current_status() == GameOutcome::Ongoing)
+            return game;
+    }
+}
+
+}  // namespace rock::tools
@@ -0,0 +1,279 @@
+/**
+ * Plays games of the engine against itself, for tuning and regression testing.
+ *
+ * Each game starts with a number of random moves from the starting position, so that the games
+ * differ, and is then played out with the given search limits on both sides. The games are shared
+ * out between the threads, each of which plays one game at a time and keeps its transposition
+ * table from one move and game to the next. The games are written as they finish, so in no
+ * particular order, to a file of game records (see `GameRecordWriter`). Games that go on for too
+ * long are stopped and counted as draws.
+ *
+ * The positions of the games can also be written out as a corpus for rock_tune, each labeled
+ * with the result of its game, either as text or as position records (see
+ * `PositionRecordWriter`), which take a fraction of the space and are read much faster.
+ */
+
+#include "command_line.h"
+#include "internal/game_record.h"
+#include "internal/thread_pool.h"
+#include "random_opening.h"
+#include "rock/algorithms.h"
+#include "rock/fen.h"
+#include "rock/format.h"
+#include "rock/game.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rock;
+using namespace rock::internal;
+using namespace rock::tools;
+
+namespace
+{
+
+struct Options
+{
+    std::string output_path{};
+    std::string corpus_path{};
+    std::string positions_path{};
+    std::size_t num_games{1000};
+    std::optional<int> depth{};
+    std::optional<u64> nodes{};
+    bool monte_carlo{};
+    int random_plies{8};
+    std::size_t max_moves{300};
+    u64 seed{1};
+    std::size_t num_threads{std::max(1u, std::thread::hardware_concurrency())};
+};
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_selfplay <output> [--games <n>] [--depth <n>] [--nodes <n>] "
+                 "[--monte-carlo] [--random-plies <n>] [--max-moves <n>] [--seed <n>] "
+                 "[--threads <n>] [--corpus <path>] [--positions <path>]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--games" && has_value)
+            options.num_games = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--depth" && has_value)
+            options.depth = std::stoi(argv[++i]);
+        else if (arg == "--nodes" && has_value)
+            options.nodes = u64{std::stoull(argv[++i])};
+        else if (arg == "--monte-carlo")
+            options.monte_carlo = true;
+        else if (arg == "--random-plies" && has_value)
+            options.random_plies = std::stoi(argv[++i]);
+        else if (arg == "--max-moves" && has_value)
+            options.max_moves = std::size_t{std::stoul(argv[++i])};
+        else if (arg == "--seed" && has_value)
+            options.seed = u64{std::stoull(argv[++i])};
+        else if (arg == "--threads" && has_value)
+            options.num_threads = std::max(std::size_t{1}, std::size_t{std::stoul(argv[++i])});
+        else if (arg == "--corpus" && has_value)
+            options.corpus_path = argv[++i];
+        else if (arg == "--positions" && has_value)
+            options.positions_path = argv[++i];
+        else if (options.output_path.empty() && is_positional_argument(arg))
+            options.output_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.output_path.empty() || options.random_plies < 0 || options.max_moves == 0 ||
+        (options.depth && *options.depth < 1))
+        return std::nullopt;
+
+    // Without any limit, a shallow search plays enough games for a corpus in reasonable time
+    if (!options.depth && !options.nodes && !options.monte_carlo)
+        options.depth = 4;
+
+    return options;
+}
+
+auto search_limits(Options const& options) -> SearchLimits
+{
+    auto limits = SearchLimits{};
+    limits.depth = options.depth;
+    limits.nodes = options.nodes;
+    limits.keep_transpositions = true;
+    if (options.monte_carlo)
+        limits.engine = SearchEngine::MonteCarlo;
+    return limits;
+}
+
+auto result_string(GameOutcome outcome) -> char const*
+{
+    switch (outcome)
+    {
+    case GameOutcome::WhiteWins:
+        return "1-0";
+    case GameOutcome::BlackWins:
+        return "0-1";
+    default:
+        return "1/2-1/2";
+    }
+}
+
+auto play_game(u64 seed, Options const& options, SearchLimits const& limits) -> GameRecord
+{
+    auto rng = std::mt19937_64{seed};
+    auto game = random_opening(options.random_plies, rng);
+
+    auto record = GameRecord{game.current_position(), {}, GameOutcome::Draw};
+    while (game.current_status() == GameOutcome::Ongoing && record.moves.size() < options.max_moves)
+    {
+        auto const analysis = analyze_position(game.current_position(), limits);
+        game.make_move(*analysis.best_move);
+        record.moves.push_back(*analysis.best_move);
+    }
+
+    if (game.current_status() != GameOutcome::Ongoing)
+        record.outcome = game.current_status();
+    return record;
+}
+
+/**
+ * The positions of the game, other than where it ended, labeled with its result
+ */
+auto write_corpus_lines(std::ostream& corpus, GameRecord const& record) -> void
+{
+    auto position = record.start;
+    for (auto const move : record.moves)
+    {
+        corpus << fmt::format(
+            "{} {} {}\n",
+            format_as_fen(position.board()),
+            position.player_to_move() == Player::White ? 'w' : 'b',
+            result_string(record.outcome));
+        position = apply_move(move, position);
+    }
+}
+
+auto write_position_records(PositionRecordWriter& writer, GameRecord const& record) -> void
+{
+    auto position = record.start;
+    for (auto const move : record.moves)
+    {
+        writer.write(PositionRecord{position, record.outcome});
+        position = apply_move(move, position);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto writer = GameRecordWriter{options->output_path};
+        auto corpus = std::ofstream{};
+        if (!options->corpus_path.empty())
+        {
+            corpus.open(options->corpus_path);
+            if (!corpus)
+            {
+                throw std::runtime_error(
+                    fmt::format("Could not open '{}' for writing", options->corpus_path));
+            }
+        }
+
+        auto positions = std::optional<PositionRecordWriter>{};
+        if (!options->positions_path.empty())
+            positions.emplace(options->positions_path);
+
+        auto const limits = search_limits(*options);
+        auto const report_interval = std::max(std::size_t{1}, options->num_games / 20);
+        auto next_game = std::atomic<std::size_t>{};
+        auto output_mutex = std::mutex{};
+        auto num_moves = std::size_t{};
+        std::size_t num_outcomes[4] = {};
+
+        auto pool = ThreadPool{ThreadPoolConfig{options->num_threads}};
+        auto tasks = TaskGroup{&pool};
+        auto const t_begin = std::chrono::steady_clock::now();
+
+        // One worker per thread, each playing games until there are none left, so that each game
+        // runs on one thread and uses its transposition table
+        for (auto i = std::size_t{}; i < options->num_threads; ++i)
+        {
+            tasks.run([&] {
+                for (auto index = next_game++; index < options->num_games; index = next_game++)
+                {
+                    auto const record = play_game(options->seed + index, *options, limits);
+
+                    auto const lock = std::lock_guard{output_mutex};
+                    writer.write(record);
+                    if (corpus.is_open())
+                        write_corpus_lines(corpus, record);
+                    if (positions)
+                        write_position_records(*positions, record);
+
+                    num_moves += record.moves.size();
+                    ++num_outcomes[static_cast<int>(record.outcome)];
+                    if (writer.num_games() % report_interval == 0)
+                    {
+                        auto const elapsed = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - t_begin);
+                        std::cerr << fmt::format(
+                            "{} games, {:.1f} games/s\n",
+                            writer.num_games(),
+                            writer.num_games() / elapsed.count());
+                    }
+                }
+            });
+        }
+        tasks.wait();
+
+        if (corpus.is_open() && !corpus.flush())
+            throw std::runtime_error(fmt::format("Could not write '{}'", options->corpus_path));
+
+        auto const duration = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - t_begin)
+                                  .count();
+        std::cerr << fmt::format(
+            "Wrote {} games to {} in {:.1f}s ({:.1f} games/s, {:.0f} moves/s): white won {}, "
+            "black won {}, {} drawn\n",
+            writer.num_games(),
+            options->output_path,
+            duration,
+            writer.num_games() / duration,
+            num_moves / duration,
+            num_outcomes[static_cast<int>(GameOutcome::WhiteWins)],
+            num_outcomes[static_cast<int>(GameOutcome::BlackWins)],
+            num_outcomes[static_cast<int>(GameOutcome::Draw)]);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
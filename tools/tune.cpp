@@ -0,0 +1,402 @@
+/**
+ * Texel-style tuning of the evaluation weights.
+ *
+ * Reads a corpus of positions labeled with the result of the game they were taken from, and
+ * minimizes the mean squared error between the game result and a sigmoid of the evaluation. The
+ * evaluation is linear in its weights, so the gradient is computed exactly from the evaluation
+ * features. The tuned weights are written out as a header to replace
+ * src/internal/tuned_evaluation_weights.h.
+ *
+ * Corpus format, one position per line:
+ *
+ *     <fen> <w|b> <result>
+ *
+ * where the result is from white's point of view and is one of "1-0", "0-1", "1/2-1/2", or a
+ * number between 0 and 1. Empty lines and lines starting with '#' are ignored. The lines are read
+ * as suites of positions (see `parse_suite_line`), so EPD with the result given by "c9" works too.
+ *
+ * The corpus can also be a file of position records, as written by rock_selfplay --positions, each
+ * labeled with the outcome of its game. Those without an outcome are ignored.
+ *
+ * The weights can also be written in the text format read by `rock::load_evaluation_weights`, to
+ * try them out without rebuilding.
+ */
+
+#include "command_line.h"
+#include "internal/evaluate.h"
+#include "internal/evaluation_weights.h"
+#include "internal/game_record.h"
+#include "internal/position_suite.h"
+#include "internal/tuned_evaluation_weights.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rock;
+using namespace rock::internal;
+using namespace rock::tools;
+
+namespace
+{
+
+using Parameters = std::array<double, num_evaluation_weights>;
+
+struct Sample
+{
+    Parameters features;
+    double result;  // From the point of view of the player to move
+};
+
+struct Options
+{
+    std::string corpus_path{};
+    std::string output_path{};
+    std::string weights_output_path{};
+    std::size_t num_threads{std::max(1u, std::thread::hardware_concurrency())};
+    int iterations{2000};
+    double learning_rate{1.0};
+};
+
+/**
+ * Adds the position as a sample, unless it is finished and so scored by the win/loss term, which is
+ * not tuned. The result is from white's point of view.
+ */
+auto add_sample(std::vector<Sample>& samples, Position const& position, double result) -> bool
+{
+    auto const friends = position.friends();
+    auto const enemies = position.enemies();
+    if (are_pieces_all_together(friends) || are_pieces_all_together(enemies))
+        return false;
+
+    auto sample = Sample{};
+    auto const features = evaluation_features(friends, enemies);
+    std::copy(features.begin(), features.end(), sample.features.begin());
+    sample.result = position.player_to_move() == Player::White ? result : 1.0 - result;
+    samples.push_back(sample);
+    return true;
+}
+
+auto load_position_records(PositionRecordFile const& file, int& num_skipped) -> std::vector<Sample>
+{
+    auto samples = std::vector<Sample>{};
+    samples.reserve(file.size());
+    for (auto const record : file)
+    {
+        auto const result = record.outcome == GameOutcome::WhiteWins ? 1.0
+            : record.outcome == GameOutcome::BlackWins               ? 0.0
+                                                                     : 0.5;
+        if (record.outcome != GameOutcome::Ongoing && !add_sample(samples, record.position, result))
+            ++num_skipped;
+    }
+    return samples;
+}
+
+auto load_corpus(std::string const& path) -> std::vector<Sample>
+{
+    auto samples = std::vector<Sample>{};
+    auto num_skipped = 0;
+
+    if (auto const records = PositionRecordFile::open(path))
+        samples = load_position_records(*records, num_skipped);
+    else
+    {
+        auto reader = PositionSuiteReader::open(path);
+        if (!reader)
+            throw std::runtime_error(fmt::format("Could not open corpus '{}'", path));
+
+        while (auto const entry = reader->next())
+        {
+            if (!entry->result)
+            {
+                std::cerr << fmt::format(
+                    "{}:{}: no result, skipping\n", path, reader->line_number());
+            }
+            else if (!add_sample(samples, entry->position, *entry->result))
+                ++num_skipped;
+        }
+        for (auto const line_number : reader->invalid_lines())
+            std::cerr << fmt::format("{}:{}: could not parse line, skipping\n", path, line_number);
+    }
+
+    std::cerr << fmt::format(
+        "Loaded {} positions ({} finished positions skipped)\n", samples.size(), num_skipped);
+
+    return samples;
+}
+
+auto sigmoid(double k, double score) -> double
+{
+    return 1.0 / (1.0 + std::exp(-k * score));
+}
+
+auto dot(Parameters const& a, Parameters const& b) -> double
+{
+    auto res = 0.0;
+    for (auto i = std::size_t{}; i < a.size(); ++i)
+        res += a[i] * b[i];
+    return res;
+}
+
+/**
+ * Runs `f(begin, end, thread_index)` over evenly sized chunks of the samples in parallel
+ */
+template <typename F>
+auto parallel_over_chunks(std::size_t num_samples, std::size_t num_threads, F&& f) -> void
+{
+    auto threads = std::vector<std::thread>{};
+    auto const chunk_size = (num_samples + num_threads - 1) / num_threads;
+
+    for (auto t = std::size_t{}; t < num_threads; ++t)
+    {
+        auto const begin = std::min(num_samples, t * chunk_size);
+        auto const end = std::min(num_samples, begin + chunk_size);
+        threads.emplace_back([&f, begin, end, t] { f(begin, end, t); });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+struct ErrorAndGradient
+{
+    double error;
+    Parameters gradient;
+};
+
+auto compute_error_and_gradient(
+    std::vector<Sample> const& samples,
+    Parameters const& weights,
+    double k,
+    std::size_t num_threads) -> ErrorAndGradient
+{
+    auto partial = std::vector<ErrorAndGradient>(num_threads, ErrorAndGradient{});
+
+    parallel_over_chunks(samples.size(), num_threads, [&](auto begin, auto end, auto t) {
+        auto& out = partial[t];
+        for (auto i = begin; i < end; ++i)
+        {
+            auto const& sample = samples[i];
+            auto const prediction = sigmoid(k, dot(weights, sample.features));
+            auto const diff = prediction - sample.result;
+
+            out.error += diff * diff;
+
+            // d/dw (prediction - result)^2 = 2 * diff * k * p * (1 - p) * feature
+            auto const factor = 2.0 * diff * k * prediction * (1.0 - prediction);
+            for (auto j = std::size_t{}; j < weights.size(); ++j)
+                out.gradient[j] += factor * sample.features[j];
+        }
+    });
+
+    auto total = ErrorAndGradient{};
+    for (auto const& p : partial)
+    {
+        total.error += p.error;
+        for (auto j = std::size_t{}; j < total.gradient.size(); ++j)
+            total.gradient[j] += p.gradient[j];
+    }
+
+    auto const n = static_cast<double>(samples.size());
+    total.error /= n;
+    for (auto& g : total.gradient)
+        g /= n;
+
+    return total;
+}
+
+/**
+ * Choose the sigmoid scaling constant that best fits the current weights, so that tuning only
+ * changes the relative size of the weights and not their overall scale
+ */
+auto find_scaling_constant(
+    std::vector<Sample> const& samples, Parameters const& weights, std::size_t num_threads)
+    -> double
+{
+    auto best_k = 0.0;
+    auto best_error = std::numeric_limits<double>::max();
+
+    for (auto k = 0.0005; k < 0.2; k *= 1.05)
+    {
+        auto const error = compute_error_and_gradient(samples, weights, k, num_threads).error;
+        if (error < best_error)
+        {
+            best_error = error;
+            best_k = k;
+        }
+    }
+
+    return best_k;
+}
+
+auto tune(std::vector<Sample> const& samples, Options const& options) -> EvaluationWeights
+{
+    auto const initial = to_vector(tuned_evaluation_weights);
+
+    auto weights = Parameters{};
+    std::copy(initial.begin(), initial.end(), weights.begin());
+
+    auto const k = find_scaling_constant(samples, weights, options.num_threads);
+    std::cerr << fmt::format(
+        "Scaling constant k = {:.5f}, initial error = {:.6f}\n",
+        k,
+        compute_error_and_gradient(samples, weights, k, options.num_threads).error);
+
+    // Adam optimizer; the gradients of the different weights vary by orders of magnitude
+    auto m = Parameters{};
+    auto v = Parameters{};
+    constexpr auto beta1 = 0.9;
+    constexpr auto beta2 = 0.999;
+    constexpr auto epsilon = 1e-8;
+
+    for (auto iteration = 1; iteration <= options.iterations; ++iteration)
+    {
+        auto const [error, gradient] =
+            compute_error_and_gradient(samples, weights, k, options.num_threads);
+
+        for (auto j = std::size_t{}; j < weights.size(); ++j)
+        {
+            m[j] = beta1 * m[j] + (1.0 - beta1) * gradient[j];
+            v[j] = beta2 * v[j] + (1.0 - beta2) * gradient[j] * gradient[j];
+            auto const m_hat = m[j] / (1.0 - std::pow(beta1, iteration));
+            auto const v_hat = v[j] / (1.0 - std::pow(beta2, iteration));
+            weights[j] -= options.learning_rate * m_hat / (std::sqrt(v_hat) + epsilon);
+        }
+
+        if (iteration % 100 == 0 || iteration == options.iterations)
+        {
+            std::cerr << fmt::format(
+                "Iteration {:5}: error = {:.6f} [{:.2f}]\n",
+                iteration,
+                error,
+                fmt::join(weights.begin(), weights.end(), ", "));
+        }
+    }
+
+    auto rounded = EvaluationVector{};
+    std::transform(weights.begin(), weights.end(), rounded.begin(), [](double w) {
+        return static_cast<ScoreType>(std::lround(w));
+    });
+    return from_vector(rounded);
+}
+
+auto make_header(EvaluationWeights const& w, std::size_t num_samples) -> std::string
+{
+    return fmt::format(
+        R"(#pragma once
+
+// Generated by rock_tune. Regenerate with the tool rather than editing by hand.
+// Source: {} labeled positions
+
+#include "evaluation_weights.h"
+
+namespace rock::internal
+{{
+
+inline constexpr EvaluationWeights tuned_evaluation_weights = {{
+    /*centre_circles=*/{{{}, {}, {}}},
+    /*tempo=*/{},
+}};
+
+}}  // namespace rock::internal
+)",
+        num_samples,
+        w.centre_circles[0],
+        w.centre_circles[1],
+        w.centre_circles[2],
+        w.tempo);
+}
+
+auto print_usage() -> void
+{
+    std::cerr << "Usage: rock_tune <corpus> [--output <header>] [--weights-output <file>] "
+                 "[--threads <n>] [--iterations <n>] [--learning-rate <x>]\n";
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    auto options = Options{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string{argv[i]};
+        auto const has_value = i + 1 < argc;
+
+        if (arg == "--output" && has_value)
+            options.output_path = argv[++i];
+        else if (arg == "--weights-output" && has_value)
+            options.weights_output_path = argv[++i];
+        else if (arg == "--threads" && has_value)
+            options.num_threads = std::max(std::size_t{1}, std::size_t{std::stoul(argv[++i])});
+        else if (arg == "--iterations" && has_value)
+            options.iterations = std::stoi(argv[++i]);
+        else if (arg == "--learning-rate" && has_value)
+            options.learning_rate = std::stod(argv[++i]);
+        else if (options.corpus_path.empty() && is_positional_argument(arg))
+            options.corpus_path = arg;
+        else
+            return std::nullopt;
+    }
+
+    if (options.corpus_path.empty())
+        return std::nullopt;
+
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_command_line(argc, argv, parse_options);
+    if (!options)
+    {
+        print_usage();
+        return 1;
+    }
+
+    try
+    {
+        auto const samples = load_corpus(options->corpus_path);
+        if (samples.empty())
+        {
+            std::cerr << "No positions to tune on\n";
+            return 1;
+        }
+
+        auto const weights = tune(samples, *options);
+        auto const header = make_header(weights, samples.size());
+
+        if (options->output_path.empty())
+        {
+            std::cout << header;
+        }
+        else
+        {
+            auto file = std::ofstream(options->output_path);
+            file << header;
+            std::cerr << fmt::format("Wrote {}\n", options->output_path);
+        }
+
+        if (!options->weights_output_path.empty())
+        {
+            auto file = std::ofstream(options->weights_output_path);
+            file << format_evaluation_weights(weights);
+            std::cerr << fmt::format("Wrote {}\n", options->weights_output_path);
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
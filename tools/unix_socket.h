@@ -0,0 +1,175 @@
+#pragma once
+
+/**
+ * Lines of text over Unix-domain stream sockets, for the analysis daemon and its clients
+ */
+
+#include <fmt/format.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace rock::tools
+{
+
+/**
+ * Owns a socket, closing it when destroyed
+ */
+struct Socket
+{
+    explicit Socket(int fd) : fd_{fd} {}
+    Socket(Socket&& other) noexcept : fd_{std::exchange(other.fd_, -1)} {}
+    auto operator=(Socket&&) -> Socket& = delete;
+    ~Socket()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    auto fd() const -> int { return fd_; }
+
+    /**
+     * Stop reading and writing, which wakes up any thread blocked reading the socket
+     */
+    auto shut_down() -> void { ::shutdown(fd_, SHUT_RDWR); }
+
+private:
+    int fd_;
+};
+
+namespace detail
+{
+    inline auto make_address(std::string const& path) -> sockaddr_un
+    {
+        auto address = sockaddr_un{};
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error(fmt::format("Socket path '{}' is too long", path));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    inline auto make_socket() -> Socket
+    {
+        auto const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            throw std::runtime_error(fmt::format("Could not create socket: {}", strerror(errno)));
+        return Socket{fd};
+    }
+}  // namespace detail
+
+/**
+ * Throws `std::runtime_error` if the socket cannot be bound to the path, replacing any file that
+ * is already there
+ */
+inline auto listen_on_unix_socket(std::string const& path) -> Socket
+{
+    auto const address = detail::make_address(path);
+    auto socket = detail::make_socket();
+
+    ::unlink(path.c_str());
+    auto const* generic_address = reinterpret_cast<sockaddr const*>(&address);
+    if (::bind(socket.fd(), generic_address, sizeof(address)) != 0 ||
+        ::listen(socket.fd(), SOMAXCONN) != 0)
+    {
+        throw std::runtime_error(
+            fmt::format("Could not listen on '{}': {}", path, strerror(errno)));
+    }
+    return socket;
+}
+
+/**
+ * Throws `std::runtime_error` if the socket cannot be connected to
+ */
+inline auto connect_to_unix_socket(std::string const& path) -> Socket
+{
+    auto const address = detail::make_address(path);
+    auto socket = detail::make_socket();
+
+    auto const* generic_address = reinterpret_cast<sockaddr const*>(&address);
+    if (::connect(socket.fd(), generic_address, sizeof(address)) != 0)
+    {
+        throw std::runtime_error(
+            fmt::format("Could not connect to '{}': {}", path, strerror(errno)));
+    }
+    return socket;
+}
+
+/**
+ * Send the line and its newline, returning false if the other end has gone
+ */
+inline auto send_line(Socket const& socket, std::string line) -> bool
+{
+    line += '\n';
+    auto const* data = line.data();
+    auto remaining = line.size();
+    while (remaining > 0)
+    {
+        auto const sent = ::send(socket.fd(), data, remaining, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        data += sent;
+        remaining -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+/**
+ * Reads a socket line by line
+ */
+struct LineReader
+{
+    explicit LineReader(Socket const& socket) : fd_{socket.fd()} {}
+
+    /**
+     * The next line, without its newline, or nothing once the other end has closed the socket
+     */
+    auto read_line() -> std::optional<std::string>
+    {
+        while (true)
+        {
+            if (auto const end = buffer_.find('\n'); end != std::string::npos)
+            {
+                auto line = buffer_.substr(0, end);
+                buffer_.erase(0, end + 1);
+                return line;
+            }
+
+            char chunk[4096];
+            auto const received = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return std::nullopt;
+            buffer_.append(chunk, static_cast<std::size_t>(received));
+        }
+    }
+
+    /**
+     * Whether there is anything to read within the timeout, so that reading a line will not wait
+     * for long
+     */
+    auto wait_for_line(std::chrono::milliseconds timeout) -> bool
+    {
+        if (buffer_.find('\n') != std::string::npos)
+            return true;
+        auto poll_fd = pollfd{fd_, POLLIN, 0};
+        return ::poll(&poll_fd, 1, static_cast<int>(timeout.count())) > 0;
+    }
+
+private:
+    int fd_;
+    std::string buffer_{};
+};
+
+}  // namespace rock::tools